@@ -0,0 +1,123 @@
+#include "Arduino.h"
+#include "AcqTrace.h"
+#include "AdcSampler.h"
+
+// the host simulator links host/sim/TraceReplay.cpp in place of this file
+#ifndef ACQ_SIM
+
+static_assert(ACQ_TRACE_BUFFER <= SHARED_BUFFER_BYTES, "the trace buffer doesn't fit the SharedBuffer");
+
+AcqTrace::AcqTrace() {
+  _buf = 0;
+  _used = 0;
+  _overflow = false;
+}
+
+bool AcqTrace::begin(const char *name, byte adcCount, byte tcCount) {
+  close();
+  _buf = SharedBuffer::claim(SHARED_TRACE);
+  if (!_buf) {
+    return false;
+  }
+  if (!_file.open(name, O_CREAT | O_WRITE | O_TRUNC)) {
+    SharedBuffer::release(SHARED_TRACE);
+    return false;
+  }
+  _overflow = false;
+  byte header[ACQ_TRACE_HEADER_SIZE] = {'A', 'T', 'R', '1', adcCount, tcCount, 0, 0};
+  memcpy(_buf, header, sizeof(header));
+  _used = sizeof(header);
+  return true;
+}
+
+void AcqTrace::update() {
+  if (!_file.isOpen()) {
+    return;
+  }
+  if (_overflow) {
+    Serial.println("trace buffer overflow, capture stopped");
+    close();
+  }
+  else if (_used >= ACQ_TRACE_BUFFER / 2) {
+    _file.write(_buf, _used);
+    _used = 0;
+  }
+}
+
+void AcqTrace::flush() {
+  if (!_file.isOpen()) {
+    return;
+  }
+  _file.write(_buf, _used);
+  _used = 0;
+  _file.sync();
+}
+
+void AcqTrace::close() {
+  if (_file.isOpen()) {
+    flush();
+    _file.close();
+    SharedBuffer::release(SHARED_TRACE);
+  }
+}
+
+bool AcqTrace::record(char type, byte payload) {
+  if (!_file.isOpen() || _overflow) {
+    return false;
+  }
+  if (_used + 5 + payload > ACQ_TRACE_BUFFER) {
+    _overflow = true;
+    return false;
+  }
+  uint32_t t = millis();
+  _buf[_used] = type;
+  memcpy(_buf + _used + 1, &t, 4);
+  _used = _used + 5;
+  return true;
+}
+
+void AcqTrace::put(const void *data, byte size) {
+  memcpy(_buf + _used, data, size);
+  _used = _used + size;
+}
+
+bool AcqTrace::touch(FT5x06 &cmt, byte *registers) {
+  if (!cmt.touched()) {
+    return false;
+  }
+  cmt.getRegisterInfo(registers);
+  if (record(ACQ_TRACE_TOUCH, FT5206_NUMBER_OF_REGISTERS)) {
+    put(registers, FT5206_NUMBER_OF_REGISTERS);
+  }
+  return true;
+}
+
+DateTime AcqTrace::now(RTC_DS1307 &rtc) {
+  DateTime t = rtc.now();
+  if (record(ACQ_TRACE_RTC, 4)) {
+    uint32_t u = t.unixtime();
+    put(&u, 4);
+  }
+  return t;
+}
+
+void AcqTrace::sample(MAX31855Pair *tc, MAX31855Reading *tcVals, float *adc, byte adcCount) {
+  byte tcCount = 0;
+  if (tc) {
+    tc->read(tcVals);
+    tcCount = 2;
+  }
+  for (byte i = 0; i < adcCount; i = i + 1) {
+    adc[i] = adcSampler.read(i);
+  }
+  if (record(ACQ_TRACE_SAMPLE, 4 * adcCount + 9 * tcCount)) {
+    put(adc, 4 * adcCount);
+    for (byte i = 0; i < tcCount; i = i + 1) {
+      put(&tcVals[i].thermocouple, 4);
+      put(&tcVals[i].internal, 4);
+      put(&tcVals[i].fault, 1);
+    }
+  }
+}
+
+#endif
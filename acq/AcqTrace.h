@@ -0,0 +1,84 @@
+/*
+  AcqTrace.h - Records what the sketch reads from the outside world, for replay.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Touch registers, RTC readings and the sampled sources (decimated analog
+  values and thermocouple readings) are all read through here. On the Mega
+  each call reads the hardware and, while capturing, appends a record
+  stamped with millis() to YYMMDD-x.TRC next to the first log of the run.
+  The host simulator (host/sim) links its own version of these calls that
+  returns the recorded values instead, so a field run can be replayed
+  through the same sketch.
+
+  File format, little-endian like the AVR:
+    header   "ATR1", adc count, thermocouple count, 2 reserved bytes
+    record   type, millis (4 bytes), payload:
+      'R'    RTC reading: unixtime (4)
+      'T'    touch: FT5206_NUMBER_OF_REGISTERS register bytes
+      'S'    sample: adc count floats, then per thermocouple the
+             thermocouple and internal floats and the fault byte
+
+  Records are only ever buffered in RAM, since dateTime() may call now()
+  from inside SdFat; update() writes the buffer out from loop() once it is
+  half full. If it fills anyway capture stops there, and a power loss loses
+  whatever was still buffered. The buffer is the SharedBuffer, held from
+  begin() to close(), so a capture build has no scope or live stream.
+*/
+
+#ifndef AcqTrace_h
+#define AcqTrace_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+#include "RTClib.h"
+#include "FT5x06.h"
+#include "MAX31855Pair.h"
+#include "SharedBuffer.h"
+
+#define ACQ_TRACE_MAGIC       "ATR1"
+#define ACQ_TRACE_HEADER_SIZE 8
+#define ACQ_TRACE_BUFFER      256
+
+#define ACQ_TRACE_RTC    'R'
+#define ACQ_TRACE_TOUCH  'T'
+#define ACQ_TRACE_SAMPLE 'S'
+
+class AcqTrace {
+  public:
+    AcqTrace();
+    // starts capturing to name (replaced if it exists); sample() will be
+    // called with adcCount analog values and tcCount thermocouples. False
+    // if the file can't be made or the SharedBuffer is taken
+    bool begin(const char *name, byte adcCount, byte tcCount);
+    bool isCapturing() { return _file.isOpen(); }
+    // call once per pass of loop(), outside any SdFat call
+    void update();
+    // writes out everything buffered, e.g. when logging stops
+    void flush();
+    void close();
+
+    // cmt.touched() and, when touched, its registers
+    bool touch(FT5x06 &cmt, byte *registers);
+    DateTime now(RTC_DS1307 &rtc);
+    // reads both thermocouples from tc (neither if tc is 0) and the first
+    // adcCount decimated analog values
+    void sample(MAX31855Pair *tc, MAX31855Reading *tcVals, float *adc, byte adcCount);
+
+#ifdef ACQ_SIM
+    // host only: replays path instead of reading hardware
+    static bool load(const char *path);
+    static uint32_t lastRecordTime();
+#endif
+  private:
+    bool record(char type, byte payload);
+    void put(const void *data, byte size);
+
+    SdFile _file;
+    byte *_buf;
+    uint16_t _used;
+    bool _overflow;
+};
+
+#endif
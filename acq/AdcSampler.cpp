@@ -0,0 +1,124 @@
+#include "Arduino.h"
+#include "AdcSampler.h"
+#include "ScopeCapture.h"
+#include "AlarmEngine.h"
+#include "FrameStream.h"
+
+AdcSampler adcSampler;
+
+AdcSampler::AdcSampler() {
+  _count = 0;
+  _current = 0;
+  _outputs = 0;
+  _scope = 0;
+  _alarms = 0;
+  _stream = 0;
+}
+
+void AdcSampler::begin(const uint8_t *pins, uint8_t count, uint8_t log4ratio, uint8_t filter) {
+  stop();
+  if (count > ADC_SAMPLER_MAX_CHANNELS) {
+    count = ADC_SAMPLER_MAX_CHANNELS;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    _pins[i] = pins[i];
+    _dec[i].configure(log4ratio, filter);
+    _latest[i] = 0;
+  }
+  _count = count;
+  _outputs = 0;
+  if (count == 0) {
+    return;
+  }
+
+  // AVcc reference, ADC clock F_CPU/128 = 125 kHz, interrupt on completion
+  ADCSRA = (1 << ADEN) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+  startConversion(0);
+}
+
+void AdcSampler::stop() {
+  ADCSRA &= ~(1 << ADIE);
+  while (ADCSRA & (1 << ADSC));
+  _count = 0;
+}
+
+void AdcSampler::startConversion(uint8_t i) {
+  _current = i;
+  uint8_t ch = _pins[i] - A0;
+  // single conversions restarted from the ISR rather than free-running, so the
+  // multiplexer is never switched while the next conversion is already under way
+#if defined(MUX5)
+  ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((ch >> 3) & 0x01) << MUX5);
+#endif
+  ADMUX = (1 << REFS0) | (ch & 0x07);
+  ADCSRA |= (1 << ADSC);
+}
+
+void AdcSampler::isr() {
+  uint16_t sample = ADC;
+  uint8_t i = _current;
+  if (_scope) {
+    _scope->push(i, sample);
+  }
+  if (_stream) {
+    _stream->push(i, sample);
+  }
+  if (_dec[i].push(sample)) {
+    _latest[i] = _dec[i].value();
+    if (_alarms) {
+      _alarms->adc(i, _dec[i].value());
+    }
+    if (i == 0) {
+      _outputs++;
+    }
+  }
+  if (++i >= _count) {
+    i = 0;
+  }
+  startConversion(i);
+}
+
+int32_t AdcSampler::readRaw(uint8_t i) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  int32_t v = _latest[i];
+  SREG = oldSREG;
+  return v;
+}
+
+float AdcSampler::read(uint8_t i) {
+  return (float)readRaw(i) / (1L << (_dec[i].bits() - 10));
+}
+
+void AdcSampler::attach(ScopeCapture *scope) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  _scope = scope;
+  SREG = oldSREG;
+}
+
+void AdcSampler::attach(AlarmEngine *alarms) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  _alarms = alarms;
+  SREG = oldSREG;
+}
+
+void AdcSampler::attach(FrameStream *stream) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  _stream = stream;
+  SREG = oldSREG;
+}
+
+uint32_t AdcSampler::outputs() {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  uint32_t n = _outputs;
+  SREG = oldSREG;
+  return n;
+}
+
+ISR(ADC_vect) {
+  adcSampler.isr();
+}
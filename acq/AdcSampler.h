@@ -0,0 +1,70 @@
+/*
+  AdcSampler.h - Interrupt-driven ADC sampler feeding per-channel decimators.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  The ADC converts continuously at 125 kHz ADC clock (one conversion every
+  104 us), stepping round-robin through the configured analog pins from the
+  ADC_vect interrupt. Every raw sample goes into that channel's Decimator, and
+  the latest decimated output is what read() returns. loop() never calls
+  analogRead(), and must not while the sampler is running since both would
+  fight over ADMUX.
+
+  With a ScopeCapture attached (see ScopeCapture.h) every raw sample is also
+  handed to it, undecimated, and likewise to a FrameStream (FrameStream.h);
+  with an AlarmEngine attached every decimated output is tested against its
+  rules as it comes out.
+*/
+
+#ifndef AdcSampler_h
+#define AdcSampler_h
+
+#include "Arduino.h"
+#include "Decimator.h"
+
+#define ADC_SAMPLER_MAX_CHANNELS 16
+// 13 ADC clocks at 125 kHz; a full round of count() channels takes count() times this
+#define ADC_SAMPLER_CONVERSION_US 104
+
+class ScopeCapture;
+class AlarmEngine;
+class FrameStream;
+
+class AdcSampler {
+  public:
+    AdcSampler();
+    void begin(const uint8_t *pins, uint8_t count, uint8_t log4ratio, uint8_t filter);
+    void stop();
+    // latest decimated output of channel i, in 0-1023 analogRead units
+    float read(uint8_t i);
+    // latest decimated output of channel i as the raw integer (bits() wide)
+    int32_t readRaw(uint8_t i);
+    uint8_t bits() const { return _dec[0].bits(); }
+    uint8_t count() const { return _count; }
+    // number of decimated outputs produced on channel 0 so far
+    uint32_t outputs();
+    // raw samples also go to scope from now on; 0 to stop
+    void attach(ScopeCapture *scope);
+    // decimated outputs go to alarms from now on; 0 to stop
+    void attach(AlarmEngine *alarms);
+    // raw samples go out stream from now on; 0 to stop
+    void attach(FrameStream *stream);
+    void isr();
+  private:
+    void startConversion(uint8_t i);
+
+    uint8_t _pins[ADC_SAMPLER_MAX_CHANNELS];
+    Decimator _dec[ADC_SAMPLER_MAX_CHANNELS];
+    volatile int32_t _latest[ADC_SAMPLER_MAX_CHANNELS];
+    volatile uint32_t _outputs;
+    uint8_t _count;
+    volatile uint8_t _current;
+    ScopeCapture *_scope;
+    AlarmEngine *_alarms;
+    FrameStream *_stream;
+};
+
+extern AdcSampler adcSampler;
+
+#endif
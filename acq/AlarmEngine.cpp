@@ -0,0 +1,260 @@
+#include "Arduino.h"
+#include <SdLatency.h>
+#include "AlarmEngine.h"
+
+static const char *const kindNames[] = {"high", "low", "rate"};
+
+AlarmEngine::AlarmEngine() {
+  _rules = 0;
+  _n = 0;
+  _head = 0;
+  _tail = 0;
+  _dropped = 0;
+  reset();
+}
+
+void AlarmEngine::begin(const AlarmRule *rules, byte n, const Channel *channels,
+                        const byte *slotChannel, byte slots, uint8_t bits, uint32_t outputMicros) {
+  if (n > ALARM_MAX_RULES) {
+    n = ALARM_MAX_RULES;
+  }
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  _n = 0; // the interrupt skips every rule until they're all compiled
+  SREG = oldSREG;
+
+  for (byte r = 0; r < n; r = r + 1) {
+    const AlarmRule &rule = rules[r];
+    const Channel &c = channels[rule.channel];
+    State &s = _state[r];
+    s.slot = ALARM_NO_SLOT;
+    if (c.source == CH_SRC_ANALOG) {
+      for (byte k = 0; k < slots; k = k + 1) {
+        if (slotChannel[k] == rule.channel) {
+          s.slot = k;
+        }
+      }
+    }
+    // counts per channel unit; an analog value is counts / 2^(bits - 10) * scale + offset
+    float perUnit = ALARM_LOOP_SCALE;
+    s.offset = 0;
+    if (s.slot != ALARM_NO_SLOT) {
+      perUnit = (float)(1L << (bits - 10)) / c.scale;
+      s.offset = c.offset;
+    }
+    s.rate = rule.kind == ALARM_RATE;
+    if (s.rate) {
+      // per decimated output in the interrupt, per second in sample()
+      float per = fabs(perUnit);
+      if (s.slot != ALARM_NO_SLOT) {
+        per = per * outputMicros / 1e6;
+      }
+      s.set = (int32_t)(rule.limit * per + 0.5);
+      if (s.set < 1) {
+        s.set = 1;
+      }
+      s.clear = s.set - (int32_t)(rule.hysteresis * per + 0.5);
+      s.low = false;
+      s.toUnits = 1 / per;
+      s.offset = 0;
+    }
+    else {
+      // a negative scale turns a high limit into a low one in counts
+      s.low = (rule.kind == ALARM_LOW) != (perUnit < 0);
+      float set = (rule.limit - s.offset) * perUnit;
+      int32_t hyst = (int32_t)(rule.hysteresis * fabs(perUnit) + 0.5);
+      s.set = (int32_t)(set < 0 ? set - 0.5 : set + 0.5);
+      s.clear = s.low ? s.set + hyst : s.set - hyst;
+      s.toUnits = 1 / perUnit;
+    }
+    s.primed = false;
+    s.active = false;
+    s.edges = 0;
+    s.port = 0;
+    s.mask = 0;
+    if (rule.pin != 0) {
+      pinMode(rule.pin, OUTPUT);
+      digitalWrite(rule.pin, LOW);
+      s.port = portOutputRegister(digitalPinToPort(rule.pin));
+      s.mask = digitalPinToBitMask(rule.pin);
+    }
+  }
+
+  oldSREG = SREG;
+  noInterrupts();
+  _rules = rules;
+  _n = n;
+  _head = 0;
+  _tail = 0;
+  _dropped = 0;
+  SREG = oldSREG;
+}
+
+void AlarmEngine::step(byte r, int32_t v) {
+  State &s = _state[r];
+  bool on;
+  if (s.low) {
+    on = s.active ? v < s.clear : v <= s.set;
+  }
+  else {
+    on = s.active ? v > s.clear : v >= s.set;
+  }
+  if (on == s.active) {
+    return;
+  }
+  // the interrupt may step a rule on the same port or push to the queue
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  s.active = on;
+  s.edges = s.edges + 1;
+  if (s.mask) {
+    if (on) {
+      *s.port |= s.mask;
+    }
+    else {
+      *s.port &= ~s.mask;
+    }
+  }
+  uint8_t next = (_head + 1) % ALARM_QUEUE;
+  if (next == _tail) {
+    _dropped = _dropped + 1;
+  }
+  else {
+    AlarmEvent &e = _queue[_head];
+    e.rule = r;
+    e.active = on;
+    e.ms = millis();
+    e.raw = v;
+    _head = next;
+  }
+  SREG = oldSREG;
+}
+
+void AlarmEngine::adc(uint8_t slot, int32_t raw) {
+  uint32_t start = SdLatency::cycles();
+  for (byte r = 0; r < _n; r = r + 1) {
+    State &s = _state[r];
+    if (s.slot != slot) {
+      continue;
+    }
+    int32_t v = raw;
+    if (s.rate) {
+      v = raw - s.last;
+      s.last = raw;
+      if (!s.primed) {
+        s.primed = true;
+        continue;
+      }
+      if (v < 0) {
+        v = -v;
+      }
+    }
+    step(r, v);
+  }
+  uint32_t cycles = SdLatency::cycles() - start;
+  _isrCount = _isrCount + 1;
+  if (cycles > _isrMax) {
+    _isrMax = cycles;
+  }
+}
+
+void AlarmEngine::sample(const float *vals, uint32_t ms) {
+  uint32_t start = SdLatency::cycles();
+  for (byte r = 0; r < _n; r = r + 1) {
+    State &s = _state[r];
+    float val = vals[_rules[r].channel];
+    if (s.slot != ALARM_NO_SLOT || isnan(val)) {
+      continue; // a thermocouple fault leaves the alarm as it was
+    }
+    int32_t v = (int32_t)(val * ALARM_LOOP_SCALE + (val < 0 ? -0.5 : 0.5));
+    if (s.rate) {
+      int32_t d = v - s.last;
+      uint32_t dt = ms - s.lastMs;
+      bool primed = s.primed;
+      s.last = v;
+      s.lastMs = ms;
+      s.primed = true;
+      if (!primed || dt == 0) {
+        continue;
+      }
+      v = (d < 0 ? -d : d) * 1000L / (int32_t)dt;
+    }
+    step(r, v);
+  }
+  uint32_t cycles = SdLatency::cycles() - start;
+  _loopCount = _loopCount + 1;
+  if (cycles > _loopMax) {
+    _loopMax = cycles;
+  }
+}
+
+bool AlarmEngine::nextEvent(AlarmEvent *e) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  bool any = _tail != _head;
+  if (any) {
+    *e = _queue[_tail];
+    _tail = (_tail + 1) % ALARM_QUEUE;
+  }
+  SREG = oldSREG;
+  return any;
+}
+
+float AlarmEngine::value(const AlarmEvent &e) const {
+  const State &s = _state[e.rule];
+  return e.raw * s.toUnits + s.offset;
+}
+
+byte AlarmEngine::activeCount() const {
+  byte n = 0;
+  for (byte r = 0; r < _n; r = r + 1) {
+    if (_state[r].active) {
+      n = n + 1;
+    }
+  }
+  return n;
+}
+
+void AlarmEngine::reset() {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  _isrCount = 0;
+  _isrMax = 0;
+  SREG = oldSREG;
+  _loopCount = 0;
+  _loopMax = 0;
+}
+
+void AlarmEngine::dump(Print *pr) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  uint32_t isrCount = _isrCount;
+  uint32_t isrMax = _isrMax;
+  uint16_t dropped = _dropped;
+  SREG = oldSREG;
+
+  pr->println(F("# alarm engine, worst-case evaluation in CPU cycles"));
+  pr->println(F("path,evaluations,max_cycles"));
+  pr->print(F("isr,"));
+  pr->print(isrCount);
+  pr->write(',');
+  pr->println(isrMax);
+  pr->print(F("loop,"));
+  pr->print(_loopCount);
+  pr->write(',');
+  pr->println(_loopMax);
+  pr->print(F("# edges dropped: "));
+  pr->println(dropped);
+  pr->println(F("rule,kind,limit,active,edges"));
+  for (byte r = 0; r < _n; r = r + 1) {
+    pr->print(_rules[r].name);
+    pr->write(',');
+    pr->print(kindNames[_rules[r].kind]);
+    pr->write(',');
+    pr->print(_rules[r].limit);
+    pr->write(',');
+    pr->print(_state[r].active ? 1 : 0);
+    pr->write(',');
+    pr->println(_state[r].edges);
+  }
+}
@@ -0,0 +1,121 @@
+/*
+  AlarmEngine.h - Per-sample channel limits driving output pins.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  The rules are written once in AlarmList.h and compiled into an AlarmRule
+  table. begin() turns each rule's limits, given in the channel's units,
+  into integer thresholds in the units its samples arrive in:
+
+    analog channels   the AdcSampler's decimated counts, tested from the
+                      ADC interrupt as each decimated output comes out, so
+                      an alarm acts within one output period
+    other channels    hundredths of the value readChannels() produced,
+                      tested by sample() on each reading
+
+  ALARM_HIGH fires at or above limit and clears below limit - hysteresis;
+  ALARM_LOW the other way round. ALARM_RATE fires when the value moves by
+  limit or more per second, either way, and clears below limit -
+  hysteresis. An active alarm holds its pin high.
+
+  The interrupt path is one pass over at most ALARM_MAX_RULES rules with
+  integer compares only, and edges go into a small queue for loop() to
+  drain with nextEvent(), so its cost is bounded by the rule count. Both
+  paths time themselves with SdLatency::cycles(); dump() reports the worst
+  case seen. Pins are written straight to their port from the interrupt,
+  so give them a port nothing else writes (PORTA, pins 22-29, on the Mega).
+  The host simulator replays decimated values without running the ADC
+  interrupt, so there only the non-analog rules fire.
+*/
+
+#ifndef AlarmEngine_h
+#define AlarmEngine_h
+
+#include "Arduino.h"
+#include "Channels.h"
+
+#define ALARM_HIGH 0
+#define ALARM_LOW  1
+#define ALARM_RATE 2
+
+#define ALARM_MAX_RULES 8
+// edges waiting for loop(); more than this between drains are counted and dropped
+#define ALARM_QUEUE     8
+// non-analog values are compared in hundredths
+#define ALARM_LOOP_SCALE 100
+#define ALARM_NO_SLOT   0xFF
+
+#define ALARM_ENTRY(name, ch, kind, lim, hyst, pin) {#name, CH_##ch, kind, lim, hyst, pin},
+
+struct AlarmRule {
+  const char *name;
+  uint8_t channel;  // channels[] index
+  uint8_t kind;
+  float limit;      // channel units, per second for ALARM_RATE
+  float hysteresis;
+  uint8_t pin;      // 0 for none
+};
+
+struct AlarmEvent {
+  uint8_t rule;
+  bool active;
+  uint32_t ms;      // millis() at the edge
+  int32_t raw;      // the compared value; see AlarmEngine::value()
+};
+
+class AlarmEngine {
+  public:
+    AlarmEngine();
+    // slotChannel maps analog slots to channels[]; bits and outputMicros
+    // describe the sampler's decimated outputs
+    void begin(const AlarmRule *rules, byte n, const Channel *channels,
+               const byte *slotChannel, byte slots, uint8_t bits, uint32_t outputMicros);
+    // from the ADC interrupt, each decimated output
+    void adc(uint8_t slot, int32_t raw);
+    // from loop(), each reading of the channels; vals indexed like channels[]
+    void sample(const float *vals, uint32_t ms);
+
+    bool nextEvent(AlarmEvent *e);
+    // an event's value back in the channel's units (per second for a rate)
+    float value(const AlarmEvent &e) const;
+    const AlarmRule &rule(byte r) const { return _rules[r]; }
+    bool active(byte r) const { return _state[r].active; }
+    byte activeCount() const;
+    // CSV: worst-case evaluation per path, then each rule's state
+    void dump(Print *pr);
+    void reset();
+  private:
+    struct State {
+      uint8_t slot;     // analog slot, or ALARM_NO_SLOT for sample()
+      bool low;         // fires at or below set
+      bool rate;
+      bool primed;      // last holds a sample
+      volatile bool active;
+      int32_t set;
+      int32_t clear;
+      int32_t last;
+      uint32_t lastMs;
+      float toUnits;    // raw * toUnits + offset is the channel value
+      float offset;
+      volatile uint8_t *port;
+      uint8_t mask;
+      uint16_t edges;
+    };
+    void step(byte r, int32_t v);
+
+    const AlarmRule *_rules;
+    byte _n;
+    State _state[ALARM_MAX_RULES];
+    AlarmEvent _queue[ALARM_QUEUE];
+    volatile uint8_t _head;
+    volatile uint8_t _tail;
+    volatile uint16_t _dropped;
+    // worst case, in CPU cycles
+    volatile uint32_t _isrCount;
+    volatile uint32_t _isrMax;
+    uint32_t _loopCount;
+    uint32_t _loopMax;
+};
+
+#endif
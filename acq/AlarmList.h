@@ -0,0 +1,30 @@
+/*
+  AlarmList.h - The arduinacq alarm rules.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  One rule per line, on a channel of ChannelList.h by name. Limits and
+  hysteresis are in the channel's units, per second for ALARM_RATE; see
+  AlarmEngine.h for what each kind does. pin is a digital output held high
+  while the alarm is active, 0 for none. A rule on a channel that is
+  neither logged nor plotted never sees a sample.
+
+  Expanded by acq.ino into the AlarmRule table with ALARM_ENTRY, after the
+  channel indices.
+*/
+
+#ifndef AlarmList_h
+#define AlarmList_h
+
+#include "AlarmEngine.h"
+
+//   name,      channel, kind,       limit, hysteresis, pin
+#define ACQ_ALARM_LIST(AL) \
+  AL(a0_high,   a0,      ALARM_HIGH, 4500,  100,        22) \
+  AL(a0_rate,   a0,      ALARM_RATE, 5000,  1000,       23) \
+  AL(a1_low,    a1,      ALARM_LOW,  200,   50,         24) \
+  AL(tc0_high,  tc0,     ALARM_HIGH, 90,    2,          25) \
+  AL(tc1_high,  tc1,     ALARM_HIGH, 90,    2,          26)
+
+#endif
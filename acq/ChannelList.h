@@ -0,0 +1,32 @@
+/*
+  ChannelList.h - The arduinacq channel list.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Log columns, plot traces and the legend follow list order. A channel that
+  is neither logged nor plotted is never read. Analog scale 4.883 converts
+  0-1024 to mV. Thermocouple index selects tc_vals[] in acq.ino.
+
+  Expanded by acq.ino into both the runtime Channel table and the compiled
+  ChannelPipeline; see ChannelPipeline.h. Needs Adafruit_RA8875.h for the
+  colours.
+*/
+
+#ifndef ChannelList_h
+#define ChannelList_h
+
+#include "Channels.h"
+
+//   name, source,             index, scale, offset, label, units, colour,         axis,         logged
+#define ACQ_CHANNEL_LIST(CH) \
+  CH(a0,   CH_SRC_ANALOG,      0,     4.883, 0,      "A0",  "mV",  RA8875_WHITE,   CH_AXIS_MV,   true) \
+  CH(a1,   CH_SRC_ANALOG,      1,     4.883, 0,      "A1",  "mV",  RA8875_YELLOW,  CH_AXIS_MV,   true) \
+  CH(a2,   CH_SRC_ANALOG,      2,     4.883, 0,      "A2",  "mV",  RA8875_GREEN,   CH_AXIS_MV,   true) \
+  CH(a3,   CH_SRC_ANALOG,      3,     4.883, 0,      "A3",  "mV",  RA8875_CYAN,    CH_AXIS_MV,   true) \
+  CH(t0,   CH_SRC_TC_INTERNAL, 0,     1,     0,      "T0",  "C",   RA8875_RED,     CH_AXIS_DEGC, true) \
+  CH(t1,   CH_SRC_TC_INTERNAL, 1,     1,     0,      "T1",  "C",   RA8875_MAGENTA, CH_AXIS_DEGC, true) \
+  CH(tc0,  CH_SRC_TC,          0,     1,     0,      "TC0", "C",   RA8875_RED,     CH_AXIS_NONE, true) \
+  CH(tc1,  CH_SRC_TC,          1,     1,     0,      "TC1", "C",   RA8875_MAGENTA, CH_AXIS_NONE, true)
+
+#endif
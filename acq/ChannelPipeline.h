@@ -0,0 +1,171 @@
+/*
+  ChannelPipeline.h - Per-sample channel path generated at compile time.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  A channel list is written once as an X-macro (see ChannelList.h):
+
+    #define MY_CHANNELS(CH) \
+      CH(a0, CH_SRC_ANALOG, 0, 4.883, 0, "A0", "mV", RA8875_WHITE, CH_AXIS_MV, true) \
+      ...
+
+  and expanded four ways:
+
+    MY_CHANNELS(CHANNEL_TRAITS)                      one traits struct per channel
+    ChannelPipeline<0, 0 MY_CHANNELS(CHANNEL_TYPE)>  the compile-time pipeline
+    { MY_CHANNELS(CHANNEL_ENTRY) }                   the runtime Channel table for the GUI
+    enum { MY_CHANNELS(CHANNEL_INDEX) };             CH_<name>, each channel's table index
+
+  The pipeline unrolls read -> scale -> aggregate -> format into straight-line
+  code per channel. Source, scale, offset, axis and logging flag are all
+  template constants, so disabled channels vanish, scale == 1 folds away and
+  there is no per-channel branch or function pointer left on the AVR.
+
+  Sources is any class with
+    float analog(uint8_t slot);        decimated ADC value, 0-1023 units
+    float thermocouple(uint8_t index);
+    float internal(uint8_t index);
+  Analog slots are numbered in list order over active analog channels, the
+  same order adcPins() hands them to the AdcSampler.
+*/
+
+#ifndef ChannelPipeline_h
+#define ChannelPipeline_h
+
+#include "Arduino.h"
+#include "Channels.h"
+
+#define CHANNEL_TRAITS(name, src, idx, sc, off, lbl, un, col, ax, lg) \
+  struct Channel_##name { \
+    static_assert(src == CH_SRC_ANALOG || idx < CH_THERMOCOUPLES, \
+                  "channel " #name ": no such thermocouple"); \
+    static const uint8_t source = src; \
+    static const uint8_t index = idx; \
+    static const uint8_t axis = ax; \
+    static const bool logged = lg; \
+    static const bool active = lg || ax != CH_AXIS_NONE; \
+    static float scale() { return sc; } \
+    static float offset() { return off; } \
+  };
+#define CHANNEL_TYPE(name, ...) , Channel_##name
+#define CHANNEL_ENTRY(name, src, idx, sc, off, lbl, un, col, ax, lg) \
+  {src, idx, sc, off, lbl, un, col, ax, lg},
+#define CHANNEL_INDEX(name, ...) CH_##name,
+
+template <uint8_t Src> struct ChannelSource;
+
+template <> struct ChannelSource<CH_SRC_ANALOG> {
+  template <class S> static float read(S &s, uint8_t, uint8_t slot) {
+    return s.analog(slot);
+  }
+};
+
+template <> struct ChannelSource<CH_SRC_TC> {
+  template <class S> static float read(S &s, uint8_t index, uint8_t) {
+    return s.thermocouple(index);
+  }
+};
+
+template <> struct ChannelSource<CH_SRC_TC_INTERNAL> {
+  template <class S> static float read(S &s, uint8_t index, uint8_t) {
+    return s.internal(index);
+  }
+};
+
+// one channel's stage functions; the inactive specialisation is empty
+template <uint8_t I, uint8_t Slot, class C, bool Active = C::active>
+struct ChannelStep {
+  template <class S> static void read(S &, float *) {}
+  static void aggregateMean(const float *, float *, uint16_t *) {}
+  static void aggregateMinMax(const float *, float *, float *, uint16_t *) {}
+  static void format(Print &, const float *) {}
+  static void adcPin(uint8_t *) {}
+};
+
+template <uint8_t I, uint8_t Slot, class C>
+struct ChannelStep<I, Slot, C, true> {
+  template <class S> static void read(S &s, float *vals) {
+    vals[I] = ChannelSource<C::source>::read(s, C::index, Slot) * C::scale() + C::offset();
+  }
+  // the axis and logged tests below are constants and fold away. n[I]
+  // counts the readings folded in; a NAN one (a thermocouple fault) is
+  // skipped rather than left in the mean or the min and max for good
+  static void aggregateMean(const float *vals, float *cma, uint16_t *n) {
+    if (C::axis != CH_AXIS_NONE && !isnan(vals[I])) {
+      n[I] = n[I] + 1;
+      cma[I] = n[I] == 1 ? vals[I] : ((n[I] - 1) * cma[I] + vals[I]) / n[I];
+    }
+  }
+  static void aggregateMinMax(const float *vals, float *mx, float *mn, uint16_t *n) {
+    if (C::axis != CH_AXIS_NONE && !isnan(vals[I])) {
+      n[I] = n[I] + 1;
+      if (n[I] == 1 || mx[I] < vals[I]) {
+        mx[I] = vals[I];
+      }
+      if (n[I] == 1 || mn[I] > vals[I]) {
+        mn[I] = vals[I];
+      }
+    }
+  }
+  static void format(Print &p, const float *vals) {
+    if (C::logged) {
+      p.print('\t');
+      p.print(vals[I]);
+    }
+  }
+  static void adcPin(uint8_t *pins) {
+    if (C::source == CH_SRC_ANALOG) {
+      pins[Slot] = A0 + C::index;
+    }
+  }
+};
+
+// I is the channel's position in the list (its index into the value arrays),
+// Slot the AdcSampler slot the next active analog channel will get
+template <uint8_t I, uint8_t Slot, class... Cs>
+struct ChannelPipeline {
+  enum { channels = 0, adcChannels = 0, usesThermocouples = 0 };
+  template <class S> static void read(S &, float *) {}
+  static void aggregateMean(const float *, float *, uint16_t *) {}
+  static void aggregateMinMax(const float *, float *, float *, uint16_t *) {}
+  static void format(Print &, const float *) {}
+  static void adcPins(uint8_t *) {}
+};
+
+template <uint8_t I, uint8_t Slot, class C, class... Rest>
+struct ChannelPipeline<I, Slot, C, Rest...> {
+  typedef ChannelStep<I, Slot, C> Step;
+  typedef ChannelPipeline<I + 1, Slot + (C::active && C::source == CH_SRC_ANALOG), Rest...> Next;
+
+  enum {
+    channels = 1 + Next::channels,
+    adcChannels = (C::active && C::source == CH_SRC_ANALOG) + Next::adcChannels,
+    usesThermocouples = (C::active && C::source != CH_SRC_ANALOG) || Next::usesThermocouples
+  };
+
+  template <class S> static inline void read(S &s, float *vals) {
+    Step::read(s, vals);
+    Next::read(s, vals);
+  }
+  static inline void aggregateMean(const float *vals, float *cma, uint16_t *n) {
+    Step::aggregateMean(vals, cma, n);
+    Next::aggregateMean(vals, cma, n);
+  }
+  static inline void aggregateMinMax(const float *vals, float *mx, float *mn, uint16_t *n) {
+    Step::aggregateMinMax(vals, mx, mn, n);
+    Next::aggregateMinMax(vals, mx, mn, n);
+  }
+  // prints "\t<value>" for every logged channel, in list order
+  static inline void format(Print &p, const float *vals) {
+    Step::format(p, vals);
+    Next::format(p, vals);
+  }
+  // fills pins[0..adcChannels-1] for AdcSampler::begin()
+  static inline void adcPins(uint8_t *pins) {
+    Step::adcPin(pins);
+    Next::adcPins(pins);
+  }
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+  Channels.h - Channel configuration table entries for arduinacq.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Every acquired value is described by one Channel entry: where the raw value
+  comes from, how it is scaled to engineering units (value = raw * scale +
+  offset), how it is labelled and coloured, which plot axis it is drawn
+  against and whether it is written to the log. The sampler, logger,
+  aggregator and renderer in acq.ino all walk the same table.
+*/
+
+#ifndef Channels_h
+#define Channels_h
+
+#include "Arduino.h"
+
+// channel sources; index is the analog pin offset from A0 or the thermocouple number
+#define CH_SRC_ANALOG       0  // decimated ADC reading in 0-1023 units
+#define CH_SRC_TC           1  // MAX31855 thermocouple temperature, C
+#define CH_SRC_TC_INTERNAL  2  // MAX31855 cold-junction temperature, C
+// thermocouple numbers run 0..CH_THERMOCOUPLES-1, the MAX31855Pair's chips
+#define CH_THERMOCOUPLES    2
+
+// plot axes
+#define CH_AXIS_NONE  0  // not plotted
+#define CH_AXIS_MV    1  // left axis, 0-5000 mV
+#define CH_AXIS_DEGC  2  // right axis, b_graphlimits temperature range
+
+#define MAX_CHANNELS 24
+
+struct Channel {
+  uint8_t source;
+  uint8_t index;
+  float scale;
+  float offset;
+  const char *label;
+  const char *units;
+  uint16_t colour;
+  uint8_t axis;
+  bool logged;
+};
+
+#endif
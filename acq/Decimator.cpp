@@ -0,0 +1,50 @@
+#include "Arduino.h"
+#include "Decimator.h"
+
+Decimator::Decimator() {
+  configure(0, DECIMATE_BOXCAR);
+}
+
+void Decimator::configure(uint8_t log4ratio, uint8_t filter) {
+  if (log4ratio > DECIMATE_MAX_LOG4) {
+    log4ratio = DECIMATE_MAX_LOG4;
+  }
+  _log4 = log4ratio;
+  _filter = filter;
+  _ratio = 1 << (2 * log4ratio);
+  _n = 0;
+  _acc1 = 0;
+  _acc2 = 0;
+  _comb1 = 0;
+  _comb2 = 0;
+  _out = 0;
+}
+
+bool Decimator::push(uint16_t sample) {
+  _acc1 += sample;
+  if (_filter == DECIMATE_CIC) {
+    _acc2 += _acc1;
+  }
+  if (++_n < _ratio) {
+    return false;
+  }
+  _n = 0;
+
+  if (_filter == DECIMATE_CIC) {
+    // two comb stages at the output rate; gain is ratio^2 = 2^(4n)
+    uint32_t c1 = _acc2 - _comb1;
+    _comb1 = _acc2;
+    uint32_t c2 = c1 - _comb2;
+    _comb2 = c1;
+    _out = c2 >> (3 * _log4);
+  }
+  else {
+    _out = (_filter == DECIMATE_BOXCAR) ? (int32_t)(_acc1 >> _log4) : (int32_t)_acc1;
+    _acc1 = 0;
+  }
+  return true;
+}
+
+uint8_t Decimator::bits() const {
+  return (_filter == DECIMATE_ACCUM) ? 10 + 2 * _log4 : 10 + _log4;
+}
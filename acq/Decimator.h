@@ -0,0 +1,52 @@
+/*
+  Decimator.h - Oversample-and-decimate stage for raw ADC samples.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Each Decimator takes 4^n raw 10-bit samples per output and gains n extra
+  effective bits (white noise drops by 2^n per output). Everything runs on
+  integer accumulators so it can be fed from the ADC interrupt.
+
+    DECIMATE_ACCUM   plain sum of the 4^n samples (10 + 2n bits)
+    DECIMATE_BOXCAR  the sum shifted right by n (10 + n bits)
+    DECIMATE_CIC     2nd order CIC, decimating by 4^n (10 + n bits); better
+                     alias rejection than the boxcar for the same ratio
+*/
+
+#ifndef Decimator_h
+#define Decimator_h
+
+#include "Arduino.h"
+
+#define DECIMATE_ACCUM  0
+#define DECIMATE_BOXCAR 1
+#define DECIMATE_CIC    2
+
+// 4^5 = 1024 samples per output; the CIC gain of (4^n)^2 * 1023 must fit 32 bits
+#define DECIMATE_MAX_LOG4 5
+
+class Decimator {
+  public:
+    Decimator();
+    void configure(uint8_t log4ratio, uint8_t filter);
+    // returns true when a new decimated output is available from value()
+    bool push(uint16_t sample);
+    int32_t value() const { return _out; }
+    // effective bits of value()
+    uint8_t bits() const;
+  private:
+    uint8_t _log4;
+    uint8_t _filter;
+    uint16_t _ratio;
+    uint16_t _n;
+    // integrators run at the input rate and are allowed to wrap; the comb
+    // differences come out right as long as the output fits 32 bits
+    uint32_t _acc1;
+    uint32_t _acc2;
+    uint32_t _comb1;
+    uint32_t _comb2;
+    int32_t _out;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "Arduino.h"
+#include "DiagLog.h"
+
+DiagLog diagLog;
+
+static const char levelLetters[] = "-EWID";
+
+// formats into the line buffer, cutting off what doesn't fit before the CRLF
+class LineWriter : public Print {
+  public:
+    LineWriter(char *buf, uint8_t size) : _buf(buf), _size(size), _len(0) {}
+    size_t write(uint8_t c) {
+      if (_len + 2 >= _size) {
+        return 0;
+      }
+      _buf[_len] = c;
+      _len = _len + 1;
+      return 1;
+    }
+    using Print::write;
+    uint8_t end() {
+      _buf[_len] = '\r';
+      _buf[_len + 1] = '\n';
+      return _len + 2;
+    }
+  private:
+    char *_buf;
+    uint8_t _size;
+    uint8_t _len;
+};
+
+DiagLog::DiagLog() {
+  _head = 0;
+  _tail = 0;
+  _dropped = 0;
+  _reported = 0;
+  _lineLen = 0;
+  _linePos = 0;
+}
+
+// the oldest record, or once they are all out a note of any dropped, into
+// the line buffer
+bool DiagLog::format() {
+  LineWriter line(_line, sizeof(_line));
+  if (_tail == _head) {
+    if (_dropped == _reported) {
+      return false;
+    }
+    line.print(millis());
+    line.print(" W dropped ");
+    line.print((uint16_t)(_dropped - _reported));
+    line.print(" messages");
+    _reported = _dropped;
+  }
+  else {
+    uint8_t t = _tail;
+    uint8_t end = t + get(t);
+    t = t + 1;
+    uint8_t level = get(t);
+    t = t + 1;
+    uint32_t ms;
+    const char *format;
+    uint8_t *b = (uint8_t *)&ms;
+    for (uint8_t i = 0; i < sizeof(ms); i = i + 1) {
+      b[i] = get(t);
+      t = t + 1;
+    }
+    b = (uint8_t *)&format;
+    for (uint8_t i = 0; i < sizeof(format); i = i + 1) {
+      b[i] = get(t);
+      t = t + 1;
+    }
+    line.print(ms);
+    line.write(' ');
+    line.write(levelLetters[level <= DIAG_LEVEL_DEBUG ? level : 0]);
+    line.write(' ');
+    char c;
+    while ((c = pgm_read_byte(format)) != 0) {
+      format = format + 1;
+      if (c != '%' || t == end) {
+        line.write(c);
+        continue;
+      }
+      char tag = get(t);
+      t = t + 1;
+      if (tag == DIAG_TAG_STRING) {
+        uint8_t n = get(t);
+        t = t + 1;
+        for (uint8_t i = 0; i < n; i = i + 1) {
+          line.write(get(t));
+          t = t + 1;
+        }
+        continue;
+      }
+      uint32_t v;
+      b = (uint8_t *)&v;
+      for (uint8_t i = 0; i < sizeof(v); i = i + 1) {
+        b[i] = get(t);
+        t = t + 1;
+      }
+      if (tag == DIAG_TAG_FLOAT) {
+        float f;
+        memcpy(&f, &v, sizeof(f));
+        line.print(f);
+      }
+      else if (tag == DIAG_TAG_ULONG) {
+        line.print((unsigned long)v);
+      }
+      else {
+        line.print((long)(int32_t)v);
+      }
+    }
+    _tail = end;
+  }
+  _lineLen = line.end();
+  _linePos = 0;
+  return true;
+}
+
+void DiagLog::drain(HardwareSerial &out) {
+  for (;;) {
+    if (_linePos == _lineLen && !format()) {
+      return;
+    }
+    int room = out.availableForWrite();
+    if (room <= 0) {
+      return;
+    }
+    uint8_t n = _lineLen - _linePos;
+    if (room < n) {
+      n = room;
+    }
+    out.write((const uint8_t *)_line + _linePos, n);
+    _linePos = _linePos + n;
+  }
+}
+
+void DiagLog::flush(HardwareSerial &out) {
+  while (_linePos != _lineLen || format()) {
+    out.write((const uint8_t *)_line + _linePos, _lineLen - _linePos);
+    _linePos = _lineLen;
+  }
+}
@@ -0,0 +1,152 @@
+/*
+  DiagLog.h - Leveled diagnostic messages, queued in RAM and sent later.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  DIAG_ERROR(fmt, ...), DIAG_WARN, DIAG_INFO and DIAG_DEBUG replace
+  Serial.print in loop(). Each one stores a record in a DIAG_RING byte ring:
+  its level, millis(), the address of its format string (kept in PROGMEM)
+  and its arguments, each tagged with its type. Nothing is formatted or
+  sent then. drain(), once per pass of loop(), formats a record at a time
+  into a line buffer and sends only what Serial's TX buffer has room for,
+  so a message costs the same few microseconds whether or not the serial
+  line keeps up, and a debug build samples on the same timing as a
+  release one.
+
+  Each % in the format stands for the next argument, printed by its type:
+  integers in decimal, floats to two places, strings (copied, up to
+  DIAG_MAX_STRING characters) as they are. Lines come out as
+    millis level-letter message
+  Records that find the ring full are dropped and counted, and a line
+  saying how many follows once the ring has emptied. Messages above DIAG_LEVEL compile to nothing;
+  define it before including this header. loop() only, not interrupts.
+*/
+
+#ifndef DiagLog_h
+#define DiagLog_h
+
+#include "Arduino.h"
+
+#define DIAG_LEVEL_NONE  0
+#define DIAG_LEVEL_ERROR 1
+#define DIAG_LEVEL_WARN  2
+#define DIAG_LEVEL_INFO  3
+#define DIAG_LEVEL_DEBUG 4
+
+#ifndef DIAG_LEVEL
+#define DIAG_LEVEL DIAG_LEVEL_INFO
+#endif
+
+// uint8_t indices wrap round it for free
+#define DIAG_RING 256
+// longest formatted line, as sent; Serial's TX buffer is 64
+#define DIAG_LINE 64
+#define DIAG_MAX_STRING 16
+// a record's length, level, millis and the format's address
+#define DIAG_RECORD_FIXED (2 + 4 + sizeof(const char *))
+
+#define DIAG_TAG_LONG   'l'
+#define DIAG_TAG_ULONG  'u'
+#define DIAG_TAG_FLOAT  'f'
+#define DIAG_TAG_STRING 's'
+
+#define DIAG_AT(level, fmt, ...) do { \
+    if ((level) <= DIAG_LEVEL) { \
+      static const char diagFormat_[] PROGMEM = fmt; \
+      diagLog.log(level, diagFormat_, ##__VA_ARGS__); \
+    } \
+  } while (0)
+#define DIAG_ERROR(fmt, ...) DIAG_AT(DIAG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define DIAG_WARN(fmt, ...)  DIAG_AT(DIAG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define DIAG_INFO(fmt, ...)  DIAG_AT(DIAG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define DIAG_DEBUG(fmt, ...) DIAG_AT(DIAG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+class DiagLog {
+  public:
+    DiagLog();
+    template <class... Args>
+    void log(uint8_t level, const char *format, Args... args) {
+      uint16_t n = DIAG_RECORD_FIXED + size(args...);
+      if (n > space()) {
+        _dropped = _dropped + 1;
+        return;
+      }
+      uint8_t h = _head;
+      h = put(h, (uint8_t)n);
+      h = put(h, level);
+      h = putBytes(h, (uint32_t)millis());
+      h = putBytes(h, format);
+      h = putArgs(h, args...);
+      _head = h;
+    }
+    // sends what Serial has room for right now
+    void drain(HardwareSerial &out);
+    // sends everything, waiting on Serial; setup() and fatal errors only
+    void flush(HardwareSerial &out);
+    uint16_t dropped() const { return _dropped; }
+  private:
+    uint8_t space() const { return _tail - _head - 1; }
+    bool format();
+    uint8_t get(uint8_t at) const { return _ring[at]; }
+    uint8_t put(uint8_t at, uint8_t b) { _ring[at] = b; return at + 1; }
+    template <class T>
+    uint8_t putBytes(uint8_t at, T v) {
+      const uint8_t *b = (const uint8_t *)&v;
+      for (uint8_t i = 0; i < sizeof(T); i = i + 1) {
+        at = put(at, b[i]);
+      }
+      return at;
+    }
+
+    // bytes an argument takes in the ring, tag included
+    static uint16_t size() { return 0; }
+    template <class T, class... Rest>
+    static uint16_t size(T v, Rest... rest) { return argSize(v) + size(rest...); }
+    static uint8_t argSize(const char *s) {
+      uint8_t n = 0;
+      while (n < DIAG_MAX_STRING && s[n]) {
+        n = n + 1;
+      }
+      return 2 + n;
+    }
+    static uint8_t argSize(char *s) { return argSize((const char *)s); }
+    static uint8_t argSize(float) { return 5; }
+    static uint8_t argSize(double) { return 5; }
+    template <class T>
+    static uint8_t argSize(T) { return 5; }
+
+    uint8_t putArgs(uint8_t at) { return at; }
+    template <class T, class... Rest>
+    uint8_t putArgs(uint8_t at, T v, Rest... rest) { return putArgs(putArg(at, v), rest...); }
+    uint8_t putArg(uint8_t at, const char *s) {
+      uint8_t n = argSize(s) - 2;
+      at = put(at, DIAG_TAG_STRING);
+      at = put(at, n);
+      for (uint8_t i = 0; i < n; i = i + 1) {
+        at = put(at, s[i]);
+      }
+      return at;
+    }
+    uint8_t putArg(uint8_t at, char *s) { return putArg(at, (const char *)s); }
+    uint8_t putArg(uint8_t at, float v) { return putBytes(put(at, DIAG_TAG_FLOAT), v); }
+    uint8_t putArg(uint8_t at, double v) { return putArg(at, (float)v); }
+    uint8_t putArg(uint8_t at, unsigned long v) { return putBytes(put(at, DIAG_TAG_ULONG), (uint32_t)v); }
+    uint8_t putArg(uint8_t at, unsigned int v) { return putArg(at, (unsigned long)v); }
+    uint8_t putArg(uint8_t at, unsigned char v) { return putArg(at, (unsigned long)v); }
+    template <class T>
+    uint8_t putArg(uint8_t at, T v) { return putBytes(put(at, DIAG_TAG_LONG), (int32_t)v); }
+
+    uint8_t _ring[DIAG_RING];
+    uint8_t _head;
+    uint8_t _tail;
+    uint16_t _dropped;
+    uint16_t _reported; // of _dropped, already sent
+    char _line[DIAG_LINE];
+    uint8_t _lineLen;
+    uint8_t _linePos;
+};
+
+extern DiagLog diagLog;
+
+#endif
@@ -0,0 +1,131 @@
+#include "Arduino.h"
+#include "DiagScreen.h"
+
+DiagScreen::DiagScreen(Adafruit_RA8875 &tft) : _tft(tft) {
+}
+
+void DiagScreen::draw(byte page, int logInterval) {
+  if (page == DIAG_PAGE_LOOP) {
+    drawLoopProfile(logInterval);
+  }
+  else {
+    drawSdLatency();
+  }
+}
+
+void DiagScreen::drawTitle(const char *title) {
+  _tft.graphicsMode();
+  _tft.fillScreen(RA8875_BLACK);
+  _tft.textMode();
+  _tft.textEnlarge(0);
+  _tft.textColor(RA8875_BLACK, RA8875_WHITE);
+  _tft.textSetCursor(350, 10);
+  _tft.textWrite(title);
+  _tft.textColor(RA8875_WHITE, RA8875_BLACK);
+}
+
+void DiagScreen::drawSdLatency() {
+  drawTitle("SD LATENCY");
+  _tft.textSetCursor(20, DIAG_ROW_TOP - 25);
+  _tft.textWrite("probe");
+  _tft.textSetCursor(150, DIAG_ROW_TOP - 25);
+  _tft.textWrite("calls");
+  _tft.textSetCursor(250, DIAG_ROW_TOP - 25);
+  _tft.textWrite("max ms");
+
+  char name[16];
+  for (byte p = 0; p < SD_LAT_PROBES; p = p + 1) {
+    const SdLatencyEntry &e = SdLatency::entry(p);
+    int y = DIAG_ROW_TOP + p * DIAG_ROW_HEIGHT;
+    _tft.textMode();
+    SdLatency::name(p, name, sizeof(name));
+    _tft.textSetCursor(20, y + 10);
+    _tft.textWrite(name);
+    _tft.textSetCursor(150, y + 10);
+    _tft.print(e.count);
+    _tft.textSetCursor(250, y + 10);
+    _tft.print(e.max / (F_CPU / 1000.0), 3);
+    drawBars(y, e.hist, SD_LATENCY_BUCKETS);
+  }
+
+  // bucket 4 is 1 us at 16 MHz, 14 about 1 ms, 24 about 1 s
+  int y = DIAG_ROW_TOP + SD_LAT_PROBES * DIAG_ROW_HEIGHT;
+  _tft.textMode();
+  _tft.textSetCursor(DIAG_HIST_X0 + 4 * DIAG_BAR_WIDTH, y);
+  _tft.textWrite("1us");
+  _tft.textSetCursor(DIAG_HIST_X0 + 14 * DIAG_BAR_WIDTH, y);
+  _tft.textWrite("1ms");
+  _tft.textSetCursor(DIAG_HIST_X0 + 20 * DIAG_BAR_WIDTH, y);
+  _tft.textWrite("65ms");
+}
+
+void DiagScreen::drawBars(int y, const uint16_t *hist, byte n) {
+  _tft.graphicsMode();
+  int base = y + DIAG_ROW_HEIGHT - 6;
+  _tft.drawFastHLine(DIAG_HIST_X0, base, n * DIAG_BAR_WIDTH, RA8875_WHITE);
+  for (byte b = 0; b < n; b = b + 1) {
+    if (hist[b] == 0) {
+      continue;
+    }
+    // log2 scale, 2 px per doubling: 1 call is 2 px, 65535 is 32 px
+    byte h = 0;
+    for (uint16_t c = hist[b]; c > 0; c = c >> 1) {
+      h = h + 2;
+    }
+    // red from 1 ms up, where a sample is at risk
+    uint16_t colour = b >= 14 ? RA8875_RED : RA8875_GREEN;
+    _tft.fillRect(DIAG_HIST_X0 + b * DIAG_BAR_WIDTH, base - h, DIAG_BAR_WIDTH - 2, h, colour);
+  }
+}
+
+void DiagScreen::drawLoopProfile(int logInterval) {
+  drawTitle("LOOP PROFILE");
+  _tft.textSetCursor(20, DIAG_ROW_TOP - 25);
+  _tft.textWrite("phase");
+  _tft.textSetCursor(150, DIAG_ROW_TOP - 25);
+  _tft.textWrite("calls");
+  _tft.textSetCursor(270, DIAG_ROW_TOP - 25);
+  _tft.textWrite("min ms");
+  _tft.textSetCursor(390, DIAG_ROW_TOP - 25);
+  _tft.textWrite("avg ms");
+  _tft.textSetCursor(510, DIAG_ROW_TOP - 25);
+  _tft.textWrite("max ms");
+
+  char name[16];
+  int y = DIAG_ROW_TOP;
+  for (byte p = 0; p < PROF_PHASES; p = p + 1) {
+    const LoopPhase &ph = LoopProfiler::phase(p);
+    LoopProfiler::name(p, name, sizeof(name));
+    _tft.textSetCursor(20, y);
+    _tft.textWrite(name);
+    _tft.textSetCursor(150, y);
+    _tft.print(ph.count);
+    printMs(270, y, ph.min);
+    printMs(390, y, LoopProfiler::average(p));
+    printMs(510, y, ph.max);
+    y = y + 28;
+  }
+
+  // every pass of loop() redraws the status line and polls touch, so a row
+  // has to fit in LOG_INTERVAL alongside one of those
+  uint32_t worst = LoopProfiler::phase(PROF_ROW).max
+                   + LoopProfiler::phase(PROF_STATUS).max
+                   + LoopProfiler::phase(PROF_TOUCH).max;
+  y = y + 14;
+  _tft.textSetCursor(20, y);
+  _tft.textWrite("worst row + status + touch:");
+  printMs(270, y, worst);
+  _tft.textSetCursor(390, y);
+  _tft.textWrite("LOG_INTERVAL:");
+  _tft.textSetCursor(510, y);
+  if ((uint32_t)logInterval * 1000UL < worst) {
+    _tft.textColor(RA8875_RED, RA8875_BLACK);
+  }
+  _tft.print(logInterval);
+  _tft.textColor(RA8875_WHITE, RA8875_BLACK);
+}
+
+void DiagScreen::printMs(int x, int y, uint32_t us) {
+  _tft.textSetCursor(x, y);
+  _tft.print(us / 1000.0, 3);
+}
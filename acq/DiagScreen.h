@@ -0,0 +1,52 @@
+/*
+  DiagScreen.h - Hidden diagnostics pages on the TFT.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Reached by tapping the "arduinacq" title while logging is stopped; "stop
+  log" goes back. The pages draw whatever has been recorded so far, so log
+  for a while first, then stop and look.
+
+  The SD latency page has one row per SdLatency probe: calls, the slowest
+  call and a histogram with one bar per power-of-two bucket, bar height
+  log2 of the count. A stall shows up as a bar far to the right; the
+  innermost layer with that bar is the one that stalled.
+
+  The loop profile page lists LoopProfiler's phases with calls and min,
+  average and max ms, and compares the worst row plus the worst pass of
+  the phases that run every loop against LOG_INTERVAL.
+*/
+
+#ifndef DiagScreen_h
+#define DiagScreen_h
+
+#include "Arduino.h"
+#include "Adafruit_RA8875.h"
+#include <SdLatency.h>
+#include "LoopProfiler.h"
+
+#define DIAG_ROW_TOP     100
+#define DIAG_ROW_HEIGHT  38
+#define DIAG_HIST_X0     380
+#define DIAG_BAR_WIDTH   16
+// tapping the title again steps through the pages
+#define DIAG_PAGE_SD     0
+#define DIAG_PAGE_LOOP   1
+#define DIAG_PAGES       2
+
+class DiagScreen {
+  public:
+    DiagScreen(Adafruit_RA8875 &tft);
+    void draw(byte page, int logInterval);
+    void drawSdLatency();
+    void drawLoopProfile(int logInterval);
+  private:
+    void drawTitle(const char *title);
+    void drawBars(int y, const uint16_t *hist, byte n);
+    void printMs(int x, int y, uint32_t us);
+
+    Adafruit_RA8875 &_tft;
+};
+
+#endif
@@ -5,6 +5,8 @@ Written by Helge Langehaug, February 2014
 BSD license, all text above must be included in any redistribution
 *************************************************************************/
 
+#ifndef FT5x06_h
+#define FT5x06_h
 
 /* FT5206 definitions */
 #define FT5206_I2C_ADDRESS 0x38
@@ -65,3 +67,5 @@ class FT5x06 {
  private:
   uint8_t _ctpInt;
 };
+
+#endif
@@ -0,0 +1,236 @@
+#include "Arduino.h"
+#include "FileServer.h"
+
+static uint16_t crc16(const uint8_t *b, uint16_t n) {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < n; i = i + 1) {
+    crc = crc ^ ((uint16_t)b[i] << 8);
+    for (uint8_t k = 0; k < 8; k = k + 1) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static uint8_t put32(uint8_t *b, uint32_t v) {
+  b[0] = v;
+  b[1] = v >> 8;
+  b[2] = v >> 16;
+  b[3] = v >> 24;
+  return 4;
+}
+
+FileServer::FileServer(SdFat &sd) : _sd(sd) {
+  _state = FILE_SERVER_IDLE;
+  _reading = false;
+  _lineLen = 0;
+  _lead = false;
+  _len = 0;
+  _pos = 0;
+  _growing = 0;
+  _growingEnd = 0;
+  _dirPos = 0;
+}
+
+void FileServer::growing(const char *name, uint32_t end) {
+  _growing = name;
+  _growingEnd = end;
+}
+
+uint32_t FileServer::size(SdBaseFile &f, const char *name) const {
+  if (_growing && strcasecmp(name, _growing) == 0 && _growingEnd < f.fileSize()) {
+    return _growingEnd;
+  }
+  return f.fileSize();
+}
+
+void FileServer::request() {
+  _reading = true;
+  _lineLen = 0;
+}
+
+void FileServer::feed(char c) {
+  if (c == '\r') {
+    return;
+  }
+  if (c != '\n') {
+    if (_lineLen < FILE_SERVER_LINE - 1) {
+      _line[_lineLen] = c;
+      _lineLen = _lineLen + 1;
+    }
+    return;
+  }
+  _line[_lineLen] = '\0';
+  _reading = false;
+  _lineLen = 0;
+  start(_line);
+}
+
+void FileServer::start(char *line) {
+  // a new request cuts off whatever was going; its leading 0 resyncs the host
+  if (_file.isOpen()) {
+    _file.close();
+  }
+  _state = FILE_SERVER_IDLE;
+  _len = 0;
+  _pos = 0;
+  _lead = true;
+  _count = 0;
+
+  if (line[0] == 'l') {
+    _dirPos = 0;
+    _state = FILE_SERVER_LISTING;
+  }
+  else if (line[0] == 'g') {
+    char *name = line + 1;
+    while (*name == ' ') {
+      name = name + 1;
+    }
+    char *end = strchr(name, ' ');
+    _offset = 0;
+    if (end) {
+      *end = '\0';
+      _offset = strtoul(end + 1, 0, 10);
+    }
+    if (strlen(name) >= sizeof(_name) || !_file.open(name, O_READ)) {
+      stop(FILE_SERVER_NOT_FOUND);
+      return;
+    }
+    strcpy(_name, name);
+    _count = size(_file, _name);
+    if (_offset > _count) {
+      _offset = _count;
+    }
+    if (!_file.seekSet(_offset)) {
+      stop(FILE_SERVER_READ_ERROR);
+      return;
+    }
+    _state = FILE_SERVER_SENDING;
+  }
+  else if (line[0] == 'x') {
+    stop(FILE_SERVER_STOPPED);
+  }
+  else {
+    stop(FILE_SERVER_BAD_REQUEST);
+  }
+}
+
+// queues the 'E' frame ending the reply
+void FileServer::stop(uint8_t status) {
+  if (_file.isOpen()) {
+    _file.close();
+  }
+  _payload[0] = FILE_SERVER_END;
+  _payload[1] = status;
+  put32(_payload + 2, _count);
+  frame(6);
+  _state = FILE_SERVER_ENDING;
+}
+
+// CRCs and COBS encodes n bytes of _payload into _frame
+void FileServer::frame(uint8_t n) {
+  uint16_t crc = crc16(_payload, n);
+  _payload[n] = crc;
+  _payload[n + 1] = crc >> 8;
+  n = n + 2;
+
+  uint16_t h = 0;
+  if (_lead) {
+    _frame[h] = 0;
+    h = h + 1;
+    _lead = false;
+  }
+  uint16_t code = h;
+  uint8_t run = 1;
+  h = h + 1;
+  for (uint8_t i = 0; i < n; i = i + 1) {
+    if (_payload[i] != 0) {
+      _frame[h] = _payload[i];
+      h = h + 1;
+      run = run + 1;
+    }
+    if (_payload[i] == 0 || run == 0xFF) {
+      _frame[code] = run;
+      code = h;
+      h = h + 1;
+      run = 1;
+    }
+  }
+  _frame[code] = run;
+  _frame[h] = 0;
+  _len = h + 1;
+  _pos = 0;
+}
+
+// the reply's next frame into _frame; false once it has all gone
+bool FileServer::next() {
+  if (_state == FILE_SERVER_LISTING) {
+    SdFile f;
+    SdBaseFile *dir = _sd.vwd();
+    if (!dir->seekSet(_dirPos)) {
+      stop(FILE_SERVER_READ_ERROR);
+      return true;
+    }
+    while (f.openNext(dir, O_READ)) {
+      _dirPos = dir->curPosition();
+      if (f.isFile()) {
+        uint8_t n = 1;
+        _payload[0] = FILE_SERVER_LIST;
+        char *name = (char *)_payload + 5;
+        f.getFilename(name);
+        n = n + put32(_payload + n, size(f, name));
+        n = n + strlen((char *)_payload + n) + 1;
+        f.close();
+        _count = _count + 1;
+        frame(n);
+        return true;
+      }
+      f.close();
+    }
+    stop(FILE_SERVER_OK);
+    return true;
+  }
+  if (_state == FILE_SERVER_SENDING) {
+    // the log being written may have grown since the last chunk
+    _count = size(_file, _name);
+    uint16_t want = FILE_SERVER_CHUNK;
+    if (_count - _offset < want) {
+      want = _count - _offset;
+    }
+    int n = want > 0 ? _file.read(_payload + 5, want) : 0;
+    if (n < 0) {
+      stop(FILE_SERVER_READ_ERROR);
+      return true;
+    }
+    if (n == 0) {
+      stop(FILE_SERVER_OK);
+      return true;
+    }
+    _payload[0] = FILE_SERVER_DATA;
+    put32(_payload + 1, _offset);
+    _offset = _offset + n;
+    frame(5 + n);
+    return true;
+  }
+  _state = FILE_SERVER_IDLE;
+  return false;
+}
+
+void FileServer::poll(HardwareSerial &out) {
+  uint32_t start = micros();
+  while (micros() - start < FILE_SERVER_BUDGET_US) {
+    if (_pos == _len && !next()) {
+      return;
+    }
+    int room = out.availableForWrite();
+    if (room <= 0) {
+      continue; // the UART frees a byte every 20 us at 500 kbaud
+    }
+    uint16_t n = _len - _pos;
+    if (room < n) {
+      n = room;
+    }
+    out.write(_frame + _pos, n);
+    _pos = _pos + n;
+  }
+}
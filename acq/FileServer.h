@@ -0,0 +1,101 @@
+/*
+  FileServer.h - Lists and sends the card's files over Serial.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Requests are text lines on Serial, the 'f' taken by handleSerial():
+    fl              list the files in the root directory
+    fg NAME OFFSET  send NAME from byte OFFSET on
+    fx              stop what's being sent
+  A reply is a 0 byte, so the host can drop any text before it, then
+  frames. Each frame is COBS encoded with a CRC-16 (CCITT, initial
+  0xFFFF) of its payload after it, all little-endian, and ends in a 0:
+    'L'  size (4), then the 8.3 name, 0-terminated: one file
+    'C'  offset (4), then up to FILE_SERVER_CHUNK bytes of the file
+    'E'  status (1), count (4): the end of the reply; the count is of
+         files listed or the file's size
+  A frame that fails its CRC is only lost, since the host picks up again
+  with fg at the first byte it hasn't got. host/logget is that host. The
+  log being written is sent as far as it has been written, so asking again
+  later picks up the rows logged since.
+
+  Sending is done by poll(), once per pass of loop(), and never takes more
+  than FILE_SERVER_BUDGET_US of a pass, so logging carries on on time.
+  Chunks are read through the SdFat block cache, so the card reads each
+  512-byte block once for every four chunks unless logging uses the cache
+  in between.
+*/
+
+#ifndef FileServer_h
+#define FileServer_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+
+#define FILE_SERVER_CHUNK     128
+#define FILE_SERVER_BUDGET_US 2000
+#define FILE_SERVER_LINE      32
+
+#define FILE_SERVER_LIST        'L'
+#define FILE_SERVER_DATA        'C'
+#define FILE_SERVER_END         'E'
+
+// 'E' status
+#define FILE_SERVER_OK          0
+#define FILE_SERVER_NOT_FOUND   1
+#define FILE_SERVER_READ_ERROR  2
+#define FILE_SERVER_BAD_REQUEST 3
+#define FILE_SERVER_STOPPED     4
+
+// kind, offset, a chunk and the CRC
+#define FILE_SERVER_PAYLOAD (1 + 4 + FILE_SERVER_CHUNK + 2)
+// a reply's leading 0, one code byte per 254 and the trailing 0
+#define FILE_SERVER_FRAME   (FILE_SERVER_PAYLOAD + FILE_SERVER_PAYLOAD / 254 + 3)
+
+class FileServer {
+  public:
+    FileServer(SdFat &sd);
+    // handleSerial() got an 'f'; the rest of the line goes to feed()
+    void request();
+    // a character of the request; it runs on '\n'
+    void feed(char c);
+    bool reading() const { return _reading; }
+    // a reply is going out; nothing else may write to Serial
+    bool busy() const { return _state != FILE_SERVER_IDLE || _pos < _len; }
+    // the log being written, whose file size is its whole preallocated
+    // extent, and how much of it holds data; 0 for none. Listing and
+    // sending it stop at end
+    void growing(const char *name, uint32_t end);
+    void poll(HardwareSerial &out);
+  private:
+    enum { FILE_SERVER_IDLE, FILE_SERVER_LISTING, FILE_SERVER_SENDING, FILE_SERVER_ENDING };
+
+    void start(char *line);
+    void stop(uint8_t status);
+    bool next();
+    void frame(uint8_t n);
+    uint32_t size(SdBaseFile &f, const char *name) const;
+
+    SdFat &_sd;
+    SdFile _file;
+    uint8_t _state;
+    uint32_t _count;
+    uint32_t _offset;
+    // where the listing is in the root directory; opening a file by name
+    // between polls moves vwd's own position
+    uint32_t _dirPos;
+    char _name[13];
+    const char *_growing;
+    uint32_t _growingEnd;
+    bool _reading;
+    char _line[FILE_SERVER_LINE];
+    uint8_t _lineLen;
+    bool _lead; // the reply's first frame goes out after a 0
+    uint8_t _payload[FILE_SERVER_PAYLOAD];
+    uint8_t _frame[FILE_SERVER_FRAME];
+    uint16_t _len;
+    uint16_t _pos;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "Arduino.h"
+#include "FrameStream.h"
+#include "AdcSampler.h"
+
+FrameStream frameStream;
+
+// the header is built in the SharedBuffer after the ring, and has to fit
+// the empty ring encoded
+#define FRAME_STREAM_MAX_HEADER (FRAME_STREAM_RING - 8)
+
+static_assert(FRAME_STREAM_RING + FRAME_STREAM_MAX_HEADER <= SHARED_BUFFER_BYTES,
+              "the stream's ring and header don't fit the SharedBuffer");
+
+static bool append(uint8_t *buf, uint8_t &n, const void *src, uint8_t len) {
+  if (n + len > FRAME_STREAM_MAX_HEADER) {
+    return false;
+  }
+  memcpy(buf + n, src, len);
+  n = n + len;
+  return true;
+}
+
+FrameStream::FrameStream() {
+  _running = false;
+  _synced = false;
+  _slots = 0;
+  _seq = 0;
+  _dropped = 0;
+  _head = 0;
+  _tail = 0;
+  _ring = 0;
+}
+
+bool FrameStream::start(unsigned long baud, const Channel *channels, const byte *slotChannel, byte slots) {
+  stop();
+  // whatever the last run left unsent goes, and with it the last claim
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  FRAME_STREAM_UCSRB = 0;
+  _head = 0;
+  _tail = 0;
+  SREG = oldSREG;
+  SharedBuffer::release(SHARED_STREAM);
+  if (slots == 0 || 7 + 2 * slots > FRAME_STREAM_MAX_DATA) {
+    return false;
+  }
+  _ring = SharedBuffer::claim(SHARED_STREAM);
+  if (!_ring) {
+    return false;
+  }
+
+  uint8_t *buf = _ring + FRAME_STREAM_RING;
+  uint8_t n = 0;
+  uint8_t head[] = {FRAME_STREAM_HEADER, FRAME_STREAM_VERSION,
+                    ADC_SAMPLER_CONVERSION_US & 0xFF, ADC_SAMPLER_CONVERSION_US >> 8, slots};
+  bool ok = append(buf, n, head, sizeof(head));
+  for (byte s = 0; s < slots; s = s + 1) {
+    const Channel &c = channels[slotChannel[s]];
+    ok = ok && append(buf, n, &c.scale, 4) && append(buf, n, &c.offset, 4)
+         && append(buf, n, c.label, strlen(c.label) + 1)
+         && append(buf, n, c.units, strlen(c.units) + 1);
+  }
+  if (!ok) {
+    SharedBuffer::release(SHARED_STREAM);
+    return false;
+  }
+
+  // double speed, so 2 Mbaud is UBRR 0 at 16 MHz; 8N1, transmit only
+  oldSREG = SREG;
+  noInterrupts();
+  FRAME_STREAM_UBRR = F_CPU / 8 / baud - 1;
+  FRAME_STREAM_UCSRA = 1 << FRAME_STREAM_U2X;
+  FRAME_STREAM_UCSRC = (1 << FRAME_STREAM_UCSZ1) | (1 << FRAME_STREAM_UCSZ0);
+  FRAME_STREAM_UCSRB = 1 << FRAME_STREAM_TXEN;
+  SREG = oldSREG;
+
+  encode(buf, n);
+  _slots = slots;
+  _seq = 0;
+  _dropped = 0;
+  _synced = false;
+  _running = true;
+  return true;
+}
+
+void FrameStream::stop() {
+  _running = false;
+  // with the ring already empty no interrupt is coming to do it
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  if (_tail == _head) {
+    FRAME_STREAM_UCSRB &= ~((1 << FRAME_STREAM_UDRIE) | (1 << FRAME_STREAM_TXEN));
+    SharedBuffer::release(SHARED_STREAM);
+  }
+  SREG = oldSREG;
+}
+
+void FrameStream::encode(const uint8_t *buf, uint8_t n) {
+  // nothing is published until the whole frame is in, since each block's
+  // code byte is only known once the block ends
+  uint8_t h = _head;
+  uint8_t code = h;
+  uint8_t run = 1;
+  h = h + 1;
+  for (uint8_t i = 0; i < n; i = i + 1) {
+    if (buf[i] != 0) {
+      _ring[h] = buf[i];
+      h = h + 1;
+      run = run + 1;
+    }
+    if (buf[i] == 0 || run == 0xFF) {
+      _ring[code] = run;
+      code = h;
+      h = h + 1;
+      run = 1;
+    }
+  }
+  _ring[code] = run;
+  _ring[h] = 0;
+  _head = h + 1;
+  FRAME_STREAM_UCSRB |= 1 << FRAME_STREAM_UDRIE;
+}
+
+void FrameStream::push(uint8_t slot, uint16_t sample) {
+  if (!_running) {
+    return;
+  }
+  if (slot == 0) {
+    uint32_t t = micros();
+    _frame[3] = t;
+    _frame[4] = t >> 8;
+    _frame[5] = t >> 16;
+    _frame[6] = t >> 24;
+    _synced = true;
+  }
+  if (!_synced) {
+    return; // started partway through a round
+  }
+  _frame[7 + 2 * slot] = sample;
+  _frame[8 + 2 * slot] = sample >> 8;
+  if (slot + 1 < _slots) {
+    return;
+  }
+
+  uint16_t seq = _seq;
+  _seq = seq + 1;
+  uint8_t n = 7 + 2 * _slots;
+  // under 254 bytes, so one code byte and the trailing 0
+  if (space() < n + 2) {
+    _dropped = _dropped + 1;
+    return;
+  }
+  _frame[0] = FRAME_STREAM_DATA;
+  _frame[1] = seq;
+  _frame[2] = seq >> 8;
+  encode(_frame, n);
+}
+
+void FrameStream::isr() {
+  uint8_t t = _tail;
+  if (t == _head) {
+    // the USART finishes the byte it is shifting out before TXEN takes
+    if (_running) {
+      FRAME_STREAM_UCSRB &= ~(1 << FRAME_STREAM_UDRIE);
+    }
+    else {
+      // the USART finishes the byte it is shifting out before TXEN takes
+      FRAME_STREAM_UCSRB &= ~((1 << FRAME_STREAM_UDRIE) | (1 << FRAME_STREAM_TXEN));
+      SharedBuffer::release(SHARED_STREAM);
+    }
+    return;
+  }
+  FRAME_STREAM_UDR = _ring[t];
+  _tail = t + 1;
+}
+
+ISR(FRAME_STREAM_UDRE_vect) {
+  frameStream.isr();
+}
@@ -0,0 +1,98 @@
+/*
+  FrameStream.h - COBS-framed binary stream of raw ADC frames on a UART.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  With a FrameStream attached the AdcSampler hands it every raw conversion,
+  and each full round of the analog slots becomes one frame. Frames are
+  COBS encoded straight into a byte ring as they are made, and the UART's
+  data-register-empty interrupt sends the ring out a byte at a time, so
+  neither the ADC interrupt nor loop() ever waits on the line. A frame that
+  doesn't fit in the ring is dropped whole; its sequence number is used up
+  anyway, so the host can tell how many went missing.
+
+  The ring, and the header while start() builds it, are in the
+  SharedBuffer, claimed by start() and released once stop()'s ring has
+  drained; start() fails while the scope or the input trace has it.
+
+  The stream goes out USART1 (TX1, pin 18) rather than USART0, which is
+  Serial's and carries the debug text and one-letter commands; nothing
+  else may use pin 18 while it runs, and stop() hands the pin back once
+  the ring has drained. Only the transmitter is enabled, so RX1 (pin 19)
+  stays free. At 2 Mbaud
+  it carries 200 kB/s; four slots take 16 bytes every 416 us, 38 kB/s.
+
+  Frames, little-endian like the AVR, each COBS encoded and followed by a
+  0 byte:
+    'H'  header, sent by start(): version, conversion us (2), slots, then
+         per slot the channel's scale and offset (float) and its label and
+         units, each 0-terminated
+    'D'  data: sequence (2), micros() at slot 0 (4), then the raw 0-1023
+         sample (2) of each slot
+*/
+
+#ifndef FrameStream_h
+#define FrameStream_h
+
+#include "Arduino.h"
+#include "Channels.h"
+#include "SharedBuffer.h"
+
+#define FRAME_STREAM_VERSION 1
+#define FRAME_STREAM_HEADER  'H'
+#define FRAME_STREAM_DATA    'D'
+// uint8_t head and tail wrap round it for free
+#define FRAME_STREAM_RING    256
+// kind, sequence, micros and 16 slots
+#define FRAME_STREAM_MAX_DATA 39
+
+#define FRAME_STREAM_UBRR      UBRR1
+#define FRAME_STREAM_UCSRA     UCSR1A
+#define FRAME_STREAM_UCSRB     UCSR1B
+#define FRAME_STREAM_UCSRC     UCSR1C
+#define FRAME_STREAM_UDR       UDR1
+#define FRAME_STREAM_U2X       U2X1
+#define FRAME_STREAM_TXEN      TXEN1
+#define FRAME_STREAM_UDRIE     UDRIE1
+#define FRAME_STREAM_UCSZ0     UCSZ10
+#define FRAME_STREAM_UCSZ1     UCSZ11
+#define FRAME_STREAM_UDRE_vect USART1_UDRE_vect
+
+class FrameStream {
+  public:
+    FrameStream();
+    // opens the UART at baud (F_CPU / 8 / baud must be whole; 1 or 2 Mbaud
+    // at 16 MHz), sends the header for slots analog slots, slotChannel
+    // mapping them to channels[], and starts taking frames
+    bool start(unsigned long baud, const Channel *channels, const byte *slotChannel, byte slots);
+    // stops taking frames; what's in the ring still goes out, then the
+    // transmitter is switched off and pin 18 is an ordinary pin again
+    void stop();
+    bool running() const { return _running; }
+    uint16_t sequence() const { return _seq; }
+    uint16_t dropped() const { return _dropped; }
+
+    // from the ADC interrupt, every conversion
+    void push(uint8_t slot, uint16_t sample);
+    // from the UART interrupt
+    void isr();
+  private:
+    uint8_t space() const { return _tail - _head - 1; }
+    // COBS encodes n bytes into the ring, with the trailing 0
+    void encode(const uint8_t *buf, uint8_t n);
+
+    volatile bool _running;
+    bool _synced;
+    uint8_t _slots;
+    volatile uint16_t _seq;
+    volatile uint16_t _dropped;
+    uint8_t _frame[FRAME_STREAM_MAX_DATA];
+    volatile uint8_t _head;
+    volatile uint8_t _tail;
+    uint8_t *_ring;
+};
+
+extern FrameStream frameStream;
+
+#endif
@@ -0,0 +1,384 @@
+#include "Arduino.h"
+#include "FT5x06.h"
+#include "RTClib.h"
+#include "HistoryBrowser.h"
+#include "LogIndex.h"
+
+HistoryBrowser::HistoryBrowser(Adafruit_RA8875 &tft, LabelCache &labels) : _tft(tft), _labels(labels) {
+  _channels = 0;
+  _logged = 0;
+  _nLogged = 0;
+  _toPx = 0;
+  _name[0] = '\0';
+  _viewStart = 0;
+  _viewEnd = 0;
+}
+
+void HistoryBrowser::setChannels(const Channel *channels, const byte *logged, byte n_logged,
+                                 int (*toPx)(byte channel, float val)) {
+  _channels = channels;
+  _logged = logged;
+  _nLogged = n_logged;
+  _toPx = toPx;
+}
+
+bool HistoryBrowser::open(const char *logname) {
+  close();
+  if (!_log.open(logname, O_READ)) {
+    return false;
+  }
+  strncpy(_name, logname, sizeof(_name) - 1);
+  _name[sizeof(_name) - 1] = '\0';
+  _viewStart = 0;
+  _viewEnd = _log.fileSize();
+  return true;
+}
+
+void HistoryBrowser::close() {
+  if (_log.isOpen()) {
+    _log.close();
+  }
+}
+
+void HistoryBrowser::render() {
+  if (!_log.isOpen() || _viewEnd <= _viewStart) {
+    return;
+  }
+  _labels.dataBegin();
+  _tft.graphicsMode();
+  _tft.fillRect(HISTORY_X0, HISTORY_TOP, HISTORY_COLUMNS, HISTORY_BOTTOM - HISTORY_TOP, RA8875_BLACK);
+
+  _bytesPerColumn = (_viewEnd - _viewStart) / HISTORY_COLUMNS + 1;
+  _column = -1;
+  _firstStamp[0] = '\0';
+  _lastStamp[0] = '\0';
+  if (!renderFromIndex()) {
+    renderFromLog();
+  }
+  drawColumn();
+  _labels.dataEnd();
+  drawLabels();
+}
+
+bool HistoryBrowser::renderFromIndex() {
+  char idxname[13];
+  strcpy(idxname, _name);
+  char *dot = strrchr(idxname, '.');
+  if (!dot || strlen(dot) != 4) {
+    return false;
+  }
+  strcpy(dot, ".IDX");
+
+  SdFile idx;
+  uint8_t header[LOG_INDEX_HEADER_SIZE];
+  if (!idx.open(idxname, O_READ)) {
+    return false;
+  }
+  if (idx.read(header, sizeof(header)) != sizeof(header)
+      || memcmp(header, LOG_INDEX_MAGIC, 4) != 0 || header[6] != _nLogged) {
+    idx.close();
+    return false;
+  }
+  uint16_t recsize = 10 + 8 * _nLogged;
+  uint32_t records = (idx.fileSize() - LOG_INDEX_HEADER_SIZE) / recsize;
+  // only worth it when every column spans at least one index record
+  if (records == 0 || _bytesPerColumn < _log.fileSize() / records) {
+    idx.close();
+    return false;
+  }
+
+  // last record starting at or before the view, by offset (records are in file order)
+  uint32_t lo = 0;
+  uint32_t hi = records;
+  uint32_t first = 0;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    uint32_t offset;
+    idx.seekSet(LOG_INDEX_HEADER_SIZE + mid * recsize);
+    idx.read(&offset, 4);
+    if (offset <= _viewStart) {
+      first = mid;
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  idx.seekSet(LOG_INDEX_HEADER_SIZE + first * recsize);
+  uint8_t rec[10 + 8 * MAX_CHANNELS];
+  while (idx.read(rec, recsize) == recsize) {
+    uint32_t offset;
+    uint32_t timestamp;
+    memcpy(&offset, rec, 4);
+    memcpy(&timestamp, rec + 4, 4);
+    if (offset >= _viewEnd) {
+      break;
+    }
+    startColumn(offset > _viewStart ? (offset - _viewStart) / _bytesPerColumn : 0);
+    const float *mn = (const float *)(rec + 10);
+    const float *mx = mn + _nLogged;
+    for (byte k = 0; k < _nLogged; k = k + 1) {
+      if (mn[k] < _min[k]) {
+        _min[k] = mn[k];
+        _columnHasData = true;
+      }
+      if (mx[k] > _max[k]) {
+        _max[k] = mx[k];
+        _columnHasData = true;
+      }
+    }
+    DateTime t(timestamp);
+    sprintf(_lastStamp, "%u%u%u %u:%u:%u", t.year(), t.month(), t.day(), t.hour(), t.minute(), t.second());
+    if (_firstStamp[0] == '\0') {
+      strcpy(_firstStamp, _lastStamp);
+    }
+  }
+  idx.close();
+  return true;
+}
+
+void HistoryBrowser::renderFromLog() {
+  // start on a block boundary so each streamed block is parsed whole
+  uint32_t aligned = _viewStart & ~(uint32_t)0x1FF;
+  if (!_log.seekSet(aligned) || !_log.streamStart()) {
+    return;
+  }
+  _pos = aligned;
+  _rowStart = aligned;
+  _fieldNum = 0;
+  _fieldLen = 0;
+  _skipLine = aligned != 0; // probably mid-row
+  for (byte k = 0; k < _nLogged; k = k + 1) {
+    _row[k] = NAN;
+  }
+
+  const uint8_t *block;
+  PackedReader packed;
+  while (_rowStart < _viewEnd) {
+    int n = _log.streamRead(&block);
+    if (n <= 0) {
+      break;
+    }
+    if (n == 512 && packed.begin(block)) {
+      parsePacked(packed);
+      _pos = _pos + n;
+      _rowStart = _pos;
+      continue;
+    }
+    for (int i = 0; i < n; i++) {
+      parse(block[i]);
+      _pos = _pos + 1;
+    }
+  }
+  _log.streamStop();
+}
+
+// a block of an .APK log, rows already binary
+void HistoryBrowser::parsePacked(PackedReader &packed) {
+  uint32_t timestamp;
+  _rowStart = _pos + packed.offset();
+  while (_rowStart < _viewEnd && packed.next(&timestamp, _row)) {
+    for (byte k = packed.channels(); k < _nLogged; k = k + 1) {
+      _row[k] = NAN;
+    }
+    DateTime t(timestamp);
+    sprintf(_rowStamp, "%u%u%u %u:%u:%u", t.year(), t.month(), t.day(), t.hour(), t.minute(), t.second());
+    _fieldNum = 2;
+    endRow();
+    _rowStart = _pos + packed.offset();
+  }
+  _skipLine = false;
+  _fieldNum = 0;
+  _fieldLen = 0;
+}
+
+void HistoryBrowser::parse(char c) {
+  if (c == '\n') {
+    if (!_skipLine) {
+      endField();
+      endRow();
+    }
+    _skipLine = false;
+    _fieldNum = 0;
+    _fieldLen = 0;
+    _rowStart = _pos + 1;
+    return;
+  }
+  if (_skipLine || c == '\r') {
+    return;
+  }
+  if (_fieldNum == 0 && _fieldLen == 0 && (c < '0' || c > '9')) {
+    _skipLine = true; // column header or comment
+    return;
+  }
+  if (c == '\t') {
+    endField();
+    _fieldNum = _fieldNum + 1;
+    _fieldLen = 0;
+    return;
+  }
+  if (_fieldLen < HISTORY_FIELD_SIZE - 1) {
+    _field[_fieldLen++] = c;
+  }
+}
+
+void HistoryBrowser::endField() {
+  _field[_fieldLen] = '\0';
+  if (_fieldNum == 0) {
+    strcpy(_rowStamp, _field);
+  }
+  else if (_fieldNum == 1) {
+    strcat(_rowStamp, " ");
+    strcat(_rowStamp, _field);
+  }
+  else if (_fieldNum - 2 < _nLogged) {
+    _row[_fieldNum - 2] = atof(_field); // "nan" parses to NAN
+  }
+}
+
+void HistoryBrowser::endRow() {
+  if (_rowStart >= _viewStart && _rowStart < _viewEnd && _fieldNum >= 2) {
+    startColumn((_rowStart - _viewStart) / _bytesPerColumn);
+    for (byte k = 0; k < _nLogged; k = k + 1) {
+      if (_row[k] < _min[k]) {
+        _min[k] = _row[k];
+        _columnHasData = true;
+      }
+      if (_row[k] > _max[k]) {
+        _max[k] = _row[k];
+        _columnHasData = true;
+      }
+    }
+    if (_firstStamp[0] == '\0') {
+      strcpy(_firstStamp, _rowStamp);
+    }
+    strcpy(_lastStamp, _rowStamp);
+  }
+  for (byte k = 0; k < _nLogged; k = k + 1) {
+    _row[k] = NAN;
+  }
+}
+
+void HistoryBrowser::startColumn(int col) {
+  if (col == _column) {
+    return;
+  }
+  drawColumn();
+  _column = col;
+  _columnHasData = false;
+  for (byte k = 0; k < _nLogged; k = k + 1) {
+    _min[k] = INFINITY;
+    _max[k] = -INFINITY;
+  }
+}
+
+void HistoryBrowser::drawColumn() {
+  if (_column < 0 || _column >= HISTORY_COLUMNS || !_columnHasData) {
+    return;
+  }
+  for (byte k = 0; k < _nLogged; k = k + 1) {
+    if (!isinf(_min[k])) {
+      drawSpan(_column, _logged[k], _min[k], _max[k]);
+    }
+  }
+}
+
+void HistoryBrowser::drawSpan(int column, byte channel, float mn, float mx) {
+  if (_channels[channel].axis == CH_AXIS_NONE) {
+    return;
+  }
+  int x = HISTORY_X0 + column;
+  // constrain() is a macro, so don't hand it the call
+  int top = _toPx(channel, mx);
+  int bottom = _toPx(channel, mn);
+  top = constrain(top, HISTORY_TOP, HISTORY_BOTTOM);
+  bottom = constrain(bottom, HISTORY_TOP, HISTORY_BOTTOM);
+  if (top == bottom) {
+    LabelCache::pixel(_tft, x, top, _channels[channel].colour);
+  }
+  else {
+    _tft.drawFastVLine(x, top, bottom - top + 1, _channels[channel].colour);
+  }
+}
+
+void HistoryBrowser::drawLabels() {
+  // replaces makeGraph()'s hour labels with the first and last time in view
+  _tft.fillRect(100, 465, 700, 15, RA8875_BLACK);
+  _tft.textMode();
+  _tft.textEnlarge(0);
+  _tft.textColor(RA8875_WHITE, RA8875_BLACK);
+  _tft.textSetCursor(100, 465);
+  _tft.textWrite(_firstStamp);
+  _tft.textSetCursor(750 - 8 * strlen(_lastStamp), 465);
+  _tft.textWrite(_lastStamp);
+  _tft.textColor(RA8875_BLACK, RA8875_WHITE);
+  _tft.textSetCursor(425 - 4 * strlen(_name), 465);
+  _tft.textWrite(_name);
+  _tft.graphicsMode();
+}
+
+bool HistoryBrowser::gesture(byte id) {
+  if (!_log.isOpen()) {
+    return false;
+  }
+  uint32_t size = _log.fileSize();
+  uint32_t span = _viewEnd - _viewStart;
+  uint32_t centre = _viewStart + span / 2;
+  uint32_t start = _viewStart;
+
+  if (id == FT5206_GEST_ID_MOVE_LEFT) { // drag left: later data
+    start = _viewStart + span / 2;
+  }
+  else if (id == FT5206_GEST_ID_MOVE_RIGHT) { // drag right: earlier data
+    start = _viewStart > span / 2 ? _viewStart - span / 2 : 0;
+  }
+  else if (id == FT5206_GEST_ID_ZOOM_IN) {
+    // keep at least a few bytes per column so a column still holds a row
+    if (span / 2 >= 16UL * HISTORY_COLUMNS) {
+      span = span / 2;
+    }
+    start = centre > span / 2 ? centre - span / 2 : 0;
+  }
+  else if (id == FT5206_GEST_ID_ZOOM_OUT) {
+    span = span > size / 2 ? size : span * 2;
+    start = centre > span / 2 ? centre - span / 2 : 0;
+  }
+  else {
+    return false;
+  }
+  if (span > size) {
+    span = size;
+  }
+  if (start + span > size) {
+    start = size - span;
+  }
+  if (start == _viewStart && start + span == _viewEnd) {
+    return false;
+  }
+  _viewStart = start;
+  _viewEnd = start + span;
+  return true;
+}
+
+bool HistoryBrowser::previousLog(const char *name, char *prev) {
+  SdBaseFile *dir = SdBaseFile::cwd();
+  SdBaseFile entry;
+  char entryname[13];
+  bool found = false;
+  dir->rewind();
+  while (entry.openNext(dir, O_READ)) {
+    if (entry.isFile() && entry.getFilename(entryname)) {
+      char *dot = strrchr(entryname, '.');
+      // names on the card are upper case, filename[] in acq.ino is not
+      if (dot && (strcasecmp(dot, ".CSV") == 0 || strcasecmp(dot, PACKED_LOG_EXT) == 0)
+          && strcasecmp(entryname, name) < 0
+          && (!found || strcasecmp(entryname, prev) > 0)) {
+        strcpy(prev, entryname);
+        found = true;
+      }
+    }
+    entry.close();
+  }
+  return found;
+}
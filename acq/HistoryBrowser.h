@@ -0,0 +1,109 @@
+/*
+  HistoryBrowser.h - Renders a past log from the SD card onto the chart.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  The view is a byte range of the CSV, mapped linearly onto the chart
+  columns (rows are close to constant length, so bytes track time well
+  enough and no pre-scan is needed). Each render is one streaming pass: rows
+  are folded into a per-channel min/max for the current column only, and a
+  column is drawn as soon as the stream moves past it. The CSV is read with
+  SdBaseFile::streamRead(), so blocks are parsed in place in the SdFat cache
+  and RAM use is two floats per channel, whatever the size of the log.
+  Packed logs (.APK, see PackedLog.h) are read the same way, each packed
+  block decoded where it lies in the cache.
+
+  When a column covers at least one LogIndex span, the overview is drawn
+  from YYMMDD-x.IDX instead and the CSV isn't read at all.
+
+  Swipes pan by half a view, pinch zooms by 2x around the centre; see
+  gesture().
+*/
+
+#ifndef HistoryBrowser_h
+#define HistoryBrowser_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+#include "Adafruit_RA8875.h"
+#include "Channels.h"
+#include "PackedLog.h"
+#include "LabelCache.h"
+
+// chart area drawn by makeGraph(); column 0 is just right of the axis
+#define HISTORY_X0       101
+#define HISTORY_COLUMNS  649
+#define HISTORY_TOP      100
+#define HISTORY_BOTTOM   450
+
+// longest date or time field kept for the axis labels
+#define HISTORY_FIELD_SIZE 16
+
+class HistoryBrowser {
+  public:
+    // columns go to the data layer, labels stay on the frame (LabelCache.h)
+    HistoryBrowser(Adafruit_RA8875 &tft, LabelCache &labels);
+    // logged[] maps log columns to channels[]; toPx maps a channel value to a row
+    void setChannels(const Channel *channels, const byte *logged, byte n_logged,
+                     int (*toPx)(byte channel, float val));
+    // opens a log and resets the view to the whole file
+    bool open(const char *logname);
+    void close();
+    bool isOpen() { return _log.isOpen(); }
+    const char *name() const { return _name; }
+    void render();
+    // FT5206_GEST_ID_*; returns true if the view changed and needs a render()
+    bool gesture(byte id);
+    // one channel's min..max as a vertical line in chart column, or a pixel
+    // when they meet; the scope capture is drawn with it too, between
+    // LabelCache::dataBegin() and dataEnd()
+    void drawSpan(int column, byte channel, float mn, float mx);
+
+    // greatest *.CSV or *.APK name in the root directory that sorts before name, so
+    // repeated calls walk back through earlier logs; false if there is none
+    static bool previousLog(const char *name, char *prev);
+  private:
+    bool renderFromIndex();
+    void renderFromLog();
+    void parse(char c);
+    void parsePacked(PackedReader &packed);
+    void endField();
+    void endRow();
+    void startColumn(int col);
+    void drawColumn();
+    void drawLabels();
+
+    Adafruit_RA8875 &_tft;
+    LabelCache &_labels;
+    const Channel *_channels;
+    const byte *_logged;
+    byte _nLogged;
+    int (*_toPx)(byte channel, float val);
+
+    SdFile _log;
+    char _name[13];
+    uint32_t _viewStart;
+    uint32_t _viewEnd;
+    uint32_t _bytesPerColumn;
+
+    // per-column accumulators
+    int _column;
+    bool _columnHasData;
+    float _min[MAX_CHANNELS];
+    float _max[MAX_CHANNELS];
+
+    // CSV parser state
+    uint32_t _pos;
+    uint32_t _rowStart;
+    byte _fieldNum;
+    byte _fieldLen;
+    bool _skipLine;
+    char _field[HISTORY_FIELD_SIZE];
+    float _row[MAX_CHANNELS];
+    char _firstStamp[2 * HISTORY_FIELD_SIZE];
+    char _lastStamp[2 * HISTORY_FIELD_SIZE];
+    char _rowStamp[2 * HISTORY_FIELD_SIZE];
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "Arduino.h"
+#include "LabelCache.h"
+
+// registers the Adafruit driver has no calls for
+#define LC_SYSR   0x10 // colour depth in bits 3-2, 00 for 8 bits
+#define LC_DPCR   0x20 // bit 7: two layers
+#define LC_MWCR1  0x41 // bit 0: the layer drawn to
+#define LC_CURH0  0x46 // memory write cursor, 4 registers
+#define LC_MRWC   0x02
+#define LC_BECR0  0x50 // bit 7: start the BTE, then busy
+#define LC_BECR1  0x51 // ROP in bits 7-4, operation in bits 3-0
+#define LC_LTPR0  0x52 // bits 2-0: the layer shown
+#define LC_HSBE0  0x54 // source, destination, size: 12 registers
+#define LC_BGTR0  0x67 // transparency colour, red, green, blue
+#define LC_LAYER2 0x80 // in the high byte of a BTE row
+
+#define LC_BTE_MOVE_SOURCE 0xC2 // ROP S, move in the positive direction
+#define LC_SHOW_LAYER1      0x00
+#define LC_SHOW_TRANSPARENT 0x03 // layer 1, and layer 2 where layer 1 is BGTR
+
+LabelCache::LabelCache(Adafruit_RA8875 &tft) : _tft(tft) {
+  _sheets = 0;
+  _count = 0;
+  _valid = 0;
+  memset(_window, 0, sizeof(_window));
+}
+
+void LabelCache::begin(const LabelSheet *sheets, byte count) {
+  _sheets = sheets;
+  _count = count < LABEL_CACHE_MAX_SHEETS ? count : LABEL_CACHE_MAX_SHEETS;
+  _valid = 0;
+  _tft.writeReg(LC_SYSR, _tft.readReg(LC_SYSR) & ~0x0C);
+  _tft.writeReg(LC_DPCR, _tft.readReg(LC_DPCR) | 0x80);
+  _tft.writeReg(LC_LTPR0, LC_SHOW_LAYER1);
+  // the colour registers take RGB565 components, as for the foreground
+  _tft.writeReg(LC_BGTR0, LABEL_CACHE_WINDOW >> 11);
+  _tft.writeReg(LC_BGTR0 + 1, (LABEL_CACHE_WINDOW >> 5) & 0x3F);
+  _tft.writeReg(LC_BGTR0 + 2, LABEL_CACHE_WINDOW & 0x1F);
+  drawTo(2);
+  _tft.graphicsMode();
+  _tft.fillScreen(RA8875_BLACK);
+  drawTo(1);
+}
+
+void LabelCache::invalidate(byte sheet) {
+  _valid = _valid & ~(1 << sheet);
+}
+
+void LabelCache::show(byte sheet) {
+  if (sheet >= _count) {
+    return;
+  }
+  const LabelSheet &s = _sheets[sheet];
+  if (!(_valid & (1 << sheet))) {
+    drawTo(2);
+    _tft.graphicsMode();
+    _tft.fillRect(s.x, s.y, s.w, s.h, RA8875_BLACK);
+    s.paint();
+    drawTo(1);
+    _valid = _valid | (1 << sheet);
+  }
+  move(s.x, s.y, s.w, s.h);
+}
+
+void LabelCache::openWindow(int16_t x, int16_t y, int16_t w, int16_t h) {
+  _window[0] = x;
+  _window[1] = y;
+  _window[2] = w;
+  _window[3] = h;
+  for (byte i = 0; i < _count; i = i + 1) {
+    const LabelSheet &s = _sheets[i];
+    if (s.x < x + w && x < s.x + s.w && s.y < y + h && y < s.y + s.h) {
+      invalidate(i);
+    }
+  }
+  clearWindow();
+  _tft.graphicsMode();
+  _tft.fillRect(x, y, w, h, LABEL_CACHE_WINDOW);
+  _tft.writeReg(LC_LTPR0, LC_SHOW_TRANSPARENT);
+}
+
+void LabelCache::clearWindow() {
+  drawTo(2);
+  _tft.graphicsMode();
+  _tft.fillRect(_window[0], _window[1], _window[2], _window[3], RA8875_BLACK);
+  drawTo(1);
+}
+
+void LabelCache::closeWindow() {
+  _tft.writeReg(LC_LTPR0, LC_SHOW_LAYER1);
+}
+
+void LabelCache::drawTo(byte layer) {
+  _tft.writeReg(LC_MWCR1, layer == 2 ? 0x01 : 0x00);
+}
+
+// layer 2 to the same place on layer 1
+void LabelCache::move(int16_t x, int16_t y, int16_t w, int16_t h) {
+  uint8_t r[12] = {
+    (uint8_t)x, (uint8_t)(x >> 8), (uint8_t)y, (uint8_t)((y >> 8) | LC_LAYER2),
+    (uint8_t)x, (uint8_t)(x >> 8), (uint8_t)y, (uint8_t)(y >> 8),
+    (uint8_t)w, (uint8_t)(w >> 8), (uint8_t)h, (uint8_t)(h >> 8)
+  };
+  for (uint8_t i = 0; i < sizeof(r); i = i + 1) {
+    _tft.writeReg(LC_HSBE0 + i, r[i]);
+  }
+  _tft.writeReg(LC_BECR1, LC_BTE_MOVE_SOURCE);
+  _tft.writeReg(LC_BECR0, 0x80);
+  _tft.waitPoll(LC_BECR0, 0x80);
+}
+
+void LabelCache::pixel(Adafruit_RA8875 &tft, int16_t x, int16_t y, uint16_t colour) {
+  tft.writeReg(LC_CURH0, x);
+  tft.writeReg(LC_CURH0 + 1, x >> 8);
+  tft.writeReg(LC_CURH0 + 2, y);
+  tft.writeReg(LC_CURH0 + 3, y >> 8);
+  tft.writeCommand(LC_MRWC);
+  tft.writeData((colour >> 8 & 0xE0) | (colour >> 6 & 0x1C) | (colour >> 3 & 0x03));
+}
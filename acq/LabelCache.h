@@ -0,0 +1,85 @@
+/*
+  LabelCache.h - Keeps the screens' fixed labels in the RA8875's second layer.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  The RA8875 has 768 KB of display memory: one 800x480 layer at 16 bits a
+  pixel, or two at 8 (RGB332). begin() switches to two 8-bit layers and
+  shows only layer 1. Layer 2 is not shown, but for the chart window
+  below; it holds sheets, fixed parts of the screens (buttons, headings,
+  axis labels and ticks), each painted at the place on screen it belongs
+  so the sketch draws them with the usual calls. show() paints a sheet
+  into layer 2 the first time, or again after invalidate(), and then
+  copies it onto layer 1 with one BTE move:
+  about 16 register writes, where painting it takes hundreds of cursor,
+  colour and character writes. Sheets must not overlap, since they share
+  layer 2.
+
+  The chart's data goes on layer 2 as well. openWindow() fills a rectangle
+  of layer 1 with LABEL_CACHE_WINDOW and has the RA8875 show layer 2
+  wherever layer 1 is that colour (its transparent mode), so the frame
+  around and over the window stays on layer 1 and drawing between
+  dataBegin() and dataEnd() shows through it. Clearing or redrawing the
+  data leaves the frame alone. Sheets under the window give up their
+  place on layer 2 and are painted again when next shown.
+
+  At 8 bits a pixel the colour registers keep the top bits of each RGB565
+  component, so shapes and text draw with the same RA8875_* colours. A
+  display memory write is one pixel, though, and the driver's drawPixel()
+  writes two bytes, so pixels are drawn with pixel() instead.
+*/
+
+#ifndef LabelCache_h
+#define LabelCache_h
+
+#include "Arduino.h"
+#include "Adafruit_RA8875.h"
+
+#define LABEL_CACHE_MAX_SHEETS 8
+// RGB332 0x01, a dark blue nothing else is drawn in
+#define LABEL_CACHE_WINDOW     0x0008
+
+// draws a sheet's contents at their screen positions
+typedef void (*LabelPainter)();
+
+struct LabelSheet {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+  LabelPainter paint;
+};
+
+class LabelCache {
+  public:
+    LabelCache(Adafruit_RA8875 &tft);
+    // after tft.begin(); sheets[] must outlive the cache
+    void begin(const LabelSheet *sheets, byte count);
+    void show(byte sheet);
+    // what the sheet shows has changed; it is painted again on the next show()
+    void invalidate(byte sheet);
+
+    // layer 2 shows through (x, y, w, h) of layer 1, cleared
+    void openWindow(int16_t x, int16_t y, int16_t w, int16_t h);
+    void clearWindow();
+    // layer 1 alone
+    void closeWindow();
+    // drawing in between goes to layer 2
+    void dataBegin() { drawTo(2); }
+    void dataEnd() { drawTo(1); }
+
+    // drawPixel() for 8 bits a pixel
+    static void pixel(Adafruit_RA8875 &tft, int16_t x, int16_t y, uint16_t colour);
+  private:
+    void drawTo(byte layer);
+    void move(int16_t x, int16_t y, int16_t w, int16_t h);
+
+    Adafruit_RA8875 &_tft;
+    const LabelSheet *_sheets;
+    byte _count;
+    byte _valid; // a bit per sheet
+    int16_t _window[4];
+};
+
+#endif
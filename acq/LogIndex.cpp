@@ -0,0 +1,103 @@
+#include "Arduino.h"
+#include "LogIndex.h"
+
+LogIndex::LogIndex() {
+  _name[0] = '\0';
+  _spanRows = 0;
+  _channels = 0;
+  _rows = 0;
+}
+
+void LogIndex::begin(const char *logname, uint16_t spanRows, uint8_t channels) {
+  strncpy(_name, logname, sizeof(_name) - 1);
+  _name[sizeof(_name) - 1] = '\0';
+  char *dot = strrchr(_name, '.');
+  if (dot && strlen(dot) == 4) {
+    strcpy(dot, ".IDX");
+  }
+  _spanRows = spanRows;
+  _channels = channels > MAX_CHANNELS ? MAX_CHANNELS : channels;
+  _rows = 0;
+}
+
+void LogIndex::add(uint32_t offset, uint32_t timestamp, const float *vals) {
+  if (_spanRows == 0) {
+    return;
+  }
+  if (_rows == 0) {
+    _offset = offset;
+    _timestamp = timestamp;
+    for (byte i = 0; i < _channels; i = i + 1) {
+      _min[i] = INFINITY;
+      _max[i] = -INFINITY;
+    }
+  }
+  // comparisons with NAN are false, so faulted readings drop out on their own
+  for (byte i = 0; i < _channels; i = i + 1) {
+    if (vals[i] < _min[i]) {
+      _min[i] = vals[i];
+    }
+    if (vals[i] > _max[i]) {
+      _max[i] = vals[i];
+    }
+  }
+  _rows = _rows + 1;
+  if (_rows == _spanRows) {
+    writeRecord();
+  }
+}
+
+void LogIndex::flush() {
+  if (_rows > 0) {
+    writeRecord();
+  }
+}
+
+void LogIndex::writeRecord() {
+  SdFile idx;
+  if (idx.open(_name, O_CREAT | O_WRITE | O_APPEND)) {
+    if (idx.fileSize() == 0) {
+      uint8_t header[LOG_INDEX_HEADER_SIZE] = {'A', 'I', 'X', '1',
+                                               (uint8_t)(_spanRows & 0xFF), (uint8_t)(_spanRows >> 8),
+                                               _channels, 0};
+      idx.write(header, sizeof(header));
+    }
+    // the AVR is little-endian, so fields go out as they sit in memory
+    idx.write((const uint8_t *)&_offset, 4);
+    idx.write((const uint8_t *)&_timestamp, 4);
+    idx.write((const uint8_t *)&_rows, 2);
+    idx.write((const uint8_t *)_min, 4 * _channels);
+    idx.write((const uint8_t *)_max, 4 * _channels);
+    idx.close();
+  }
+  _rows = 0;
+}
+
+uint32_t LogIndex::findOffset(SdBaseFile &idx, uint32_t timestamp) {
+  uint8_t header[LOG_INDEX_HEADER_SIZE];
+  if (!idx.seekSet(0) || idx.read(header, sizeof(header)) != sizeof(header)
+      || memcmp(header, LOG_INDEX_MAGIC, 4) != 0) {
+    return 0;
+  }
+  uint32_t recsize = 10 + 8 * (uint32_t)header[6];
+  uint32_t lo = 0;
+  uint32_t hi = (idx.fileSize() - LOG_INDEX_HEADER_SIZE) / recsize;
+  uint32_t offset = 0;
+  // last record whose first timestamp is <= timestamp
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    uint32_t rec[2];
+    idx.seekSet(LOG_INDEX_HEADER_SIZE + mid * recsize);
+    if (idx.read((uint8_t *)rec, sizeof(rec)) != sizeof(rec)) {
+      break;
+    }
+    if (rec[1] <= timestamp) {
+      offset = rec[0];
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return offset;
+}
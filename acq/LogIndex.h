@@ -0,0 +1,66 @@
+/*
+  LogIndex.h - Sidecar summary index written next to each log file.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  For YYMMDD-x.CSV the index is YYMMDD-x.IDX. Every spanRows log rows one
+  fixed-size record is appended, so a reader can binary search on time,
+  seek straight to that byte offset in the CSV, or draw an overview from the
+  per-channel min/max without reading the log at all.
+
+  All fields little-endian, floats IEEE 754 single (as on the AVR):
+
+    header, 8 bytes
+      char     magic[4]    "AIX1"
+      uint16_t spanRows    rows summarised per record
+      uint8_t  channels    logged channels, n
+      uint8_t  reserved    0
+    record, 10 + 8n bytes
+      uint32_t offset      CSV byte offset of the first row in the span
+      uint32_t timestamp   RTC unixtime of that row
+      uint16_t rows        rows in the span (spanRows except the last one)
+      float    min[n]      per logged channel, in log column order
+      float    max[n]      NAN readings are left out; +-INF if all were NAN
+*/
+
+#ifndef LogIndex_h
+#define LogIndex_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+#include "Channels.h"
+
+#define LOG_INDEX_MAGIC "AIX1"
+#define LOG_INDEX_HEADER_SIZE 8
+
+class LogIndex {
+  public:
+    LogIndex();
+    // logname is the CSV name; the index name is derived from it
+    void begin(const char *logname, uint16_t spanRows, uint8_t channels);
+    // call before each row is written: offset is the CSV size before the row,
+    // vals the logged values in column order
+    void add(uint32_t offset, uint32_t timestamp, const float *vals);
+    // writes out a partial span, e.g. when logging stops
+    void flush();
+    const char *name() const { return _name; }
+    uint16_t recordSize() const { return 10 + 8 * _channels; }
+
+    // device-side seek: byte offset in the CSV of the span holding timestamp,
+    // or 0 if the index is missing or timestamp is before the first span
+    static uint32_t findOffset(SdBaseFile &idx, uint32_t timestamp);
+  private:
+    void writeRecord();
+
+    char _name[13];
+    uint16_t _spanRows;
+    uint8_t _channels;
+    uint16_t _rows;
+    uint32_t _offset;
+    uint32_t _timestamp;
+    float _min[MAX_CHANNELS];
+    float _max[MAX_CHANNELS];
+};
+
+#endif
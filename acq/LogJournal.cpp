@@ -0,0 +1,248 @@
+#include "Arduino.h"
+#include "LogJournal.h"
+#include "PackedLog.h"
+
+LogJournal::LogJournal() {
+  _firstBlock = 0;
+  _seq = 0;
+  _lastBlock = 0;
+  _endBlock = 0;
+  _erasedBlock = 0;
+  _checkpoint = 0;
+}
+
+bool LogJournal::begin(const char *name, uint32_t size, uint16_t checkpoint) {
+  if (_file.isOpen()) {
+    close();
+  }
+  while (!_file.createContiguous(SdBaseFile::cwd(), name, size)) {
+    if (_file.isOpen()) {
+      discard(); // made, but its directory entry couldn't be written
+      return false;
+    }
+    if (size / 2 < LOG_JOURNAL_MIN_SIZE) {
+      return false;
+    }
+    size = size / 2;
+  }
+  if (!_file.contiguousRange(&_firstBlock, &_endBlock)) {
+    discard();
+    return false;
+  }
+  _erasedBlock = _firstBlock;
+
+  _seq = 0;
+  _checkpoint = checkpoint;
+  _lastBlock = LOG_JOURNAL_DATA_START >> 9;
+  if (!_file.seekSet(LOG_JOURNAL_DATA_START)) {
+    discard();
+    return false;
+  }
+  // both header slots too, so an old file's header can't pass for ours
+  eraseAhead();
+  if (!writeHeader(LOG_JOURNAL_DATA_START, false)) {
+    discard();
+    return false;
+  }
+  return true;
+}
+
+// a log begin() couldn't start is removed, or every retry would leave
+// another extent and use up another letter
+void LogJournal::discard() {
+  if (!_file.remove()) {
+    _file.close(); // the card failed; at least nothing writes into it
+  }
+}
+
+bool LogJournal::update() {
+  if (!_file.isOpen()) {
+    return false;
+  }
+  eraseAhead();
+  if ((position() >> 9) - _lastBlock >= _checkpoint) {
+    return checkpoint();
+  }
+  return true;
+}
+
+bool LogJournal::checkpoint() {
+  if (!_file.isOpen()) {
+    return false;
+  }
+  _lastBlock = position() >> 9;
+  return writeHeader(position(), false);
+}
+
+// keeps LOG_JOURNAL_ERASE_BLOCKS or more erased past the block being
+// written, so unwritten data reads back as 0x00 or 0xFF. A bounded erase
+// at a time, as the data reaches it: the whole extent at once can keep a
+// card busy long enough to hold up rows. Cards that can't erase a range
+// leave old data, which recover() only reads a little of.
+void LogJournal::eraseAhead() {
+  uint32_t block = _firstBlock + (position() >> 9);
+  while (_erasedBlock <= _endBlock && _erasedBlock < block + LOG_JOURNAL_ERASE_BLOCKS) {
+    uint32_t last = _erasedBlock + LOG_JOURNAL_ERASE_BLOCKS - 1;
+    if (last > _endBlock) {
+      last = _endBlock;
+    }
+    _file.volume()->sdCard()->erase(_erasedBlock, last);
+    _erasedBlock = last + 1;
+  }
+}
+
+bool LogJournal::close() {
+  if (!_file.isOpen()) {
+    return false;
+  }
+  uint32_t end = position();
+  bool ok = _file.truncate(end) && writeHeader(end, true);
+  return _file.close() && ok;
+}
+
+bool LogJournal::writeHeader(uint32_t end, bool done) {
+  // the data block in the cache goes out first, so end is really on the card
+  cache_t *pc = _file.volume()->cacheClear();
+  if (!pc) {
+    return false;
+  }
+  _seq = _seq + 1;
+  char *line = (char *)pc->data;
+  memset(line, ' ', 512);
+  sprintf(line, "%s seq=%010lu end=%010lu done=%u", LOG_JOURNAL_MAGIC,
+          (unsigned long)_seq, (unsigned long)end, done ? 1 : 0);
+  sprintf(line + LOG_JOURNAL_SUM_AT, " sum=%04x", fletcher16(line, LOG_JOURNAL_SUM_AT));
+  line[LOG_JOURNAL_LINE_LEN] = ' ';
+  line[510] = '\r';
+  line[511] = '\n';
+  // straight to the card: the extent is contiguous, and going through the
+  // file would mean seeking back to 0 and along the cluster chain each time
+  return _file.volume()->sdCard()->writeBlock(_firstBlock + (_seq & 1), pc->data);
+}
+
+bool LogJournal::readHeader(SdBaseFile &f, uint32_t *seq, uint32_t *end, bool *done) {
+  bool found = false;
+  char line[LOG_JOURNAL_LINE_LEN + 1];
+  for (byte slot = 0; slot < 2; slot = slot + 1) {
+    if (!f.seekSet(512UL * slot) || f.read(line, LOG_JOURNAL_LINE_LEN) != LOG_JOURNAL_LINE_LEN) {
+      break;
+    }
+    line[LOG_JOURNAL_LINE_LEN] = '\0';
+    if (memcmp(line, LOG_JOURNAL_MAGIC, 4) != 0
+        || strtoul(line + LOG_JOURNAL_SUM_AT + 5, 0, 16) != fletcher16(line, LOG_JOURNAL_SUM_AT)) {
+      continue; // never written, or torn
+    }
+    uint32_t s = strtoul(line + LOG_JOURNAL_SEQ_AT, 0, 10);
+    if (!found || s > *seq) {
+      *seq = s;
+      *end = strtoul(line + LOG_JOURNAL_END_AT, 0, 10);
+      *done = line[LOG_JOURNAL_DONE_AT] == '1';
+      found = true;
+    }
+  }
+  return found;
+}
+
+// a packed log ends at the used count of the last good block from the one
+// end is in; 0 if that block isn't packed
+uint32_t LogJournal::packedEnd(SdBaseFile &f, uint32_t end, uint32_t limit) {
+  uint8_t header[PACKED_LOG_HEADER_SIZE];
+  uint32_t good = 0;
+  for (uint32_t pos = end & ~(uint32_t)0x1FF; pos < limit; pos = pos + 512) {
+    uint16_t used;
+    if (!f.seekSet(pos) || f.read(header, sizeof(header)) != sizeof(header)
+        || (used = PackedReader::used(header)) == 0) {
+      break;
+    }
+    good = pos + used;
+  }
+  return good;
+}
+
+bool LogJournal::recover(const char *name, uint16_t checkpoint) {
+  LogJournal j;
+  uint32_t end;
+  bool done;
+  uint32_t lastBlock;
+  if (!j._file.open(name, O_RDWR)) {
+    return false;
+  }
+  if (!readHeader(j._file, &j._seq, &end, &done) || done || end > j._file.fileSize()
+      || !j._file.contiguousRange(&j._firstBlock, &lastBlock)) {
+    j._file.close();
+    return false;
+  }
+
+  // rows written since the last header: at most checkpoint blocks past the
+  // one end is in. Keep up to the last newline before erased space, or for
+  // a packed log up to the end of its last good block.
+  uint32_t limit = (end & ~(uint32_t)0x1FF) + 512UL * (checkpoint + 1);
+  if (limit > j._file.fileSize()) {
+    limit = j._file.fileSize();
+  }
+  uint32_t good = packedEnd(j._file, end, limit);
+  uint32_t pos = end;
+  bool erased = good > 0; // packed, nothing to scan
+  uint8_t buf[32];
+  if (!erased) {
+    good = end;
+  }
+  j._file.seekSet(end);
+  while (pos < limit && !erased) {
+    int n = j._file.read(buf, limit - pos < sizeof(buf) ? limit - pos : sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      if (buf[i] == 0x00 || buf[i] == 0xFF) {
+        erased = true;
+        break;
+      }
+      if (buf[i] == '\n') {
+        good = pos + i + 1;
+      }
+    }
+    pos = pos + n;
+  }
+
+  j._file.seekSet(good);
+  return j.close();
+}
+
+uint8_t LogJournal::recoverAll(uint16_t checkpoint) {
+  SdBaseFile *dir = SdBaseFile::cwd();
+  SdBaseFile entry;
+  char name[13];
+  uint8_t repaired = 0;
+  dir->rewind();
+  while (entry.openNext(dir, O_READ)) {
+    uint32_t seq;
+    uint32_t end;
+    bool done;
+    char *dot;
+    bool open = entry.isFile() && entry.getFilename(name)
+                && (dot = strrchr(name, '.'))
+                && (strcasecmp(dot, ".CSV") == 0 || strcasecmp(dot, PACKED_LOG_EXT) == 0)
+                && readHeader(entry, &seq, &end, &done) && !done;
+    entry.close();
+    if (open) {
+      // opening by name rewinds the directory, so come back to this entry
+      uint32_t next = dir->curPosition();
+      if (recover(name, checkpoint)) {
+        repaired = repaired + 1;
+      }
+      dir->seekSet(next);
+    }
+  }
+  return repaired;
+}
+
+uint16_t LogJournal::fletcher16(const char *s, byte n) {
+  uint16_t a = 0;
+  uint16_t b = 0;
+  for (byte i = 0; i < n; i = i + 1) {
+    a = (a + (uint8_t)s[i]) % 255;
+    b = (b + a) % 255;
+  }
+  return (b << 8) | a;
+}
@@ -0,0 +1,96 @@
+/*
+  LogJournal.h - Keeps the log open between rows without risking it on power loss.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  The log is created as one contiguous extent, so the FAT and the
+  directory entry never change while logging and only data blocks are
+  written. It is erased a little at a time ahead of the data. The first two blocks of the file are header lines, written in
+  turn (block seq & 1):
+
+    #AJ1 seq=0000000012 end=0000123456 done=0 sum=1a2b      ...spaces...\r\n
+
+  end is the byte offset up to which the log is known to be on the card.
+  A header is written every `checkpoint` blocks of data, and the data block
+  in the cache is written out first, so a power loss loses at most that many
+  blocks. Two alternating copies mean a header torn by the power loss still
+  leaves the previous one; sum (Fletcher-16 of the line before " sum=")
+  tells them apart.
+
+  At boot recover() picks the newest good header, reads on from end over
+  whatever was written after the checkpoint, stopping at erased bytes (0x00
+  or 0xFF depending on the card) or after checkpoint + 1 blocks, truncates
+  the file after the last complete row and marks it done. Since the file
+  size is the whole extent, SdFat reads each new block before writing into
+  it, so the unwritten end of a block is erased bytes rather than whatever
+  was last in the cache. A packed log (PackedLog.h) is kept up to the used
+  count of its last good block instead. Readers skip the header lines like
+  any other line that doesn't start with a digit.
+*/
+
+#ifndef LogJournal_h
+#define LogJournal_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+
+#define LOG_JOURNAL_MAGIC       "#AJ1"
+// two header blocks, data starts after them
+#define LOG_JOURNAL_DATA_START  1024
+// "#AJ1 seq=0000000012 end=0000123456 done=0 sum=1a2b", field offsets
+#define LOG_JOURNAL_SEQ_AT      9
+#define LOG_JOURNAL_END_AT      24
+#define LOG_JOURNAL_DONE_AT     40
+#define LOG_JOURNAL_SUM_AT      41
+#define LOG_JOURNAL_LINE_LEN    50
+// smallest extent begin() falls back to on a full or fragmented card
+#define LOG_JOURNAL_MIN_SIZE    1048576UL
+// blocks erased at a time, and kept erased past the one being written
+#define LOG_JOURNAL_ERASE_BLOCKS 64
+
+class LogJournal {
+  public:
+    LogJournal();
+    // creates name as a contiguous extent of about size bytes (halving on
+    // failure down to LOG_JOURNAL_MIN_SIZE) and leaves it open for writing
+    // at the start of the data; on failure nothing is left on the card
+    bool begin(const char *name, uint32_t size, uint16_t checkpoint);
+    bool isOpen() { return _file.isOpen(); }
+    SdBaseFile &file() { return _file; }
+    // end of the data written so far (the file size is the whole extent)
+    uint32_t position() { return _file.curPosition(); }
+    // true once fewer than reserve bytes are left in the extent, or with no
+    // log open
+    bool full(uint16_t reserve) { return !isOpen() || position() + reserve > _file.fileSize(); }
+    // call after each row; writes a header every checkpoint blocks of data
+    bool update();
+    // headers written since begin(); update() wrote one if it has changed
+    uint32_t seq() const { return _seq; }
+    // writes a header now, e.g. when logging stops
+    bool checkpoint();
+    // truncates to the data written, marks the log done and closes it
+    bool close();
+
+    // repairs every journaled *.CSV or *.APK in the working directory left open by
+    // a power loss; returns the number repaired
+    static uint8_t recoverAll(uint16_t checkpoint);
+    static bool recover(const char *name, uint16_t checkpoint);
+  private:
+    void discard();
+    void eraseAhead();
+    bool writeHeader(uint32_t end, bool done);
+    static bool readHeader(SdBaseFile &f, uint32_t *seq, uint32_t *end, bool *done);
+    static uint32_t packedEnd(SdBaseFile &f, uint32_t end, uint32_t limit);
+    static uint16_t fletcher16(const char *s, byte n);
+
+    SdFile _file;
+    uint32_t _firstBlock;
+    uint32_t _endBlock;    // the extent's last
+    uint32_t _erasedBlock; // first not yet erased
+    uint32_t _seq;
+    uint32_t _lastBlock; // data block count at the last header
+    uint16_t _checkpoint;
+};
+
+#endif
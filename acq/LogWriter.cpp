@@ -0,0 +1,44 @@
+#include "Arduino.h"
+#include "LogWriter.h"
+
+LogWriter::LogWriter(SdBaseFile &file) : _file(file) {
+  _buf = 0;
+  _avail = 0;
+  _used = 0;
+}
+
+size_t LogWriter::write(uint8_t c) {
+  if (_used == _avail) {
+    // block full (or none yet): hand it back and borrow the next one
+    if (!commit()) {
+      return 0;
+    }
+    _buf = _file.writeReserve(&_avail);
+    if (!_buf) {
+      _avail = 0;
+      return 0;
+    }
+  }
+  _buf[_used] = c;
+  _used = _used + 1;
+  return 1;
+}
+
+size_t LogWriter::write(const uint8_t *buf, size_t size) {
+  size_t n = 0;
+  while (n < size && write(buf[n])) {
+    n = n + 1;
+  }
+  return n;
+}
+
+bool LogWriter::commit() {
+  bool ok = true;
+  if (_used > 0) {
+    ok = _file.writeCommit(_used);
+  }
+  _buf = 0;
+  _avail = 0;
+  _used = 0;
+  return ok;
+}
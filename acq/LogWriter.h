@@ -0,0 +1,38 @@
+/*
+  LogWriter.h - Print that formats straight into the SdFat cache block.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Printing to an SdFile goes through SdBaseFile::write() one call per
+  print(), and every byte is copied from the caller into the cache. A
+  LogWriter borrows the cache block with writeReserve() and the Print
+  formatting writes each character into it in place. When the block
+  fills it is committed (and written to the card) and the next one is
+  borrowed, so rows that straddle a block boundary need no special case.
+
+  Nothing else may touch the card between the first print and commit().
+*/
+
+#ifndef LogWriter_h
+#define LogWriter_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+
+class LogWriter : public Print {
+  public:
+    LogWriter(SdBaseFile &file);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t size);
+    using Print::write;
+    // hands back what has been printed since the last commit
+    bool commit();
+  private:
+    SdBaseFile &_file;
+    uint8_t *_buf;
+    uint16_t _avail;
+    uint16_t _used;
+};
+
+#endif
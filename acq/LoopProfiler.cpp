@@ -0,0 +1,72 @@
+#include "Arduino.h"
+#include "LoopProfiler.h"
+
+LoopPhase LoopProfiler::_phases[PROF_PHASES];
+
+static const char phaseName0[] PROGMEM = "loop";
+static const char phaseName1[] PROGMEM = "touch";
+static const char phaseName2[] PROGMEM = "init_screen";
+static const char phaseName3[] PROGMEM = "status";
+static const char phaseName4[] PROGMEM = "row";
+static const char phaseName5[] PROGMEM = "sample";
+static const char phaseName6[] PROGMEM = "log_open";
+static const char phaseName7[] PROGMEM = "log_write";
+static const char phaseName8[] PROGMEM = "aggregate";
+static const char phaseName9[] PROGMEM = "plot";
+static const char phaseName10[] PROGMEM = "trend";
+static const char *const phaseNames[PROF_PHASES] PROGMEM = {
+  phaseName0, phaseName1, phaseName2, phaseName3, phaseName4,
+  phaseName5, phaseName6, phaseName7, phaseName8, phaseName9,
+  phaseName10
+};
+
+void LoopProfiler::record(byte phase, uint32_t us) {
+  LoopPhase &p = _phases[phase];
+  if (p.count == 0 || us < p.min) {
+    p.min = us;
+  }
+  if (us > p.max) {
+    p.max = us;
+  }
+  p.sum = p.sum + us;
+  p.count = p.count + 1;
+}
+
+void LoopProfiler::reset() {
+  memset(_phases, 0, sizeof(_phases));
+}
+
+uint32_t LoopProfiler::average(byte phase) {
+  const LoopPhase &p = _phases[phase];
+  return p.count == 0 ? 0 : p.sum / p.count;
+}
+
+void LoopProfiler::name(byte phase, char *buf, byte size) {
+  const char *p = (const char *)pgm_read_word(&phaseNames[phase]);
+  byte i = 0;
+  char c;
+  while (i < size - 1 && (c = pgm_read_byte(p + i))) {
+    buf[i] = c;
+    i = i + 1;
+  }
+  buf[i] = '\0';
+}
+
+void LoopProfiler::dump(Print *pr) {
+  char buf[16];
+  pr->println(F("# loop profile, microseconds, phases are inclusive of nested ones"));
+  pr->println(F("phase,count,min_us,avg_us,max_us"));
+  for (byte i = 0; i < PROF_PHASES; i = i + 1) {
+    name(i, buf, sizeof(buf));
+    pr->print(buf);
+    pr->write(',');
+    pr->print(_phases[i].count);
+    pr->write(',');
+    pr->print(_phases[i].min);
+    pr->write(',');
+    pr->print(average(i));
+    pr->write(',');
+    pr->print(_phases[i].max);
+    pr->println();
+  }
+}
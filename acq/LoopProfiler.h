@@ -0,0 +1,76 @@
+/*
+  LoopProfiler.h - Where loop() spends its time, by phase.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  A PROFILE_SCOPE(phase) at the top of a block times the rest of the block
+  with micros() and keeps calls, min, sum and max for that phase. Scopes
+  nest; each phase is inclusive of whatever it calls, so PROF_ROW covers
+  sample, log and aggregate together and its max is the worst case a row
+  has cost. LOG_INTERVAL can safely go down to about that max plus the
+  status/touch phases that run every pass of loop().
+
+  micros() has 4 us resolution on a 16 MHz AVR. Setting LOOP_PROFILE to 0
+  compiles the scopes out.
+*/
+
+#ifndef LoopProfiler_h
+#define LoopProfiler_h
+
+#include "Arduino.h"
+
+#ifndef LOOP_PROFILE
+#define LOOP_PROFILE 1
+#endif
+
+// phases, in the order the dump and the diagnostics page show them
+#define PROF_LOOP        0 // one pass of loop()
+#define PROF_TOUCH       1 // touch read and the button handling it triggers
+#define PROF_INIT_SCREEN 2 // init screen text redraw
+#define PROF_STATUS      3 // status line redraw
+#define PROF_ROW         4 // one logged row, sample to aggregate
+#define PROF_SAMPLE      5 // readChannels()
+#define PROF_LOG_OPEN    6 // journal rollover: close, index flush, openLog()
+#define PROF_LOG_WRITE   7 // row formatting, commit and journal checkpoint
+#define PROF_AGGREGATE   8 // aggregateChannels()
+#define PROF_PLOT        9 // one plotted pixel column
+#define PROF_TREND       10 // one period into the pyramid, TrendPyramid::close()
+#define PROF_PHASES      11
+
+struct LoopPhase {
+  uint32_t count;
+  uint32_t min; // us
+  uint32_t max; // us
+  uint64_t sum; // us, a uint32_t would wrap after 71 minutes of PROF_LOOP
+};
+
+class LoopProfiler {
+  public:
+    static void record(byte phase, uint32_t us);
+    static void reset();
+    // CSV: a "#" comment line, then phase,count,min_us,avg_us,max_us
+    static void dump(Print *pr);
+    static void name(byte phase, char *buf, byte size);
+    static const LoopPhase &phase(byte phase) { return _phases[phase]; }
+    static uint32_t average(byte phase);
+  private:
+    static LoopPhase _phases[PROF_PHASES];
+};
+
+class ProfileScope {
+  public:
+    explicit ProfileScope(byte phase) : _phase(phase), _start(micros()) {}
+    ~ProfileScope() { LoopProfiler::record(_phase, micros() - _start); }
+  private:
+    byte _phase;
+    uint32_t _start;
+};
+
+#if LOOP_PROFILE
+#define PROFILE_SCOPE(phase) ProfileScope profileScope_(phase)
+#else
+#define PROFILE_SCOPE(phase)
+#endif
+
+#endif
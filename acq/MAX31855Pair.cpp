@@ -0,0 +1,93 @@
+#include "Arduino.h"
+#include "MAX31855Pair.h"
+
+MAX31855Pair::MAX31855Pair(uint8_t clk0, uint8_t cs0, uint8_t do0,
+                           uint8_t clk1, uint8_t cs1, uint8_t do1) {
+  _clk[0] = clk0;
+  _cs[0] = cs0;
+  _do[0] = do0;
+  _clk[1] = clk1;
+  _cs[1] = cs1;
+  _do[1] = do1;
+}
+
+void MAX31855Pair::begin() {
+  for (byte i = 0; i < 2; i++) {
+    pinMode(_cs[i], OUTPUT);
+    pinMode(_clk[i], OUTPUT);
+    pinMode(_do[i], INPUT);
+    digitalWrite(_cs[i], HIGH);
+    digitalWrite(_clk[i], LOW);
+
+    // look the port registers up once so readFrames() never calls digitalWrite
+    _clkPort[i] = portOutputRegister(digitalPinToPort(_clk[i]));
+    _csPort[i] = portOutputRegister(digitalPinToPort(_cs[i]));
+    _doPin[i] = portInputRegister(digitalPinToPort(_do[i]));
+    _clkMask[i] = digitalPinToBitMask(_clk[i]);
+    _csMask[i] = digitalPinToBitMask(_cs[i]);
+    _doMask[i] = digitalPinToBitMask(_do[i]);
+  }
+}
+
+void MAX31855Pair::readFrames(uint32_t raw[2]) {
+  uint32_t d0 = 0;
+  uint32_t d1 = 0;
+
+  // the ports are reached through pointers, so the |= and &= below are
+  // read-modify-write whatever port the pins are on; keep interrupts off for the
+  // frame (about 20 us) so an ISR touching the same port can't be clobbered.
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  *_csPort[0] &= ~_csMask[0];
+  *_csPort[1] &= ~_csMask[1];
+  // D31 is valid 100 ns after CS falls
+  __asm__ __volatile__("nop\n\tnop\n\t");
+
+  for (int8_t i = 31; i >= 0; i--) {
+    d0 <<= 1;
+    d1 <<= 1;
+    if (*_doPin[0] & _doMask[0]) {
+      d0 |= 1;
+    }
+    if (*_doPin[1] & _doMask[1]) {
+      d1 |= 1;
+    }
+    // next bit is shifted out on the falling edge; 100 ns minimum high time
+    *_clkPort[0] |= _clkMask[0];
+    *_clkPort[1] |= _clkMask[1];
+    __asm__ __volatile__("nop\n\t");
+    *_clkPort[0] &= ~_clkMask[0];
+    *_clkPort[1] &= ~_clkMask[1];
+  }
+
+  *_csPort[0] |= _csMask[0];
+  *_csPort[1] |= _csMask[1];
+  SREG = oldSREG;
+
+  raw[0] = d0;
+  raw[1] = d1;
+}
+
+void MAX31855Pair::read(MAX31855Reading out[2]) {
+  uint32_t raw[2];
+  readFrames(raw);
+  decode(raw[0], &out[0]);
+  decode(raw[1], &out[1]);
+}
+
+void MAX31855Pair::decode(uint32_t raw, MAX31855Reading *out) {
+  // both fields are left-aligned in a signed word, so arithmetic shifts
+  // sign-extend them
+  out->internal = ((int16_t)(raw & 0xFFF0) >> 4) * 0.0625;
+  out->fault = raw & 0x07;
+  if (raw & MAX31855_FAULT) {
+    out->thermocouple = NAN;
+    if (out->fault == 0) {
+      out->fault = MAX31855_FAULT_OC;
+    }
+  }
+  else {
+    out->thermocouple = ((int32_t)raw >> 18) * 0.25;
+  }
+}
@@ -0,0 +1,61 @@
+/*
+  MAX31855Pair.h - Reads two MAX31855 thermocouple converters in parallel.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Both chips are bit-banged at the same time with direct port writes: every
+  clock edge is issued to both CLK pins back to back and both DO pins are
+  sampled before the next edge. One call clocks out a full 32-bit frame from
+  each chip, and the thermocouple temperature, cold-junction (internal)
+  temperature and fault bits are all decoded from that single frame.
+
+  MAX31855 frame layout:
+    D31..D18  thermocouple temperature, 14-bit signed, 0.25 C per LSB
+    D16       fault (any of D2..D0 set)
+    D15..D4   internal temperature, 12-bit signed, 0.0625 C per LSB
+    D2        short to VCC
+    D1        short to GND
+    D0        open circuit
+*/
+
+#ifndef MAX31855Pair_h
+#define MAX31855Pair_h
+
+#include "Arduino.h"
+
+#define MAX31855_FAULT      0x00010000UL
+#define MAX31855_FAULT_SCV  0x04
+#define MAX31855_FAULT_SCG  0x02
+#define MAX31855_FAULT_OC   0x01
+
+struct MAX31855Reading {
+  float thermocouple;  // C, NAN when the fault bit is set
+  float internal;      // C, cold-junction temperature
+  byte fault;          // MAX31855_FAULT_* bits, 0 when healthy
+};
+
+class MAX31855Pair {
+  public:
+    MAX31855Pair(uint8_t clk0, uint8_t cs0, uint8_t do0,
+                 uint8_t clk1, uint8_t cs1, uint8_t do1);
+    void begin();
+    // clocks a frame out of both chips; raw[0] and raw[1] receive the frames
+    void readFrames(uint32_t raw[2]);
+    // readFrames() followed by decode() for each chip
+    void read(MAX31855Reading out[2]);
+    static void decode(uint32_t raw, MAX31855Reading *out);
+  private:
+    uint8_t _clk[2];
+    uint8_t _cs[2];
+    uint8_t _do[2];
+
+    volatile uint8_t *_clkPort[2];
+    volatile uint8_t *_csPort[2];
+    volatile uint8_t *_doPin[2];
+    uint8_t _clkMask[2];
+    uint8_t _csMask[2];
+    uint8_t _doMask[2];
+};
+
+#endif
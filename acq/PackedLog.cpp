@@ -0,0 +1,208 @@
+#include "Arduino.h"
+#include "PackedLog.h"
+
+// hundredths, rounded the way Print::print(v, 2) rounds them so a packed
+// log unpacks to the digits the CSV would have had; false for nan, inf or
+// anything too big to keep
+static bool quantize(float v, int32_t *q) {
+  static const float rounding = 0.5f / 10.0f / 10.0f;
+  if (!(v > -1e7f && v < 1e7f)) {
+    return false;
+  }
+  bool negative = v < 0;
+  if (negative) {
+    v = -v;
+  }
+  v = v + rounding;
+  int32_t whole = (int32_t)v;
+  float frac = (v - (float)whole) * 10.0f;
+  byte tenths = (byte)frac;
+  byte hundredths = (byte)((frac - tenths) * 10.0f);
+  *q = whole * PACKED_LOG_SCALE + tenths * 10 + hundredths;
+  if (negative) {
+    *q = -*q;
+  }
+  return true;
+}
+
+static byte putVarint(uint8_t *out, uint32_t v) {
+  byte n = 0;
+  while (v >= 0x80) {
+    out[n] = (v & 0x7F) | 0x80;
+    v = v >> 7;
+    n = n + 1;
+  }
+  out[n] = v;
+  return n + 1;
+}
+
+static inline uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+PackedWriter::PackedWriter() {
+  _channels = 0;
+  _time = 0;
+}
+
+void PackedWriter::begin(uint8_t channels) {
+  _channels = channels > MAX_CHANNELS ? MAX_CHANNELS : channels;
+}
+
+byte PackedWriter::encode(uint8_t *out, uint32_t timestamp, const float *vals) {
+  byte maskBytes = (_channels + 7) / 8;
+  byte n = putVarint(out, zigzag(timestamp - _time));
+  uint8_t *mask = out + n;
+  memset(mask, 0, maskBytes);
+  n = n + maskBytes;
+  for (byte k = 0; k < _channels; k = k + 1) {
+    int32_t q;
+    uint32_t code;
+    if (!quantize(vals[k], &q)) {
+      code = 0;
+    }
+    else if (q == _prev[k]) {
+      continue;
+    }
+    else {
+      code = zigzag(q - _prev[k]);
+    }
+    mask[k >> 3] |= 1 << (k & 7);
+    n = n + putVarint(out + n, code);
+  }
+  return n;
+}
+
+bool PackedWriter::add(SdBaseFile &file, uint32_t timestamp, const float *vals) {
+  uint16_t avail;
+  uint8_t *buf = file.writeReserve(&avail);
+  if (!buf) {
+    return false;
+  }
+  uint8_t *block = buf - (512 - avail);
+  uint8_t row[PACKED_LOG_ROW_MAX(MAX_CHANNELS)];
+  byte n = 0;
+  bool fresh = avail == 512 || block[0] != PACKED_LOG_MAGIC;
+  if (!fresh) {
+    n = encode(row, timestamp, vals);
+    if (n > avail) {
+      // finish this block with zeros and start the next
+      memset(buf, 0, avail);
+      if (!file.writeCommit(avail) || !(buf = file.writeReserve(&avail))) {
+        return false;
+      }
+      block = buf - (512 - avail);
+      fresh = true;
+    }
+  }
+  if (fresh) {
+    if (avail != 512) {
+      // not on a block boundary, so not following a header block: pad it out
+      memset(buf, 0, avail);
+      if (!file.writeCommit(avail) || !(buf = file.writeReserve(&avail))) {
+        return false;
+      }
+      block = buf;
+    }
+    memset(_prev, 0, sizeof(_prev));
+    _time = timestamp;
+    n = encode(row, timestamp, vals);
+    block[0] = PACKED_LOG_MAGIC;
+    block[1] = _channels;
+    memset(block + 2, 0, 4);
+    memcpy(block + 6, &timestamp, 4);
+    buf = block + PACKED_LOG_HEADER_SIZE;
+    avail = avail - PACKED_LOG_HEADER_SIZE;
+  }
+  memcpy(buf, row, n);
+
+  uint16_t used = 512 - avail + n;
+  uint16_t rows;
+  memcpy(&rows, block + 4, 2);
+  rows = rows + 1;
+  memcpy(block + 2, &used, 2);
+  memcpy(block + 4, &rows, 2);
+
+  _time = timestamp;
+  for (byte k = 0; k < _channels; k = k + 1) {
+    int32_t q;
+    if (quantize(vals[k], &q)) {
+      _prev[k] = q;
+    }
+  }
+  return file.writeCommit(fresh ? PACKED_LOG_HEADER_SIZE + n : n);
+}
+
+uint16_t PackedReader::used(const uint8_t *block) {
+  uint16_t used;
+  memcpy(&used, block + 2, 2);
+  if (block[0] != PACKED_LOG_MAGIC || block[1] == 0 || block[1] > MAX_CHANNELS
+      || used <= PACKED_LOG_HEADER_SIZE || used > 512) {
+    return 0;
+  }
+  return used;
+}
+
+bool PackedReader::begin(const uint8_t *block) {
+  _used = used(block);
+  if (_used == 0) {
+    return false;
+  }
+  _block = block;
+  _channels = block[1];
+  memcpy(&_rows, block + 4, 2);
+  memcpy(&_time, block + 6, 4);
+  memset(_prev, 0, sizeof(_prev));
+  _pos = PACKED_LOG_HEADER_SIZE;
+  return true;
+}
+
+bool PackedReader::varint(uint32_t *v) {
+  *v = 0;
+  for (byte shift = 0; shift < 35 && _pos < _used; shift = shift + 7) {
+    uint8_t b = _block[_pos];
+    _pos = _pos + 1;
+    *v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PackedReader::next(uint32_t *timestamp, float *vals) {
+  if (_rows == 0 || _pos >= _used) {
+    return false;
+  }
+  uint32_t dt;
+  byte maskBytes = (_channels + 7) / 8;
+  if (!varint(&dt) || _pos + maskBytes > _used) {
+    _rows = 0;
+    return false;
+  }
+  const uint8_t *mask = _block + _pos;
+  _pos = _pos + maskBytes;
+  _time = _time + unzigzag(dt);
+  *timestamp = _time;
+  for (byte k = 0; k < _channels; k = k + 1) {
+    if (mask[k >> 3] & (1 << (k & 7))) {
+      uint32_t code;
+      if (!varint(&code)) {
+        _rows = 0;
+        return false;
+      }
+      if (code == 0) {
+        vals[k] = NAN;
+        continue;
+      }
+      _prev[k] = _prev[k] + unzigzag(code);
+    }
+    vals[k] = (float)_prev[k] / PACKED_LOG_SCALE;
+  }
+  _rows = _rows - 1;
+  return true;
+}
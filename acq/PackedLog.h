@@ -0,0 +1,88 @@
+/*
+  PackedLog.h - Delta-coded binary log rows, packed a block at a time.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  With LOG_PACKED set in acq.ino the log is YYMMDD-x.APK instead of a CSV.
+  It starts like a CSV: the two journal header blocks, then the column
+  header row, padded with spaces to the end of its block. Every block after
+  that is a packed block that decodes on its own:
+
+    header, 10 bytes, little-endian
+      uint8_t  magic      'P'
+      uint8_t  channels   logged channels, n
+      uint16_t used       bytes of the block in use, header included
+      uint16_t rows
+      uint32_t timestamp  RTC unixtime of the first row
+    row
+      varint   zig-zag seconds since the previous row (0 for the first)
+      uint8_t  changed[(n + 7) / 8], bit k%8 of byte k/8 set if channel k follows
+      varint   per changed channel, zig-zag of the change in hundredths
+               since its last value in the block (0 before the first row);
+               0, which no real change encodes to, means nan
+
+  Values keep the hundredths the CSV prints. Varints are 7 bits a byte, low
+  first, the top bit set on all but the last. A row that doesn't fit ends
+  the block (the rest of it zeros) and starts the next one, so a block lost
+  or torn costs only its own rows, and LogJournal::recover() keeps whole
+  blocks up to their used count.
+
+  A row of slowly changing channels is the time byte, the changed bytes and
+  a byte or two per channel that moved, against 60 to 70 characters of CSV.
+*/
+
+#ifndef PackedLog_h
+#define PackedLog_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+#include "Channels.h"
+
+#define PACKED_LOG_EXT         ".APK"
+#define PACKED_LOG_MAGIC       'P'
+#define PACKED_LOG_HEADER_SIZE 10
+#define PACKED_LOG_SCALE       100
+// the most a row of n channels can take
+#define PACKED_LOG_ROW_MAX(n)  (5 + ((n) + 7) / 8 + 5 * (n))
+
+class PackedWriter {
+  public:
+    PackedWriter();
+    // call once a new log's column header block is written
+    void begin(uint8_t channels);
+    // appends a row of the logged values, in column order, to file's block
+    // in the cache; like LogWriter, a block is written out when it fills
+    bool add(SdBaseFile &file, uint32_t timestamp, const float *vals);
+  private:
+    byte encode(uint8_t *out, uint32_t timestamp, const float *vals);
+
+    uint8_t _channels;
+    uint32_t _time;
+    int32_t _prev[MAX_CHANNELS];
+};
+
+class PackedReader {
+  public:
+    // used bytes of a packed block, 0 if block isn't one
+    static uint16_t used(const uint8_t *block);
+    // starts on one block; false if it isn't a packed block
+    bool begin(const uint8_t *block);
+    uint8_t channels() const { return _channels; }
+    // offset in the block of the row next() reads
+    uint16_t offset() const { return _pos; }
+    // the next row; false after the last or on a corrupt row
+    bool next(uint32_t *timestamp, float *vals);
+  private:
+    bool varint(uint32_t *v);
+
+    const uint8_t *_block;
+    uint16_t _pos;
+    uint16_t _used;
+    uint16_t _rows;
+    uint8_t _channels;
+    uint32_t _time;
+    int32_t _prev[MAX_CHANNELS];
+};
+
+#endif
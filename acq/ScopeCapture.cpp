@@ -0,0 +1,187 @@
+#include "Arduino.h"
+#include <SdFat.h>
+#include "ScopeCapture.h"
+#include "LogWriter.h"
+
+ScopeCapture::ScopeCapture() {
+  _state = SCOPE_IDLE;
+  _channels = 0;
+  _pre = 0;
+  _post = 0;
+  _size = 0;
+  _head = 0;
+  _ring = 0;
+}
+
+bool ScopeCapture::arm(uint8_t channels, uint16_t pre, uint16_t post, uint8_t mode, uint8_t slot, int16_t level) {
+  disarm();
+  if (channels == 0 || channels > SCOPE_RING_SAMPLES) {
+    return false;
+  }
+  _ring = (uint16_t *)SharedBuffer::claim(SHARED_SCOPE);
+  if (!_ring) {
+    return false;
+  }
+  uint16_t ringFrames = SCOPE_RING_SAMPLES / channels;
+  if (post == 0) {
+    post = 1;
+  }
+  if (post > ringFrames) {
+    post = ringFrames;
+  }
+  if (pre > ringFrames - post) {
+    pre = ringFrames - post;
+  }
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  _channels = channels;
+  _pre = pre;
+  _post = post;
+  _mode = mode;
+  _slot = slot;
+  _level = level;
+  _size = ringFrames * channels;
+  _head = 0;
+  _count = 0;
+  // the edge tests need one sample of the trigger slot before going live
+  _armAt = (pre > 0 ? pre : 1) * channels;
+  _lastTc = NAN;
+  _state = SCOPE_SYNC;
+  SREG = oldSREG;
+  return true;
+}
+
+void ScopeCapture::disarm() {
+  _state = SCOPE_IDLE;
+  SharedBuffer::release(SHARED_SCOPE);
+}
+
+bool ScopeCapture::crossed(int16_t last, int16_t now) const {
+  switch (_mode) {
+    case SCOPE_TRIG_RISING:
+      return last < _level && now >= _level;
+    case SCOPE_TRIG_FALLING:
+      return last > _level && now <= _level;
+    case SCOPE_TRIG_SLOPE:
+      return now - last >= _level || last - now >= _level;
+  }
+  return false;
+}
+
+// remaining is how many samples to take after this one; the trigger frame
+// is the one those leave post frames from the end
+void ScopeCapture::fire(uint16_t remaining) {
+  if (remaining == 0) {
+    _state = SCOPE_DONE;
+    return;
+  }
+  _count = remaining;
+  _state = SCOPE_TRIGGERED;
+}
+
+void ScopeCapture::push(uint8_t slot, uint16_t sample) {
+  uint8_t state = _state;
+  if (state == SCOPE_IDLE || state == SCOPE_DONE) {
+    return;
+  }
+  if (state == SCOPE_SYNC) {
+    if (slot != 0) {
+      return;
+    }
+    state = SCOPE_FILLING;
+    _state = state;
+  }
+  _ring[_head] = sample;
+  _head = _head + 1 == _size ? 0 : _head + 1;
+
+  if (state == SCOPE_TRIGGERED) {
+    _count = _count - 1;
+    if (_count == 0) {
+      _state = SCOPE_DONE;
+    }
+    return;
+  }
+  if (state == SCOPE_FILLING) {
+    _count = _count + 1;
+    if (_count == _armAt) {
+      _state = SCOPE_ARMED;
+    }
+  }
+  if (slot == _slot && _mode <= SCOPE_TRIG_SLOPE) {
+    if (state == SCOPE_ARMED && crossed(_last, sample)) {
+      // finish the trigger frame, then post - 1 more
+      fire((_channels - 1 - slot) + (_post - 1) * _channels);
+    }
+    _last = sample;
+  }
+}
+
+void ScopeCapture::trigger() {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  if (_state == SCOPE_ARMED) {
+    // the trigger frame is the next whole one
+    uint8_t next = _head % _channels;
+    fire((next > 0 ? _channels - next : 0) + _post * _channels);
+  }
+  SREG = oldSREG;
+}
+
+void ScopeCapture::poll(float value) {
+  if ((_mode != SCOPE_TRIG_TC_ABOVE && _mode != SCOPE_TRIG_TC_BELOW) || isnan(value)) {
+    return;
+  }
+  bool fired = false;
+  if (!isnan(_lastTc)) {
+    if (_mode == SCOPE_TRIG_TC_ABOVE) {
+      fired = _lastTc < _level && value >= _level;
+    }
+    else {
+      fired = _lastTc > _level && value <= _level;
+    }
+  }
+  _lastTc = value;
+  if (fired) {
+    trigger();
+  }
+}
+
+uint16_t ScopeCapture::sample(uint16_t frame, uint8_t slot) const {
+  // the window ends where the ring stopped
+  uint16_t i = _head + _size - frames() * _channels + frame * _channels + slot;
+  while (i >= _size) {
+    i = i - _size;
+  }
+  return _ring[i];
+}
+
+bool ScopeCapture::write(const char *name, const Channel *channels, const byte *slotChannel,
+                         uint16_t frameMicros) {
+  SdFile f;
+  if (!done() || !f.open(name, O_CREAT | O_WRITE | O_TRUNC)) {
+    return false;
+  }
+  LogWriter out(f); // formats in place in the SD cache block
+  out.print("t[us]");
+  for (byte s = 0; s < _channels; s = s + 1) {
+    const Channel &c = channels[slotChannel[s]];
+    out.print('\t');
+    out.print(c.label);
+    out.print('[');
+    out.print(c.units);
+    out.print(']');
+  }
+  out.println();
+  for (uint16_t i = 0; i < frames(); i = i + 1) {
+    out.print(((long)i - _pre) * frameMicros);
+    for (byte s = 0; s < _channels; s = s + 1) {
+      const Channel &c = channels[slotChannel[s]];
+      out.print('\t');
+      out.print(sample(i, s) * c.scale + c.offset);
+    }
+    out.println();
+  }
+  bool ok = out.commit();
+  return f.close() && ok;
+}
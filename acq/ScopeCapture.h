@@ -0,0 +1,105 @@
+/*
+  ScopeCapture.h - Pre-trigger ring buffer for catching fast transients.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Logging only sees the decimated channels once every LOG_INTERVAL. In
+  scope mode the AdcSampler also hands every raw conversion to a
+  ScopeCapture, which keeps the last SCOPE_RING_SAMPLES of them in RAM a
+  frame (one sample of each analog slot, in slot order) at a time. Once
+  pre frames are in, the trigger is live; when it fires, post more frames
+  are taken and the ring freezes holding pre frames before the trigger
+  frame and post from it on, for loop() to read with sample() or save
+  with write().
+
+    SCOPE_TRIG_RISING    trigger slot goes from below level to level or above
+    SCOPE_TRIG_FALLING   from above level to level or below
+    SCOPE_TRIG_SLOPE     moves by level or more, either way, in one sample
+    SCOPE_TRIG_TC_ABOVE  thermocouple reading handed to poll() rises to level
+    SCOPE_TRIG_TC_BELOW  falls to level
+
+  The analog modes are tested in the ADC interrupt on raw 0-1023 counts at
+  the full conversion rate. A thermocouple converts only every 100 ms, so
+  the TC modes are tested by poll() from loop(), and the trigger frame is
+  the one being sampled when poll() sees the crossing.
+
+  The ring is the SharedBuffer, claimed by arm() and released by disarm(),
+  so arm() fails while the live stream or the input trace has it.
+*/
+
+#ifndef ScopeCapture_h
+#define ScopeCapture_h
+
+#include "Arduino.h"
+#include "Channels.h"
+#include "SharedBuffer.h"
+
+// all of the SharedBuffer; frames are SCOPE_RING_SAMPLES / analog slots
+#define SCOPE_RING_SAMPLES (SHARED_BUFFER_BYTES / 2)
+
+#define SCOPE_TRIG_RISING   0
+#define SCOPE_TRIG_FALLING  1
+#define SCOPE_TRIG_SLOPE    2
+#define SCOPE_TRIG_TC_ABOVE 3
+#define SCOPE_TRIG_TC_BELOW 4
+
+#define SCOPE_IDLE      0
+#define SCOPE_SYNC      1 // waiting for slot 0 to start the first frame
+#define SCOPE_FILLING   2 // taking the pre frames, trigger not yet live
+#define SCOPE_ARMED     3
+#define SCOPE_TRIGGERED 4 // taking the post frames
+#define SCOPE_DONE      5
+
+class ScopeCapture {
+  public:
+    ScopeCapture();
+    // starts taking frames of channels samples; pre + post is cut down to
+    // what the ring holds. slot is the analog slot, or the thermocouple for
+    // the TC modes; level is in raw counts, or whole degrees C. False if
+    // there are no channels or the SharedBuffer is taken
+    bool arm(uint8_t channels, uint16_t pre, uint16_t post, uint8_t mode, uint8_t slot, int16_t level);
+    void disarm();
+    uint8_t state() const { return _state; }
+    bool done() const { return _state == SCOPE_DONE; }
+    // fires now if armed
+    void trigger();
+    // for the TC modes, each new reading of the trigger thermocouple
+    void poll(float value);
+
+    // once done(): frames captured, the trigger frame being frame pre()
+    uint16_t frames() const { return _pre + _post; }
+    uint16_t pre() const { return _pre; }
+    uint8_t channels() const { return _channels; }
+    // raw 0-1023 sample of slot in frame
+    uint16_t sample(uint16_t frame, uint8_t slot) const;
+    // tab separated like the log: a header row, then a row per frame of
+    // microseconds from the trigger frame and each slot's value through its
+    // channel's scale and offset; slotChannel maps slots to channels[]
+    bool write(const char *name, const Channel *channels, const byte *slotChannel,
+               uint16_t frameMicros);
+
+    // from the ADC interrupt, every conversion
+    void push(uint8_t slot, uint16_t sample);
+  private:
+    bool crossed(int16_t last, int16_t now) const;
+    void fire(uint16_t remaining);
+
+    volatile uint8_t _state;
+    uint8_t _mode;
+    uint8_t _slot;
+    uint8_t _channels;
+    int16_t _level;
+    uint16_t _pre;
+    uint16_t _post;
+    uint16_t _size;
+    volatile uint16_t _head;
+    // samples taken while filling, then samples still to take once triggered
+    volatile uint16_t _count;
+    uint16_t _armAt;
+    int16_t _last;
+    float _lastTc;
+    uint16_t *_ring;
+};
+
+#endif
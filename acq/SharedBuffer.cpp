@@ -0,0 +1,39 @@
+#include "Arduino.h"
+#include "SharedBuffer.h"
+
+// uint16_t so the scope's samples are aligned
+static uint16_t shared[SHARED_BUFFER_BYTES / 2];
+
+volatile uint8_t SharedBuffer::_owner = SHARED_NONE;
+
+uint8_t *SharedBuffer::claim(uint8_t owner) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  bool ok = _owner == SHARED_NONE || _owner == owner;
+  if (ok) {
+    _owner = owner;
+  }
+  SREG = oldSREG;
+  return ok ? (uint8_t *)shared : 0;
+}
+
+void SharedBuffer::release(uint8_t owner) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  if (_owner == owner) {
+    _owner = SHARED_NONE;
+  }
+  SREG = oldSREG;
+}
+
+const char *SharedBuffer::ownerName() {
+  switch (_owner) {
+    case SHARED_SCOPE:
+      return "scope";
+    case SHARED_STREAM:
+      return "stream";
+    case SHARED_TRACE:
+      return "trace";
+  }
+  return "nobody";
+}
@@ -0,0 +1,46 @@
+/*
+  SharedBuffer.h - One block of RAM taken in turn by the scope, stream and trace.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  The scope's pre-trigger ring, the live stream's byte ring and the input
+  trace's record buffer are the biggest buffers in the sketch, and each is
+  only needed while its feature runs. The three never run together, so
+  rather than each keeping its own for the whole run they take turns at
+  one SHARED_BUFFER_BYTES block: claim() hands it to an owner if no other
+  has it, and release() gives it back. An owner that claims it again gets
+  it again, so re-arming or restarting needs no release first.
+
+  Claims are made from loop(); release() may also be called from an
+  interrupt, as FrameStream does once its ring has drained.
+*/
+
+#ifndef SharedBuffer_h
+#define SharedBuffer_h
+
+#include "Arduino.h"
+
+// the scope ring's 512 samples; the stream's ring and header, and the
+// trace's buffer, fit inside
+#define SHARED_BUFFER_BYTES 1024
+
+#define SHARED_NONE   0
+#define SHARED_SCOPE  1
+#define SHARED_STREAM 2
+#define SHARED_TRACE  3
+
+class SharedBuffer {
+  public:
+    // the block, word aligned, or 0 if another owner has it
+    static uint8_t *claim(uint8_t owner);
+    // does nothing unless owner has it
+    static void release(uint8_t owner);
+    static uint8_t owner() { return _owner; }
+    // for "busy" messages
+    static const char *ownerName();
+  private:
+    static volatile uint8_t _owner;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "Arduino.h"
+#include "TrendPyramid.h"
+
+static_assert(((6 * TREND_MAX_CHANNELS) << TREND_BLOCK_LEVELS) <= TREND_BLOCK_BYTES,
+              "level 0's block can't hold 2^TREND_BLOCK_LEVELS buckets of every channel");
+
+// to the nearest, as channelToPx() rounds a reading to a row
+static int16_t average(int32_t sum, int32_t n) {
+  return sum >= 0 ? (sum + n / 2) / n : (sum - n / 2) / n;
+}
+
+// render()'s column being put together
+struct TrendRender {
+  uint16_t perColumn;
+  TrendColumn draw;
+  int column;
+  TrendBucket col;
+  byte means[TREND_MAX_CHANNELS]; // buckets in col.mean, to average them
+};
+
+// a column takes the buckets that start in it
+static void addBucket(TrendRender &c, byte n, uint32_t period, const TrendBucket &b) {
+  int column = period / c.perColumn;
+  if (column != c.column) {
+    if (c.column >= 0) {
+      c.draw(c.column, c.col);
+    }
+    c.column = column;
+    c.col = b;
+    for (byte k = 0; k < n; k = k + 1) {
+      c.means[k] = b.mean[k] != TREND_NONE;
+    }
+    return;
+  }
+  for (byte k = 0; k < n; k = k + 1) {
+    if (b.mean[k] == TREND_NONE) {
+      continue;
+    }
+    if (c.means[k] == 0 || b.min[k] < c.col.min[k]) {
+      c.col.min[k] = b.min[k];
+    }
+    if (c.means[k] == 0 || b.max[k] > c.col.max[k]) {
+      c.col.max[k] = b.max[k];
+    }
+    c.col.mean[k] = average((int32_t)c.col.mean[k] * c.means[k] + b.mean[k], c.means[k] + 1);
+    c.means[k] = c.means[k] + 1;
+  }
+}
+
+TrendPyramid::TrendPyramid() {
+  _firstBlock = 0;
+  _list = 0;
+  _n = 0;
+  _toPx = 0;
+  _periods = 0;
+  _perBlock = 1 << TREND_BLOCK_LEVELS;
+  _blockLevels = TREND_BLOCK_LEVELS;
+}
+
+void TrendPyramid::setChannels(const byte *list, byte n, int (*toPx)(byte channel, float val)) {
+  _list = list;
+  _n = n < TREND_MAX_CHANNELS ? n : TREND_MAX_CHANNELS;
+  _toPx = toPx;
+  // as many as fit, up to one bucket making the top level
+  _blockLevels = TREND_LEVELS - 1;
+  while (_blockLevels > TREND_BLOCK_LEVELS && ((6 * _n) << _blockLevels) > TREND_BLOCK_BYTES) {
+    _blockLevels = _blockLevels - 1;
+  }
+  _perBlock = 1 << _blockLevels;
+}
+
+bool TrendPyramid::begin() {
+  uint32_t size = 512UL * TREND_LEVELS * TREND_LEVEL_BLOCKS;
+  uint32_t lastBlock;
+  if (!_file.isOpen()) {
+    if (_file.open(TREND_FILE, O_RDWR)
+        && (_file.fileSize() < size || !_file.contiguousRange(&_firstBlock, &lastBlock))) {
+      _file.remove(); // made for another layout, or no longer in one piece
+    }
+    if (!_file.isOpen() && _file.createContiguous(SdBaseFile::cwd(), TREND_FILE, size)
+        && !_file.contiguousRange(&_firstBlock, &lastBlock)) {
+      _file.close();
+    }
+  }
+  _periods = 0;
+  for (byte k = 0; k < TREND_MAX_CHANNELS; k = k + 1) {
+    _count[k] = 0;
+    _sum[k] = 0;
+  }
+  return _file.isOpen();
+}
+
+void TrendPyramid::add(const float *vals) {
+  for (byte k = 0; k < _n; k = k + 1) {
+    float v = vals[_list[k]];
+    if (isnan(v)) {
+      continue;
+    }
+    int32_t row = _toPx(_list[k], v);
+    row = constrain(row, -32767L, 32767L);
+    if (_count[k] == 0 || row < _min[k]) {
+      _min[k] = row;
+    }
+    if (_count[k] == 0 || row > _max[k]) {
+      _max[k] = row;
+    }
+    _sum[k] = _sum[k] + row;
+    _count[k] = _count[k] + 1;
+  }
+}
+
+void TrendPyramid::close() {
+  TrendBucket b;
+  for (byte k = 0; k < _n; k = k + 1) {
+    if (_count[k] == 0) {
+      b.min[k] = TREND_NONE;
+      b.max[k] = TREND_NONE;
+      b.mean[k] = TREND_NONE;
+    }
+    else {
+      b.min[k] = _min[k];
+      b.max[k] = _max[k];
+      b.mean[k] = average(_sum[k], _count[k]);
+    }
+    _count[k] = 0;
+    _sum[k] = 0;
+  }
+  pack(b, _periods % _perBlock);
+  _periods = _periods + 1;
+  if (_periods % _perBlock == 0) {
+    flush();
+  }
+}
+
+// level 0's full block to the card, and everything above it that it makes
+void TrendPyramid::flush() {
+  if (!_file.isOpen()) {
+    return;
+  }
+  cache_t *pc = _file.volume()->cacheClear();
+  if (!pc) {
+    return;
+  }
+  uint32_t first = _periods - _perBlock;
+  store(pc, 0, first, _perBlock);
+
+  // every second bucket of a level is merged with the first into the
+  // level above, in place: bucket k of a level comes from 2k and 2k + 1
+  TrendBucket a;
+  TrendBucket b;
+  byte level = 0;
+  byte count = _perBlock;
+  while (level < _blockLevels) {
+    level = level + 1;
+    count = count >> 1;
+    for (byte k = 0; k < count; k = k + 1) {
+      unpack(_block + 3 * _n * (2 * k), a);
+      unpack(_block + 3 * _n * (2 * k + 1), b);
+      merge(b, a);
+      pack(b, k);
+    }
+    store(pc, level, first >> level, count);
+  }
+
+  // above the block, its one bucket pairs up with the last block's
+  uint32_t index = first >> level;
+  unpack(_block, b);
+  while (level < TREND_LEVELS - 1) {
+    if ((index & 1) == 0) {
+      _pending[level - TREND_BLOCK_LEVELS] = b;
+      break;
+    }
+    merge(b, _pending[level - TREND_BLOCK_LEVELS]);
+    index = index >> 1;
+    level = level + 1;
+    pack(b, 0);
+    store(pc, level, index, 1);
+  }
+}
+
+// count buckets from the start of _block into level from index on; the
+// block they go to is read first if an earlier flush started it
+bool TrendPyramid::store(cache_t *pc, byte level, uint32_t index, byte count) {
+  if (index >= TREND_BUCKETS) {
+    return true;
+  }
+  if (index + count > TREND_BUCKETS) {
+    count = TREND_BUCKETS - index;
+  }
+  Sd2Card *card = _file.volume()->sdCard();
+  uint32_t block = _firstBlock + (uint32_t)level * TREND_LEVEL_BLOCKS + index / _perBlock;
+  uint16_t at = (index % _perBlock) * 6 * _n;
+  if (at > 0 && !card->readBlock(block, pc->data)) {
+    return false;
+  }
+  memcpy(pc->data + at, _block, count * 6 * _n);
+  return card->writeBlock(block, pc->data);
+}
+
+uint16_t TrendPyramid::render(uint16_t perColumn, uint16_t columns, TrendColumn draw) {
+  if (perColumn == 0) {
+    return 0;
+  }
+  uint32_t complete = _periods / perColumn;
+  if (complete > columns) {
+    complete = columns;
+  }
+  byte level = 0;
+  while (level < TREND_LEVELS - 1 && (2UL << level) <= perColumn) {
+    level = level + 1;
+  }
+  uint32_t end = complete * perColumn;
+  if (end > (uint32_t)TREND_BUCKETS << level) {
+    end = (uint32_t)TREND_BUCKETS << level;
+  }
+  if (end == 0) {
+    return complete;
+  }
+  TrendRender c;
+  c.perColumn = perColumn;
+  c.draw = draw;
+  c.column = -1;
+  TrendBucket b;
+
+  // the card has the level's buckets up to the last full block...
+  uint32_t flushed = _periods - _periods % _perBlock;
+  uint32_t buckets = flushed >> level;
+  if (buckets > ((end - 1) >> level) + 1) {
+    buckets = ((end - 1) >> level) + 1;
+  }
+  cache_t *pc = buckets > 0 && _file.isOpen() ? _file.volume()->cacheClear() : 0;
+  if (pc) {
+    Sd2Card *card = _file.volume()->sdCard();
+    uint32_t block = _firstBlock + (uint32_t)level * TREND_LEVEL_BLOCKS;
+    for (uint32_t j = 0; j < buckets; j = j + 1) {
+      byte slot = j % _perBlock;
+      if (slot == 0 && !card->readBlock(block + j / _perBlock, pc->data)) {
+        break;
+      }
+      unpack((int16_t *)pc->data + 3 * _n * slot, b);
+      addBucket(c, _n, j << level, b);
+    }
+  }
+  // ...then, above the block's own levels, the pairs still waiting...
+  for (byte up = level; up > _blockLevels; up = up - 1) {
+    byte l = up - 1;
+    uint32_t period = flushed >> up << up;
+    if ((flushed >> l & 1) && period < end) {
+      addBucket(c, _n, period, _pending[l - TREND_BLOCK_LEVELS]);
+    }
+  }
+  // ...and the block being filled
+  for (uint32_t p = flushed; p < _periods && p < end; p = p + 1) {
+    unpack(_block + 3 * _n * (p - flushed), b);
+    addBucket(c, _n, p, b);
+  }
+  if (c.column >= 0) {
+    draw(c.column, c.col);
+  }
+  return complete;
+}
+
+// into is the later of the pair
+void TrendPyramid::merge(TrendBucket &into, const TrendBucket &from) {
+  for (byte k = 0; k < _n; k = k + 1) {
+    if (from.mean[k] == TREND_NONE) {
+      continue;
+    }
+    if (into.mean[k] == TREND_NONE) {
+      into.min[k] = from.min[k];
+      into.max[k] = from.max[k];
+      into.mean[k] = from.mean[k];
+      continue;
+    }
+    if (from.min[k] < into.min[k]) {
+      into.min[k] = from.min[k];
+    }
+    if (from.max[k] > into.max[k]) {
+      into.max[k] = from.max[k];
+    }
+    // both cover the same time, whatever the readings in each
+    into.mean[k] = average((int32_t)into.mean[k] + from.mean[k], 2);
+  }
+}
+
+// the AVR is little-endian, so fields sit in _block as they go to the card
+void TrendPyramid::pack(const TrendBucket &b, byte slot) {
+  int16_t *to = _block + 3 * _n * slot;
+  memcpy(to, b.min, 2 * _n);
+  memcpy(to + _n, b.max, 2 * _n);
+  memcpy(to + 2 * _n, b.mean, 2 * _n);
+}
+
+void TrendPyramid::unpack(const int16_t *from, TrendBucket &b) const {
+  memcpy(b.min, from, 2 * _n);
+  memcpy(b.max, from + _n, 2 * _n);
+  memcpy(b.mean, from + 2 * _n, 2 * _n);
+}
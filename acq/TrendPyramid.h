@@ -0,0 +1,122 @@
+/*
+  TrendPyramid.h - The plotted channels' min, max and mean at every timescale.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  The live chart draws a column every graph_interval from what was folded
+  in since the last one, so its timescale is whatever it was when logging
+  started. A TrendPyramid keeps the same readings at several resolutions
+  as logging goes on: level 0 has a bucket per TREND_PERIOD_MS, one column
+  of the 1 hour chart, and each level above it a bucket per two of the
+  level below. render() redraws the run so far at any timescale from the
+  finest level whose buckets are no wider than its columns, reading at
+  most twice as many buckets as there are columns.
+
+  A bucket holds, per channel, the min, max and mean chart row (toPx of
+  the readings, so the smaller row is the higher value), or TREND_NONE for
+  each when every reading was NAN. A level's bucket is the two below it
+  merged, their means averaged. Each level keeps the run's first
+  TREND_BUCKETS, twice the chart's width, which is as far as any timescale
+  drawn from it reaches; charts of over 2^TREND_LEVELS hours get their
+  first 2^TREND_LEVELS hours.
+
+  Even one level a chart wide is more than the Mega's 8 KB of RAM, so
+  buckets go to TREND_FILE on the card: a contiguous file made once and
+  written over from the start on every begin(). Level L has
+  TREND_LEVEL_BLOCKS blocks from L * TREND_LEVEL_BLOCKS blocks in, and its
+  buckets fill them in turn, a whole number to a block (the rest is left
+  unused), each 6n bytes, int16 little-endian:
+
+    int16_t  min[n]    per channel, in setChannels() order
+    int16_t  max[n]
+    int16_t  mean[n]
+
+  A block holds 16 buckets up to 5 channels and 8 above. Level 0's block
+  being filled is kept in RAM; once it is full it goes to the card, the
+  pairs in it are merged in place into the levels above as far as they
+  go, and each level's new buckets go after the ones before them, the
+  levels still higher carrying on from pairs kept waiting in RAM. That is
+  at most a block written per level every 8 or 16 periods and a block
+  read for each level whose block was started by an earlier one. The
+  blocks are read and written straight to the card, as LogJournal writes
+  its header, with no cluster chain to follow and only the SdFat cache's
+  own block to give up; the log's row takes it back with one read.
+
+  RAM is the bucket being filled, level 0's block and the pair waiting
+  above it: about 650 bytes.
+*/
+
+#ifndef TrendPyramid_h
+#define TrendPyramid_h
+
+#include "Arduino.h"
+#include <SdFat.h>
+
+#define TREND_FILE         "TREND.PYR"
+#define TREND_PERIOD_MS    5547L // a chart column per hour charted: 3600000 / 649
+#define TREND_LEVELS       5     // buckets of 1, 2, 4, 8 and 16 periods
+#define TREND_BUCKETS      1298  // per level
+#define TREND_MAX_CHANNELS 8
+#define TREND_NONE         (-32767 - 1)
+// level 0's block in RAM: 16 buckets of 5 channels, or 8 of TREND_MAX_CHANNELS
+#define TREND_BLOCK_BYTES  480
+// levels a block always makes in place, from 2^TREND_BLOCK_LEVELS buckets
+#define TREND_BLOCK_LEVELS 3
+#define TREND_LEVEL_BLOCKS ((TREND_BUCKETS + (1 << TREND_BLOCK_LEVELS) - 1) >> TREND_BLOCK_LEVELS)
+
+struct TrendBucket {
+  int16_t min[TREND_MAX_CHANNELS];
+  int16_t max[TREND_MAX_CHANNELS];
+  int16_t mean[TREND_MAX_CHANNELS];
+};
+
+// draws one chart column, counted from the left, from a bucket
+typedef void (*TrendColumn)(int column, const TrendBucket &b);
+
+class TrendPyramid {
+  public:
+    TrendPyramid();
+    // list[] holds the channel numbers handed to toPx, values are read
+    // from vals[list[k]]; at most TREND_MAX_CHANNELS are kept
+    void setChannels(const byte *list, byte n, int (*toPx)(byte channel, float val));
+    // opens or makes TREND_FILE and starts a new run; false without it
+    bool begin();
+    // a reading of every channel, indexed by channel number
+    void add(const float *vals);
+    // ends the current period, every TREND_PERIOD_MS
+    void close();
+    uint32_t periods() const { return _periods; }
+    // draws the run's complete columns of perColumn periods each, up to
+    // columns of them, and returns how many there are
+    uint16_t render(uint16_t perColumn, uint16_t columns, TrendColumn draw);
+  private:
+    void flush();
+    bool store(cache_t *pc, byte level, uint32_t index, byte count);
+    void pack(const TrendBucket &b, byte slot);
+    void unpack(const int16_t *from, TrendBucket &b) const;
+    void merge(TrendBucket &into, const TrendBucket &from);
+
+    SdFile _file;
+    uint32_t _firstBlock;
+    const byte *_list;
+    byte _n;
+    int (*_toPx)(byte channel, float val);
+    uint32_t _periods;
+    // buckets to a block, 1 << _blockLevels
+    byte _perBlock;
+    byte _blockLevels;
+
+    // the period being filled
+    int16_t _min[TREND_MAX_CHANNELS];
+    int16_t _max[TREND_MAX_CHANNELS];
+    int32_t _sum[TREND_MAX_CHANNELS];
+    uint16_t _count[TREND_MAX_CHANNELS];
+    // level 0's buckets since the last full block, packed as on the card
+    int16_t _block[TREND_BLOCK_BYTES / 2];
+    // the first of each pair above the block's own levels; the top level
+    // has no pairs
+    TrendBucket _pending[TREND_LEVELS - 1 - TREND_BLOCK_LEVELS];
+};
+
+#endif
@@ -28,14 +28,80 @@
 ****************************************************************************************/
 #include <SPI.h>
 #include <Wire.h>
-#include <SD.h>
+#include <SdFat.h>
 #include "Adafruit_GFX.h"
 #include "Adafruit_RA8875.h"
 #include "FT5x06.h"
 #include "RTClib.h"
-#include "Adafruit_MAX31855.h"
+#include "MAX31855Pair.h"
+#include "AdcSampler.h"
+#include "Channels.h"
+#include "ChannelList.h"
+#include "ChannelPipeline.h"
+#include "LogIndex.h"
+#include "LogWriter.h"
+#include "LogJournal.h"
+#include "PackedLog.h"
+#include "HistoryBrowser.h"
+#include "LabelCache.h"
+#include "DiagScreen.h"
+#include "LoopProfiler.h"
+#include "AcqTrace.h"
+#include "ScopeCapture.h"
+#include "AlarmList.h"
+#include "FrameStream.h"
+#include "SharedBuffer.h"
+// DIAG_DEBUG adds per-touch and per-sample lines; they cost the same
+// either way, see DiagLog.h
+#define DIAG_LEVEL DIAG_LEVEL_INFO
+#include "DiagLog.h"
+#include "FileServer.h"
+#include "TrendPyramid.h"
 //#include "TFTButton.h"
 
+// FUNCTIONS
+// declared here instead of by the IDE, so host/sim compiles this same list
+// and the label painters can go in label_sheets[] before their definitions
+void dateTime(uint16_t* date, uint16_t* time);
+void setup();
+void loop();
+void startRTC();
+bool openLog();
+void startSD();
+void initChannels();
+void readChannels();
+void aggregateChannels();
+void resetAggregates();
+void writeLogHeader(Print &f);
+void updateStatus(char update_cond[]);
+bool withinBounds(int x, int y, int button[4]);
+int channelToPx(byte i, float val);
+void updateGraph(float vals[], int plot_type);
+void plotPixel(int x, int y, uint16_t colour);
+void drawTrendColumn(int column, const TrendBucket &b);
+void switchTimescale();
+void startBrowse();
+void stopBrowse();
+void startDiag();
+void stopDiag();
+void startScope();
+void stopScope();
+void endScope();
+void updateScope();
+void drawScope(uint16_t frame_us);
+void logAlarms();
+void drawAlarmStatus();
+void handleSerial();
+void drawButton(int button[4], char strarr[]);
+void initGUI();
+void paintTop();
+void paintInit();
+void updateInitStatus();
+void makeGraph();
+void paintAxisLeft();
+void paintAxisRight();
+void paintAxisBottom();
+
 // set up variables TFT utility library functions:
 #define RA8875_CS         7   // RA8875 chip select for ISP communication
 #define CTP_INT           2    // touch data ready for read from FT5x06 touch controller
@@ -50,10 +116,16 @@ FT5x06 cmt = FT5x06(CTP_INT);
 // set up variables using the RTC utility library functions:
 RTC_DS1307 RTC;
 
-// set up variables using the SD utility library functions:
-Sd2Card card;
-SdVolume volume;
-SdFile root;
+// the serial monitor and host/logget; 500 kbaud is exact at 16 MHz, so
+// file transfers run at the full 50 kB/s
+#define SERIAL_BAUD 500000
+
+// set up variables using the SdFat library functions (SdFat from
+// deprecated/AdafruitLogger, built with MEGA_SOFT_SPI for the logger shield):
+SdFat sd;
+// serial 'f' requests list and send the card's files, for host/logget;
+// see FileServer.h
+FileServer fileServer(sd);
 
 // change this to match your SD shield or module;
 // Arduino Ethernet shield: pin 4
@@ -61,22 +133,86 @@ SdFile root;
 // Sparkfun SD shield: pin 8
 const int chipSelect = 10;
 
-// Thermocouple1 digital IO pins.
-#define thermo0DO   14
-#define thermo0CS   15
-#define thermo0CLK  16
-#define thermo1DO   17
-#define thermo1CS   18
-#define thermo1CLK  19
-Adafruit_MAX31855 thermocouple0(thermo0CLK, thermo0CS, thermo0DO);
-Adafruit_MAX31855 thermocouple1(thermo1CLK, thermo1CS, thermo1DO);
+// Thermocouple digital IO pins, all on PORTC; not 14-19, where the live
+// stream's USART1 (TX1 pin 18, RX1 pin 19) would take two of them.
+#define thermo0DO   30
+#define thermo0CS   31
+#define thermo0CLK  32
+#define thermo1DO   33
+#define thermo1CS   34
+#define thermo1CLK  35
+// both chips are clocked together, one 32-bit frame each per read
+MAX31855Pair thermocouples(thermo0CLK, thermo0CS, thermo0DO,
+                           thermo1CLK, thermo1CS, thermo1DO);
+MAX31855Reading tc_vals[CH_THERMOCOUPLES];
 
 // ACQUISITION RATE (LOGGING INTERVAL)
 // Our logging interval in milliseconds, and timing/logging info
 int LOG_INTERVAL = 500; // minimum is 250 milliseconds
 
+// OVERSAMPLING
+// Analog channels are sampled continuously from the ADC interrupt (about
+// 9.6 kHz shared round-robin between them) and decimated by 4^OVERSAMPLE_LOG4;
+// values stay in 0-1023 units but carry OVERSAMPLE_LOG4 extra bits.
+// Filter is DECIMATE_BOXCAR or DECIMATE_CIC.
+#define OVERSAMPLE_LOG4   3
+#define OVERSAMPLE_FILTER DECIMATE_BOXCAR
+
+// CHANNELS
+// The channel list itself is in ChannelList.h. The sample path (read, scale,
+// aggregate, format) is compiled from it by AcqPipeline; the GUI walks the
+// runtime channels[] table built from the same list.
+ACQ_CHANNEL_LIST(CHANNEL_TRAITS)
+typedef ChannelPipeline<0, 0 ACQ_CHANNEL_LIST(CHANNEL_TYPE)> AcqPipeline;
+Channel channels[] = { ACQ_CHANNEL_LIST(CHANNEL_ENTRY) };
+enum { ACQ_CHANNEL_LIST(CHANNEL_INDEX) };
+#define NUM_CHANNELS AcqPipeline::channels
+static_assert(NUM_CHANNELS <= MAX_CHANNELS, "raise MAX_CHANNELS in Channels.h");
+static_assert(AcqPipeline::adcChannels <= ADC_SAMPLER_MAX_CHANNELS, "more analog channels than AdcSampler.h has slots");
+
+// filled by readChannels() through acq_trace
+float adc_vals[ADC_SAMPLER_MAX_CHANNELS];
+
+struct AcqSources {
+  float analog(uint8_t slot) {
+    return adc_vals[slot];
+  }
+  float thermocouple(uint8_t index) {
+    return tc_vals[index].thermocouple;
+  }
+  float internal(uint8_t index) {
+    return tc_vals[index].internal;
+  }
+};
+AcqSources acq_sources;
+
+// built by initChannels(): indices of channels that are logged or plotted
+byte active_channels[MAX_CHANNELS];
+byte n_active_channels = 0;
+// and of logged channels, in log column order
+byte logged_channels[MAX_CHANNELS];
+byte n_logged_channels = 0;
+// and of plotted channels, in legend order
+byte plotted_channels[MAX_CHANNELS];
+byte n_plotted_channels = 0;
+// and of active analog channels, by AdcSampler slot
+byte adc_channels[ADC_SAMPLER_MAX_CHANNELS];
+float d_vals[MAX_CHANNELS];
+
+// ALARMS
+// The rules are in AlarmList.h. Analog rules are tested in the ADC interrupt
+// on every decimated output, the others on every readChannels(). Edges go
+// to Serial and to YYMMDD-x.EVT next to the log, and the first active alarm
+// shows under the status line. Serial 'a' dumps the worst-case evaluation
+// time and each rule's state, 'A' clears the timing.
+const AlarmRule alarm_rules[] = { ACQ_ALARM_LIST(ALARM_ENTRY) };
+#define NUM_ALARMS (sizeof(alarm_rules) / sizeof(alarm_rules[0]))
+static_assert(NUM_ALARMS <= ALARM_MAX_RULES, "raise ALARM_MAX_RULES in AlarmEngine.h");
+AlarmEngine alarms;
+
 unsigned long log_timer;
 unsigned long plot_timer;
+unsigned long trend_timer;
 unsigned long init_timer;
 
 // BUTTON INITIALIZATION
@@ -94,6 +230,10 @@ int b_incr_acq[4] = {400, 520, 380, 430};
 int b_plot_mean[4] = {130, 230, 120, 170};
 int b_plot_mxmn[4] = {130, 230, 200, 250};
 int b_plot_inst[4] = {130, 230, 280, 330};
+int b_browse[4] = {240, 300, 20, 70};
+int b_diag[4] = {340, 430, 0, 30}; // the "arduinacq" title, not drawn as a button
+int b_scope[4] = {440, 495, 20, 70};
+int b_timescale[4] = {100, 750, 450, 480}; // the hours under the chart, while logging
 
 // BUTTON STATUS
 bool b_start_logging_status = false;
@@ -111,14 +251,117 @@ int b_plottype;
 
 // OUR DATAFILE NAME
 char filename[13];
-File dataFile;
+
+// JOURNALED LOG
+// the log stays open while logging; a header every LOG_JOURNAL_CHECKPOINT
+// blocks bounds what a power loss can cost, and setup() repairs any log left
+// open. A full log is closed and logging moves on to the next letter.
+#define LOG_JOURNAL_SIZE       16777216UL // preallocated, a bit over a day of rows
+#define LOG_JOURNAL_CHECKPOINT 16         // blocks, about 8 KB
+LogJournal journal;
+// set when no log could be opened: logging stops and says so rather than
+// searching the card again every row; cleared by the next Start
+bool log_error = false;
+
+// PACKED LOG
+// with LOG_PACKED set rows are delta-coded into YYMMDD-x.APK (PackedLog.h),
+// a fraction of the card writes of the CSV; host/logstat reads either. Build
+// with -DLOG_PACKED=0 to log the plain YYMMDD-x.CSV instead
+#ifndef LOG_PACKED
+#define LOG_PACKED 1
+#endif
+#if LOG_PACKED
+#define LOG_EXT     PACKED_LOG_EXT
+#define LOG_ROW_MAX 512 // room kept for one more row, whatever block it starts
+#else
+#define LOG_EXT     ".CSV"
+#define LOG_ROW_MAX 256
+#endif
+PackedWriter packed_log;
+
+// SIDECAR INDEX
+// one summary record (CSV offset, first timestamp, per-channel min/max) every
+// LOG_INDEX_SPAN rows, in YYMMDD-x.IDX next to the log
+#define LOG_INDEX_SPAN 120
+LogIndex log_index;
+
+// FIXED LABELS
+// painted once into the display's second layer and copied onto the screen
+// from there (LabelCache.h); a sheet whose contents change is invalidated.
+// Sheets must not overlap: the chart's axis lines, in the gaps, are drawn
+// directly.
+enum { SHEET_TOP, SHEET_INIT, SHEET_AXIS_LEFT, SHEET_AXIS_RIGHT, SHEET_AXIS_BOTTOM, NUM_SHEETS };
+const LabelSheet label_sheets[NUM_SHEETS] = {
+  {0, 0, 800, 80, paintTop},            // title and the buttons above the chart
+  {100, 80, 650, 370, paintInit},       // init screen, over the chart
+  {0, 80, 100, 400, paintAxisLeft},     // mV scale
+  {750, 80, 50, 400, paintAxisRight},   // deg C scale, last hour
+  {100, 451, 650, 29, paintAxisBottom}, // hours
+};
+LabelCache labels(tft);
+
+// HISTORY BROWSER
+// "browse" steps back through earlier logs; swipe to pan, pinch to zoom,
+// "stop log" returns to the init screen
+HistoryBrowser browser(tft, labels);
+bool browse_mode = false;
+
+// DIAGNOSTICS
+// tap the title while stopped, again for the next page; "stop log" returns.
+// Serial 'l' dumps the SD latency table as CSV, 'L' clears it; 'p' dumps
+// the loop profile, 'P' clears it
+DiagScreen diag(tft);
+bool diag_mode = false;
+byte diag_page = DIAG_PAGE_SD;
+
+// SCOPE MODE
+// "scope" (while stopped) keeps the raw ADC samples in a ring and arms a
+// trigger; SCOPE_PRE_FRAMES before it and SCOPE_POST_FRAMES from it on are
+// saved to DDHHMMSS.CAP and drawn on the chart. "scope" again re-arms,
+// "stop log" returns. Serial 't' fires the trigger by hand.
+#define SCOPE_PRE_FRAMES  32
+#define SCOPE_POST_FRAMES 96
+#define SCOPE_TRIGGER     SCOPE_TRIG_RISING
+#define SCOPE_SLOT        0   // analog slot, or thermocouple for the TC modes
+#define SCOPE_LEVEL       512 // raw counts (2.5 V), or degrees C for the TC modes
+#define SCOPE_TC_POLL     100 // ms, a MAX31855 conversion
+ScopeCapture scope;
+bool scope_mode = false;
+unsigned long scope_timer;
+
+// LIVE STREAM
+// serial 's' streams every raw ADC conversion out TX1 (pin 18, which is why
+// the thermocouples are on 30-35) in COBS
+// frames, a frame per round of the analog slots (see FrameStream.h), for a
+// host to capture at full rate without the card; 'S' stops it. Serial
+// itself stays on USART0 for the commands and text below.
+#define STREAM_BAUD 2000000
+
+// INPUT TRACE
+// touch, RTC and sampled values all pass through acq_trace; with ACQ_TRACE
+// set they are also recorded to YYMMDD-x.TRC next to the first log of the
+// run, for replay by the host simulator in host/sim. Capture writes to the
+// card between log rows, so it is a build for chasing a field problem, not
+// the default; the trace is synced with each journal checkpoint
+#ifndef ACQ_TRACE
+#define ACQ_TRACE 0
+#endif
+AcqTrace acq_trace;
 
 // FOR makeGraph AND CUMULATIVE MOVING AVERAGE (CMA)
 int graphCursorX = 101; // change each time we write a new pixel of data.
-float ug_cma[6] = {0, 0, 0, 0, 0, 0}; // CMA for mean plottype
-long number_points_recorded = 0L; // for calculating CMA
-float ug_mx[6] = {0, 0, 0, 0, 0, 0}; // mxmn maximum
-float ug_mn[6] = {0, 0, 0, 0, 0, 0}; // mxmn minimum
+float ug_cma[MAX_CHANNELS]; // CMA for mean plottype
+long number_points_recorded = 0L; // rows folded into the column
+uint16_t ug_points[MAX_CHANNELS]; // readings in the CMA or mxmn, NAN ones skipped
+float ug_mx[MAX_CHANNELS]; // mxmn maximum
+float ug_mn[MAX_CHANNELS]; // mxmn minimum
+
+// TIMESCALE
+// while logging, tapping the hours under the chart steps through
+// trend_hours[] and redraws the run so far from the pyramid (TrendPyramid.h)
+const int trend_hours[] = {1, 12, 24};
+#define NUM_TREND_HOURS (sizeof(trend_hours) / sizeof(trend_hours[0]))
+TrendPyramid trend;
 
 // GUI
 int gui_temp_scale[6] = {0, 20, 40, 60, 80, 100};
@@ -126,14 +369,14 @@ float gui_time_scale[6] = {0, 2.4, 4.8, 7.2, 9.6, 12};
 
 // FOR FILE TIMESTAMPING
 void dateTime(uint16_t* date, uint16_t* time) {
-  DateTime now = RTC.now();
+  DateTime now = acq_trace.now(RTC);
   *date = FAT_DATE(now.year(), now.month(), now.day());
   *time = FAT_TIME(now.hour(), now.minute(), now.second());
 }
 
 void setup() {
   // Open serial communications and wait for port to open:
-  Serial.begin(9600);
+  Serial.begin(SERIAL_BAUD);
   while (!Serial) {
     ; // wait for serial port to connect. Needed for Leonardo only
   }
@@ -151,6 +394,7 @@ void setup() {
   tft.GPIOX(true);                              // Enable TFT - display enable tied to GPIOX
   tft.PWM1config(true, RA8875_PWM_CLK_DIV1024); // PWM output for backlight
   tft.PWM1out(255);
+  labels.begin(label_sheets, NUM_SHEETS); // 8 bits a pixel from here on
 
   // SCREEN STARTUP
   tft.fillScreen(RA8875_BLACK);
@@ -160,50 +404,48 @@ void setup() {
   tft.fillScreen(RA8875_BLACK);
 
   startRTC();
+  SdLatency::begin(); // before startSD() so card init is timed too
   startSD();
 
   // clear message area
   tft.graphicsMode();
   tft.fillRect(500, 20, 300, 20, RA8875_BLACK);
 
-  // Open up the file we're going to log to! Use current date and a-z to differentiate each startup!
-
   SdFile::dateTimeCallback(dateTime);
-  DateTime now = RTC.now();
-  Serial.println("synced time");
-  char yr[5];
-  sprintf(yr, "%04u", now.year());
-  sprintf(filename, "%c%c%02u%02u-A.CSV", yr[2], yr[3], now.month(), now.day());
-
-  // if there is already a file with a certain letter appended, move to next letter.
-  for (uint8_t i = 0; i < 25; i++) {
-    char letters[26] = "abcdefghijklmnopqrstuvwxyz";
-    filename[7] = letters[i];
-    if (! SD.exists(filename)) {
-      dataFile = SD.open(filename, FILE_WRITE);
-      break;
-    }
-  }
-
-  Serial.println(filename);
-  dataFile = SD.open(filename, FILE_WRITE);
-  if (! dataFile) {
-    Serial.println("error opening our .csv");
+  uint8_t repaired = LogJournal::recoverAll(LOG_JOURNAL_CHECKPOINT);
+  if (repaired > 0) {
+    Serial.print("recovered logs: ");
+    Serial.println(repaired);
   }
-  dataFile.close();
 
   // DRAW GUI
   initGUI();
 
+  initChannels();
+  log_error = !openLog();
+#if ACQ_TRACE
+  char trace_name[13];
+  strcpy(trace_name, filename);
+  strcpy(strrchr(trace_name, '.'), ".TRC");
+  if (!acq_trace.begin(trace_name, AcqPipeline::adcChannels, AcqPipeline::usesThermocouples ? 2 : 0)) {
+    Serial.println("error opening the trace");
+  }
+#endif
+  browser.setChannels(channels, logged_channels, n_logged_channels, channelToPx);
+  trend.setChannels(plotted_channels, n_plotted_channels, channelToPx);
+
   // basic readout test, just print the current temp
+  thermocouples.begin();
+  thermocouples.read(tc_vals);
   Serial.print("Internal Temp 0 = ");
-  Serial.println(thermocouple0.readInternal());
+  Serial.println(tc_vals[0].internal);
   Serial.print("Internal Temp 1 = ");
-  Serial.println(thermocouple1.readInternal());
+  Serial.println(tc_vals[1].internal);
 
   // GET TIMER FOR LOG AND PLOT
   log_timer = millis();
   plot_timer = millis();
+  diagLog.flush(Serial); // openLog()'s lines
   Serial.println("Setup done.");
 
 }
@@ -215,7 +457,7 @@ byte nr_of_touches = 0;
 // status of button pushed and gui status
 bool logging_status = false;
 bool init_screen = true;
-unsigned long graph_interval = 5547L * b_graphlimits[BTIME]; // ms per px per hour for timescale (to adjust by initscr)
+unsigned long graph_interval = TREND_PERIOD_MS * b_graphlimits[BTIME]; // ms per px per hour for timescale (to adjust by initscr)
 int init_interval = 200;
 
 void loop() {
@@ -223,20 +465,29 @@ void loop() {
   byte prev_nr_of_touches = 0;
   word coordinates[10];
   String data = "";
+  PROFILE_SCOPE(PROF_LOOP);
+  handleSerial();
+  if (fileServer.busy()) {
+    fileServer.growing(journal.isOpen() ? filename : 0, journal.position());
+    fileServer.poll(Serial);
+  }
+  else {
+    diagLog.drain(Serial);
+  }
   // HANDLE TOUCH EVENTS
-  if (cmt.touched()) {
-    cmt.getRegisterInfo(registers);
+  if (acq_trace.touch(cmt, registers)) {
+    PROFILE_SCOPE(PROF_TOUCH);
     nr_of_touches = cmt.getTouchPositions(coordinates, registers);
     prev_nr_of_touches = nr_of_touches;
 
+    if (browse_mode && browser.gesture(registers[FT5206_GEST_ID])) {
+      browser.render();
+    }
+
     for (byte i = 0; i < nr_of_touches; i++) {
       word x = coordinates[i * 2];
       word y = coordinates[i * 2 + 1];
-      //DEBUG
-      Serial.println("coord x = ");
-      Serial.println(x);
-      Serial.println("coord y = ");
-      Serial.println(y);
+      DIAG_DEBUG("touch x = %, y = %", x, y);
       //tft.fillCircle(x,y,10,RA8875_WHITE);
 
       // CHECK FOR BUTTON PRESSES, LOGGING STATUS
@@ -245,11 +496,11 @@ void loop() {
       if (init_screen && ((millis() - init_timer) >= init_interval)) {
         if (withinBounds(x, y, b_incr_time)) {
           b_graphlimits[BTIME] += 1;
-          graph_interval = 5547L * b_graphlimits[BTIME]; // adjust graph_interval
+          graph_interval = TREND_PERIOD_MS * b_graphlimits[BTIME]; // adjust graph_interval
         }
         if (withinBounds(x, y, b_decr_time)) {
           b_graphlimits[BTIME] -= 1;
-          graph_interval = 5547L * b_graphlimits[BTIME]; // adjust graph_interval
+          graph_interval = TREND_PERIOD_MS * b_graphlimits[BTIME]; // adjust graph_interval
         }
         if (withinBounds(x, y, b_incr_temp_lo)) {
           b_graphlimits[BTEMPLO] += 20;
@@ -287,21 +538,65 @@ void loop() {
         for (byte i = 0; i < 6; i = i + 1) {
           gui_time_scale[i] = b_graphlimits[BTIME] / 5.0 * i;
         }
+        labels.invalidate(SHEET_AXIS_RIGHT);
+        labels.invalidate(SHEET_AXIS_BOTTOM);
 
 
 
         init_timer = millis();
       }
 
+      if (logging_status == false && withinBounds(x, y, b_browse) && ((millis() - init_timer) >= init_interval)) {
+        startBrowse();
+        init_timer = millis();
+      }
+      if (browse_mode && b_stop_logging_status == true) {
+        stopBrowse();
+      }
+      if (logging_status == false && withinBounds(x, y, b_diag) && ((millis() - init_timer) >= init_interval)) {
+        startDiag();
+        init_timer = millis();
+      }
+      if (diag_mode && b_stop_logging_status == true) {
+        stopDiag();
+      }
+      if (logging_status == false && withinBounds(x, y, b_scope) && ((millis() - init_timer) >= init_interval)) {
+        startScope();
+        init_timer = millis();
+      }
+      if (scope_mode && b_stop_logging_status == true) {
+        stopScope();
+      }
+      if (logging_status && withinBounds(x, y, b_timescale) && ((millis() - init_timer) >= init_interval)) {
+        switchTimescale();
+        init_timer = millis();
+      }
+
       if (logging_status == false && b_start_logging_status == true) {
+        if (browse_mode) {
+          browser.close();
+          browse_mode = false;
+        }
+        diag_mode = false;
+        endScope();
         logging_status = true;
+        log_error = false; // a failed log is tried again at the first row
         init_screen = false;
         makeGraph();
-        Serial.println("logging status true");//DEBUG
+        if (!trend.begin()) {
+          DIAG_ERROR("error opening " TREND_FILE);
+        }
+        resetAggregates();
+        plot_timer = millis();
+        trend_timer = plot_timer;
+        DIAG_DEBUG("logging status true");
       }
       else if (logging_status == true && b_stop_logging_status == true) {
         logging_status = false;
-        Serial.println("logging status false");//DEBUG
+        log_index.flush();
+        journal.checkpoint();
+        acq_trace.flush();
+        DIAG_DEBUG("logging status false");
       }
     }
 
@@ -310,145 +605,107 @@ void loop() {
     memcpy(transfer_coords, coordinates, 20);
   }
 
-  File dataFile = SD.open(filename, FILE_WRITE);
   if (init_screen) {
-    tft.textMode();
-    tft.textSetCursor(350, 10);
-    tft.textEnlarge(0);
-    tft.textColor(RA8875_BLACK, RA8875_WHITE);
-    tft.textWrite("arduinacq");
-    tft.textSetCursor(540, 100);
-    tft.textWrite("CURRENT PARAMETERS");
-    tft.textSetCursor(130, 100);
-    tft.textWrite("PLOT TYPE");
-    tft.textSetCursor(270, 100);
-    tft.textWrite("ADJUST PLOT DISPLAY PARAMETERS");
-    tft.textSetCursor(270, 360);
-    tft.textWrite("ADJUST DATA ACQUISITION RATE");
-    tft.textSetCursor(540, 250);
-    tft.textWrite("HOW TO INITIALIZE");
-    tft.textColor(RA8875_WHITE, RA8875_BLACK);
-    tft.textSetCursor(540, 270);
-    tft.print("Adjust plot display to");
-    tft.textSetCursor(540, 290);
-    tft.print("change limits of graph."); 
-    tft.textSetCursor(540, 310);
-    tft.print("Mean averages points each");
-    tft.textSetCursor(540, 330);
-    tft.print("interval. Inst shows data");
-    tft.textSetCursor(540, 350);
-    tft.print("at plot time. Minmax plots");
-    tft.textSetCursor(540, 370);
-    tft.print("2. Acquire rate affects");
-    tft.textSetCursor(540, 390);
-    tft.print("data points per second");
-    tft.textSetCursor(540, 410);
-    tft.print("written to disk.");
-    tft.textSetCursor(540, 430);
-    tft.textColor(RA8875_BLACK, RA8875_WHITE);
-    tft.print("Tap 'Start log' to begin!");
-    tft.textColor(RA8875_WHITE, RA8875_BLACK);
-    updateInitStatus();
+    PROFILE_SCOPE(PROF_INIT_SCREEN);
+    updateInitStatus(); // the rest is the SHEET_INIT copy initGUI() put up
   }
   unsigned long timenow;
   if (logging_status) {
     updateStatus("Logging running.        ");
     timenow = millis();
     if ((timenow - log_timer) >= LOG_INTERVAL) {
-      DateTime now = RTC.now();
-      float d_vals[6] = {analogRead(A0), analogRead(A1), analogRead(A2), analogRead(A3),
-                         thermocouple0.readInternal(), thermocouple1.readInternal()
-                        };
-      Serial.println("attempting to write to log"); //DEBUG
-      dataFile.print(now.year(), DEC);
-      dataFile.print(now.month(), DEC);
-      dataFile.print(now.day(), DEC);
-      dataFile.print("\t");
-      dataFile.print(now.hour(), DEC);
-      dataFile.print(':');
-      dataFile.print(now.minute(), DEC);
-      dataFile.print(':');
-      dataFile.print(now.second(), DEC);
-      dataFile.print("\t");
-      dataFile.print(d_vals[0] * 4.883); // conversion from 0-1024 value to mV
-      dataFile.print("\t");
-      dataFile.print(d_vals[1] * 4.883);
-      dataFile.print("\t");
-      dataFile.print(d_vals[2] * 4.883);
-      dataFile.print("\t");
-      dataFile.print(d_vals[3] * 4.883);
-      dataFile.print("\t");
-      dataFile.print(d_vals[4]);
-      dataFile.print("\t");
-      dataFile.println(d_vals[5]);
-
-      // plot data update
-      if (b_plottype == BPLOTMEAN) {
-        number_points_recorded = number_points_recorded + 1;
-        Serial.print("New number_points_recorded: ");
-        Serial.println(number_points_recorded); // DEBUG
-        for (byte i = 0; i < 6; i = i + 1) {
-          ug_cma[i] = ((number_points_recorded - 1) * ug_cma[i] + d_vals[i]) / number_points_recorded;
-          Serial.print(ug_cma[i]); // debug
-        }
+      PROFILE_SCOPE(PROF_ROW);
+      DateTime now = acq_trace.now(RTC);
+      {
+        PROFILE_SCOPE(PROF_SAMPLE);
+        readChannels();
       }
-      if (b_plottype == BPLOTMXMN) {
-        if (ug_mx[0] == 0 && ug_mx[1] == 0 && ug_mx[2] == 0 && ug_mx[3] == 0 && ug_mx[4] == 0 && ug_mx[5] == 0) {
-          for (byte i = 0; i < 6; i = i + 1) {
-            ug_mx[i] = d_vals[i];
-            ug_mn[i] = d_vals[i];
-          }
+      float row[MAX_CHANNELS];
+      for (byte k = 0; k < n_logged_channels; k = k + 1) {
+        row[k] = d_vals[logged_channels[k]];
+      }
+      if (journal.full(LOG_ROW_MAX)) {
+        PROFILE_SCOPE(PROF_LOG_OPEN);
+        journal.close();
+        log_index.flush();
+        if (!openLog()) {
+          log_error = true;
+          logging_status = false;
+          acq_trace.flush();
+          DIAG_DEBUG("logging status false");
         }
-        else {
-          for (byte i = 0; i < 6; i = i + 1) {
-            if (ug_mx[i] < d_vals[i]) {
-              ug_mx[i] = d_vals[i];
-            }
-            if (ug_mn[i] > d_vals[i]) {
-              ug_mn[i] = d_vals[i];
-            }
-          }
+      }
+      if (journal.isOpen()) {
+        PROFILE_SCOPE(PROF_LOG_WRITE);
+        log_index.add(journal.position(), now.unixtime(), row);
+        DIAG_DEBUG("attempting to write to log");
+#if LOG_PACKED
+        packed_log.add(journal.file(), now.unixtime(), row);
+#else
+        LogWriter out(journal.file()); // formats in place in the SD cache block
+        out.print(now.year(), DEC);
+        out.print(now.month(), DEC);
+        out.print(now.day(), DEC);
+        out.print("\t");
+        out.print(now.hour(), DEC);
+        out.print(':');
+        out.print(now.minute(), DEC);
+        out.print(':');
+        out.print(now.second(), DEC);
+        AcqPipeline::format(out, d_vals); // prints "nan" on a thermocouple fault
+        out.println();
+        out.commit();
+#endif
+        uint32_t seq = journal.seq();
+        journal.update();
+        if (ACQ_TRACE && journal.seq() != seq) {
+          acq_trace.flush(); // and its size, so a power cut leaves a whole trace
         }
       }
 
+      // plot data update
+      {
+        PROFILE_SCOPE(PROF_AGGREGATE);
+        aggregateChannels();
+      }
+
       log_timer = millis();
     }
+    if ((timenow - trend_timer) >= TREND_PERIOD_MS) {
+      PROFILE_SCOPE(PROF_TREND);
+      trend.close();
+      trend_timer = trend_timer + TREND_PERIOD_MS;
+    }
     if ((timenow - plot_timer) >= graph_interval) {
+      PROFILE_SCOPE(PROF_PLOT);
       if (b_plottype == BPLOTINST) {
-        float d_vals[6] = {analogRead(A0), analogRead(A1), analogRead(A2), analogRead(A3),
-                           thermocouple0.readInternal(), thermocouple1.readInternal()
-                          };
-        updateGraph(d_vals[0], d_vals[1], d_vals[2], d_vals[3], d_vals[4], d_vals[5], b_plottype);
+        readChannels();
+        updateGraph(d_vals, b_plottype);
       }
-
       if (b_plottype == BPLOTMEAN) {
-        updateGraph(ug_cma[0], ug_cma[1], ug_cma[2], ug_cma[3], ug_cma[4], ug_cma[5], b_plottype);
-        number_points_recorded = 0L;
-        // reset CMA
-        for (byte i = 0; i < 6; i = i + 1) {
-          ug_cma[i] = 0;
-        }
+        updateGraph(ug_cma, b_plottype);
       }
       if (b_plottype == BPLOTMXMN) {
-        updateGraph(ug_mx[0], ug_mx[1], ug_mx[2], ug_mx[3], ug_mx[4], ug_mx[5], b_plottype);
-        // reset mxmn
-        for (byte i = 0; i < 6; i = i + 1) {
-          ug_mx[i] = 0;
-          ug_mn[i] = 0;
-        }
+        updateGraph(ug_mx, b_plottype);
       }
+      resetAggregates();
 
       plot_timer = millis();
     }
-
-    dataFile.close();
+  }
+  else if (scope_mode) {
+    updateScope();
+  }
+  else if (log_error) {
+    tft.graphicsMode();
+    updateStatus("Log error.              ");
   }
   else {
     tft.graphicsMode();
     updateStatus("Logging stopped.        ");
-    dataFile.close();
   }
-
+  logAlarms();
+  acq_trace.update();
 }
 
 // RTC AND SD INITIALIZATION FUNCTIONS
@@ -464,6 +721,45 @@ void startRTC() {
   }
 }
 
+bool openLog() { // next free YYMMDD-x.CSV (or .APK) for today, journaled, with its column header
+  // Use current date and a-z to differentiate each startup!
+  DateTime now = acq_trace.now(RTC);
+  DIAG_INFO("synced time");
+  char yr[5];
+  sprintf(yr, "%04u", now.year());
+  sprintf(filename, "%c%c%02u%02u-A" LOG_EXT, yr[2], yr[3], now.month(), now.day());
+
+  // if there is already a file with a certain letter appended, move to next letter.
+  for (uint8_t i = 0; i < 25; i++) {
+    char letters[] = "abcdefghijklmnopqrstuvwxyz";
+    filename[7] = letters[i];
+    if (! sd.exists(filename)) {
+      break;
+    }
+  }
+
+  DIAG_INFO("log %", filename);
+  if (! journal.begin(filename, LOG_JOURNAL_SIZE, LOG_JOURNAL_CHECKPOINT)) {
+    DIAG_ERROR("error opening our .csv");
+    return false;
+  }
+  LogWriter out(journal.file());
+  writeLogHeader(out);
+  out.commit();
+#if LOG_PACKED
+  // packed blocks start on a block boundary: pad with a line of spaces
+  for (uint16_t i = journal.position() & 0x1FF; i < 510; i = i + 1) {
+    out.write(' ');
+  }
+  out.println();
+  out.commit();
+  packed_log.begin(n_logged_channels);
+#endif
+  journal.checkpoint();
+  log_index.begin(filename, LOG_INDEX_SPAN, n_logged_channels);
+  return true;
+}
+
 void startSD() {
   Serial.print("Initializing SD card...");
   // make sure that the default chip select pin is set to
@@ -471,7 +767,7 @@ void startSD() {
   pinMode(SS, OUTPUT);
 
   // see if the card is present and can be initialized:
-  if (!SD.begin(10, 11, 12, 13)) { // pins connected from SD to Arduino
+  if (!sd.begin(chipSelect, SPI_HALF_SPEED)) { // soft SPI on pins 10-13, see SdFatConfig.h
     Serial.println("Card failed, or not present");
     updateStatus("No SD card. Insert and reboot.");
     // don't do anything more:
@@ -483,8 +779,84 @@ void startSD() {
   }
 }
 
+// CHANNEL FUNCTIONS
+void initChannels() {
+  n_active_channels = 0;
+  n_logged_channels = 0;
+  n_plotted_channels = 0;
+  for (byte i = 0; i < NUM_CHANNELS; i = i + 1) {
+    if (channels[i].logged || channels[i].axis != CH_AXIS_NONE) {
+      active_channels[n_active_channels++] = i;
+    }
+    if (channels[i].axis != CH_AXIS_NONE) {
+      plotted_channels[n_plotted_channels++] = i;
+    }
+    if (channels[i].logged) {
+      logged_channels[n_logged_channels++] = i;
+    }
+  }
+  byte slot = 0;
+  for (byte i = 0; i < NUM_CHANNELS; i = i + 1) {
+    if ((channels[i].logged || channels[i].axis != CH_AXIS_NONE) && channels[i].source == CH_SRC_ANALOG) {
+      adc_channels[slot++] = i;
+    }
+  }
+  uint8_t adc_pins[AcqPipeline::adcChannels + 1];
+  AcqPipeline::adcPins(adc_pins);
+  adcSampler.begin(adc_pins, AcqPipeline::adcChannels, OVERSAMPLE_LOG4, OVERSAMPLE_FILTER);
+  // a decimated output every 4^OVERSAMPLE_LOG4 rounds of the analog slots
+  uint32_t output_us = (ADC_SAMPLER_CONVERSION_US * AcqPipeline::adcChannels) << (2 * OVERSAMPLE_LOG4);
+  alarms.begin(alarm_rules, NUM_ALARMS, channels, adc_channels, AcqPipeline::adcChannels,
+               adcSampler.bits(), output_us);
+  adcSampler.attach(&alarms);
+}
+
+void readChannels() { // fills d_vals[] for every active channel, in engineering units
+  acq_trace.sample(AcqPipeline::usesThermocouples ? &thermocouples : 0, tc_vals,
+                   adc_vals, AcqPipeline::adcChannels);
+  AcqPipeline::read(acq_sources, d_vals);
+  alarms.sample(d_vals, millis());
+}
+
+void aggregateChannels() { // folds d_vals[] into the CMA or mxmn of plotted channels, and the pyramid
+  number_points_recorded = number_points_recorded + 1;
+  trend.add(d_vals);
+  if (b_plottype == BPLOTMEAN) {
+    DIAG_DEBUG("number_points_recorded = %", number_points_recorded);
+    AcqPipeline::aggregateMean(d_vals, ug_cma, ug_points);
+  }
+  if (b_plottype == BPLOTMXMN) {
+    AcqPipeline::aggregateMinMax(d_vals, ug_mx, ug_mn, ug_points);
+  }
+}
+
+void resetAggregates() { // starts the next column's CMA and mxmn; NAN until a reading comes in
+  number_points_recorded = 0L;
+  for (byte i = 0; i < MAX_CHANNELS; i = i + 1) {
+    ug_points[i] = 0;
+    ug_cma[i] = NAN;
+    ug_mx[i] = NAN;
+    ug_mn[i] = NAN;
+  }
+}
+
+void writeLogHeader(Print &f) { // column names, one per logged channel
+  f.print("date\ttime");
+  for (byte i = 0; i < NUM_CHANNELS; i = i + 1) {
+    if (channels[i].logged) {
+      f.print("\t");
+      f.print(channels[i].label);
+      f.print("[");
+      f.print(channels[i].units);
+      f.print("]");
+    }
+  }
+  f.println();
+}
+
 // GUI FUNCTIONS
 void updateStatus(char update_cond[]) {
+  PROFILE_SCOPE(PROF_STATUS);
   tft.textMode();
   tft.textSetCursor(500, 20);
   tft.textColor(RA8875_WHITE, RA8875_BLACK);
@@ -495,33 +867,387 @@ bool withinBounds(int x, int y, int button[4]) { // determines if a touch is wit
   return (x > button[0] && x < button[1] && y > button[2] && y < button[3]);
 }
 
-void updateGraph(float dat_a0, float dat_a1, float dat_a2, float dat_a3, float dat_t0, float dat_t1, int plot_type) {
+int channelToPx(byte i, float val) {
+  // 450 - is because screen is upper-left 0,0 indexed; + 0.5 is for rounding;
+  // * 0.07 is pixels per mV; temperature scaling is temp_to_px;
+  if (channels[i].axis == CH_AXIS_MV) {
+    return int(450 - val * 0.07 + 0.5);
+  }
+  float temp_to_px = 350.0 / (b_graphlimits[BTEMPHI] - b_graphlimits[BTEMPLO]);
+  return int(450 - (val - b_graphlimits[BTEMPLO]) * temp_to_px + 0.5);
+}
+
+void updateGraph(float vals[], int plot_type) {
   if (graphCursorX != 750) {
+    labels.dataBegin();
     tft.graphicsMode();
-    // 450 - is because screen is upper-left 0,0 indexed;
-    // * 4.883 is mV per analogRead unit; temperature scaling is temp_to_px;
-    // * 0.07 is pixels per mV; + 0.5 is for rounding;
-    float temp_neg_offset_from_zero = 0 - b_graphlimits[BTEMPLO];
-    float temp_to_px = 350 / (b_graphlimits[BTEMPHI] - b_graphlimits[BTEMPLO]);
-    tft.drawPixel(graphCursorX, int(450 - dat_a0 * 4.883 * 0.07 + 0.5), RA8875_WHITE);
-    tft.drawPixel(graphCursorX, int(450 - dat_a1 * 4.883 * 0.07 + 0.5), RA8875_YELLOW);
-    tft.drawPixel(graphCursorX, int(450 - dat_a2 * 4.883 * 0.07 + 0.5), RA8875_GREEN);
-    tft.drawPixel(graphCursorX, int(450 - dat_a3 * 4.883 * 0.07 + 0.5), RA8875_CYAN);
-    tft.drawPixel(graphCursorX, int(450 - (dat_t0 + temp_neg_offset_from_zero) * temp_to_px + 0.5), RA8875_RED);
-    tft.drawPixel(graphCursorX, int(450 - (dat_t1 + temp_neg_offset_from_zero) * temp_to_px + 0.5), RA8875_MAGENTA);
-    Serial.println(450 - (ug_mn[4] + temp_neg_offset_from_zero) * temp_to_px + 0.5);
-    if (plot_type == BPLOTMXMN) {
-      tft.drawPixel(graphCursorX, int(450 - ug_mn[0] * 4.883 * 0.07 + 0.5), RA8875_WHITE);
-      tft.drawPixel(graphCursorX, int(450 - ug_mn[1] * 4.883 * 0.07 + 0.5), RA8875_YELLOW);
-      tft.drawPixel(graphCursorX, int(450 - ug_mn[2] * 4.883 * 0.07 + 0.5), RA8875_GREEN);
-      tft.drawPixel(graphCursorX, int(450 - ug_mn[3] * 4.883 * 0.07 + 0.5), RA8875_CYAN);
-      tft.drawPixel(graphCursorX, int(450 - (ug_mn[4] + temp_neg_offset_from_zero) * temp_to_px + 0.5), RA8875_RED);
-      tft.drawPixel(graphCursorX, int(450 - (ug_mn[5] + temp_neg_offset_from_zero) * temp_to_px + 0.5), RA8875_MAGENTA);
+    for (byte k = 0; k < n_active_channels; k = k + 1) {
+      byte i = active_channels[k];
+      if (channels[i].axis == CH_AXIS_NONE || isnan(vals[i])) {
+        continue;
+      }
+      plotPixel(graphCursorX, channelToPx(i, vals[i]), channels[i].colour);
+      if (plot_type == BPLOTMXMN) {
+        plotPixel(graphCursorX, channelToPx(i, ug_mn[i]), channels[i].colour);
+      }
     }
+    labels.dataEnd();
+    DIAG_DEBUG("graphCursorX = %", graphCursorX);
     graphCursorX = graphCursorX + 1;
   }
   else {
-    Serial.println("out of space, don't update the graph more");
+    DIAG_DEBUG("out of space, don't update the graph more");
+  }
+}
+
+void plotPixel(int x, int y, uint16_t colour) { // on the data layer; the rest of layer 2 holds the label sheets
+  // off-scale readings sit on the chart's edge, as in HistoryBrowser::drawSpan()
+  y = constrain(y, HISTORY_TOP, HISTORY_BOTTOM);
+  LabelCache::pixel(tft, x, y, colour);
+}
+
+void drawTrendColumn(int column, const TrendBucket &b) { // a pyramid column as updateGraph() would have drawn it
+  for (byte k = 0; k < n_plotted_channels && k < TREND_MAX_CHANNELS; k = k + 1) {
+    if (b.mean[k] == TREND_NONE) {
+      continue;
+    }
+    uint16_t colour = channels[plotted_channels[k]].colour;
+    if (b_plottype == BPLOTMXMN) {
+      plotPixel(HISTORY_X0 + column, b.min[k], colour);
+      plotPixel(HISTORY_X0 + column, b.max[k], colour);
+    }
+    else {
+      plotPixel(HISTORY_X0 + column, b.mean[k], colour); // BPLOTINST has no stored samples
+    }
+  }
+}
+
+void switchTimescale() { // the next of trend_hours[], redrawn from the pyramid
+  byte next = 0;
+  while (next < NUM_TREND_HOURS && trend_hours[next] <= b_graphlimits[BTIME]) {
+    next = next + 1;
+  }
+  b_graphlimits[BTIME] = trend_hours[next < NUM_TREND_HOURS ? next : 0];
+  graph_interval = TREND_PERIOD_MS * b_graphlimits[BTIME];
+  for (byte i = 0; i < 6; i = i + 1) {
+    gui_time_scale[i] = b_graphlimits[BTIME] / 5.0 * i;
+  }
+  labels.invalidate(SHEET_AXIS_RIGHT);
+  labels.invalidate(SHEET_AXIS_BOTTOM);
+  labels.show(SHEET_AXIS_RIGHT);
+  labels.show(SHEET_AXIS_BOTTOM);
+
+  labels.clearWindow();
+  labels.dataBegin();
+  tft.graphicsMode();
+  uint16_t columns = trend.render(b_graphlimits[BTIME], HISTORY_COLUMNS, drawTrendColumn);
+  labels.dataEnd();
+  graphCursorX = HISTORY_X0 + columns;
+  // the column being filled is plotted live from here on, when its last
+  // period closes
+  resetAggregates();
+  plot_timer = trend_timer - (trend.periods() % b_graphlimits[BTIME]) * TREND_PERIOD_MS;
+  DIAG_INFO("timescale % h, % columns redrawn", b_graphlimits[BTIME], columns);
+}
+
+void startBrowse() { // opens the log before the one shown (or before ours)
+  char prev[13];
+  endScope();
+  if (!HistoryBrowser::previousLog(browse_mode ? browser.name() : filename, prev)) {
+    updateStatus("No earlier log found.   ");
+    return;
+  }
+  if (!browser.open(prev)) {
+    updateStatus("Can't open earlier log. ");
+    return;
+  }
+  browse_mode = true;
+  init_screen = false;
+  makeGraph();
+  browser.render();
+}
+
+void stopBrowse() {
+  browser.close();
+  browse_mode = false;
+  init_screen = true;
+  tft.graphicsMode();
+  tft.fillScreen(RA8875_BLACK);
+  initGUI();
+}
+
+void startDiag() { // when already showing, steps to the next page
+  endScope();
+  if (browse_mode) {
+    browser.close();
+    browse_mode = false;
+  }
+  if (diag_mode) {
+    diag_page = (diag_page + 1) % DIAG_PAGES;
+  }
+  else {
+    diag_page = DIAG_PAGE_SD;
+  }
+  diag_mode = true;
+  init_screen = false;
+  labels.closeWindow();
+  diag.draw(diag_page, LOG_INTERVAL);
+  drawButton(b_stop_logging, "stop log");
+}
+
+void stopDiag() {
+  diag_mode = false;
+  init_screen = true;
+  tft.graphicsMode();
+  tft.fillScreen(RA8875_BLACK);
+  initGUI();
+}
+
+void startScope() { // arms a capture, or re-arms after one
+  if (browse_mode) {
+    browser.close();
+    browse_mode = false;
+  }
+  diag_mode = false;
+  if (!scope.arm(AcqPipeline::adcChannels, SCOPE_PRE_FRAMES, SCOPE_POST_FRAMES,
+                 SCOPE_TRIGGER, SCOPE_SLOT, SCOPE_LEVEL)) {
+    if (AcqPipeline::adcChannels == 0) {
+      updateStatus("No analog channels.     ");
+    }
+    else {
+      updateStatus("Stream or trace running.");
+    }
+    return;
+  }
+  adcSampler.attach(&scope);
+  scope_mode = true;
+  init_screen = false;
+  scope_timer = millis();
+  makeGraph();
+  updateStatus("Scope armed.            ");
+}
+
+void stopScope() {
+  endScope();
+  init_screen = true;
+  tft.graphicsMode();
+  tft.fillScreen(RA8875_BLACK);
+  initGUI();
+}
+
+void endScope() {
+  adcSampler.attach((ScopeCapture *)0);
+  scope.disarm();
+  scope_mode = false;
+}
+
+void updateScope() { // polls a thermocouple trigger; saves and draws a finished capture
+  if ((SCOPE_TRIGGER == SCOPE_TRIG_TC_ABOVE || SCOPE_TRIGGER == SCOPE_TRIG_TC_BELOW)
+      && scope.state() == SCOPE_ARMED && millis() - scope_timer >= SCOPE_TC_POLL) {
+    readChannels();
+    scope.poll(tc_vals[SCOPE_SLOT].thermocouple);
+    scope_timer = millis();
+  }
+  if (!scope.done()) {
+    return;
+  }
+  DateTime now = acq_trace.now(RTC);
+  char name[13];
+  int length = snprintf(name, sizeof(name), "%02u%02u%02u%02u.CAP",
+                        now.day(), now.hour(), now.minute(), now.second());
+  uint16_t frame_us = ADC_SAMPLER_CONVERSION_US * scope.channels();
+  bool saved = length < (int)sizeof(name) && scope.write(name, channels, adc_channels, frame_us);
+  DIAG_INFO("capture %", name);
+  drawScope(frame_us);
+  // the ring goes back to the SharedBuffer
+  scope.disarm();
+  if (saved) {
+    updateStatus("Capture saved.          ");
+  }
+  else {
+    updateStatus("Can't save the capture. ");
+  }
+}
+
+void drawScope(uint16_t frame_us) { // the capture as min/max spans across the chart
+  labels.clearWindow();
+  labels.dataBegin();
+  tft.graphicsMode();
+  uint16_t frames = scope.frames();
+  for (int col = 0; col < HISTORY_COLUMNS; col = col + 1) {
+    // each column reaches to the first frame of the next, so the trace joins up
+    uint16_t first = (uint32_t)col * frames / HISTORY_COLUMNS;
+    uint16_t last = (uint32_t)(col + 1) * frames / HISTORY_COLUMNS;
+    if (last >= frames) {
+      last = frames - 1;
+    }
+    for (byte s = 0; s < scope.channels(); s = s + 1) {
+      uint16_t lo = 0xFFFF;
+      uint16_t hi = 0;
+      for (uint16_t f = first; f <= last; f = f + 1) {
+        uint16_t v = scope.sample(f, s);
+        if (v < lo) {
+          lo = v;
+        }
+        if (v > hi) {
+          hi = v;
+        }
+      }
+      byte i = adc_channels[s];
+      float a = lo * channels[i].scale + channels[i].offset;
+      float b = hi * channels[i].scale + channels[i].offset;
+      if (a <= b) {
+        browser.drawSpan(col, i, a, b);
+      }
+      else {
+        browser.drawSpan(col, i, b, a); // negative scale
+      }
+    }
+  }
+  int trigger_x = HISTORY_X0 + (uint32_t)scope.pre() * HISTORY_COLUMNS / frames;
+  tft.drawLine(trigger_x, 100, trigger_x, 110, RA8875_WHITE);
+  tft.drawLine(trigger_x, 440, trigger_x, 450, RA8875_WHITE);
+  labels.dataEnd();
+
+  // milliseconds from the trigger in place of the hour labels
+  tft.fillRect(40, 465, 760, 15, RA8875_BLACK);
+  tft.textMode();
+  tft.textEnlarge(0);
+  tft.textColor(RA8875_BLACK, RA8875_WHITE);
+  tft.textSetCursor(40, 465);
+  tft.textWrite("ms");
+  tft.textColor(RA8875_WHITE, RA8875_BLACK);
+  tft.textSetCursor(100, 465);
+  tft.print(-(float)scope.pre() * frame_us / 1000);
+  tft.textSetCursor(trigger_x, 465);
+  tft.textWrite("0");
+  tft.textSetCursor(700, 465);
+  tft.print((float)(frames - scope.pre()) * frame_us / 1000);
+}
+
+void logAlarms() { // alarm edges to the diagnostic log and YYMMDD-x.EVT, then the status line
+  AlarmEvent e;
+  if (!alarms.nextEvent(&e)) {
+    return;
+  }
+  DateTime now = acq_trace.now(RTC);
+  char name[13];
+  strcpy(name, filename);
+  strcpy(strrchr(name, '.'), ".EVT");
+  SdFile events;
+  bool open = events.open(name, O_CREAT | O_WRITE | O_APPEND);
+  if (open && events.fileSize() == 0) {
+    events.println("date\ttime\tms\talarm\tedge\tvalue");
+  }
+  do {
+    const char *edge = "off";
+    if (e.active) {
+      edge = "on";
+    }
+    DIAG_WARN("alarm % % at % ms, %", alarms.rule(e.rule).name, edge, e.ms, alarms.value(e));
+    if (open) {
+      events.print(now.year(), DEC);
+      events.print(now.month(), DEC);
+      events.print(now.day(), DEC);
+      events.print("\t");
+      events.print(now.hour(), DEC);
+      events.print(':');
+      events.print(now.minute(), DEC);
+      events.print(':');
+      events.print(now.second(), DEC);
+      events.print("\t");
+      events.print(e.ms);
+      events.print("\t");
+      events.print(alarms.rule(e.rule).name);
+      events.print("\t");
+      events.print(edge);
+      events.print("\t");
+      events.println(alarms.value(e));
+    }
+  } while (alarms.nextEvent(&e));
+  if (open) {
+    events.close();
+  }
+  drawAlarmStatus();
+}
+
+void drawAlarmStatus() { // the first active alarm under the status line, if any
+  tft.graphicsMode();
+  tft.fillRect(500, 42, 300, 16, RA8875_BLACK);
+  for (byte r = 0; r < NUM_ALARMS; r = r + 1) {
+    if (alarms.active(r)) {
+      tft.textMode();
+      tft.textEnlarge(0);
+      tft.textSetCursor(500, 42);
+      tft.textColor(RA8875_WHITE, RA8875_RED);
+      tft.textWrite("ALARM ");
+      tft.textWrite(alarms.rule(r).name);
+      if (alarms.activeCount() > 1) {
+        tft.print(" +");
+        tft.print(alarms.activeCount() - 1);
+      }
+      tft.textColor(RA8875_WHITE, RA8875_BLACK);
+      break;
+    }
+  }
+}
+
+void handleSerial() { // one-letter commands from the serial monitor
+  if (!Serial.available()) {
+    return;
+  }
+  char c = Serial.read();
+  if (fileServer.reading()) {
+    fileServer.feed(c);
+    while (fileServer.reading() && Serial.available()) {
+      fileServer.feed(Serial.read());
+    }
+    return;
+  }
+  diagLog.flush(Serial); // whole lines before any reply
+  if (c == 'l') {
+    SdLatency::dump(&Serial);
+  }
+  else if (c == 'L') {
+    SdLatency::reset();
+  }
+  else if (c == 'p') {
+    LoopProfiler::dump(&Serial);
+  }
+  else if (c == 'P') {
+    LoopProfiler::reset();
+  }
+  else if (c == 't') {
+    scope.trigger();
+  }
+  else if (c == 'a') {
+    alarms.dump(&Serial);
+  }
+  else if (c == 'A') {
+    alarms.reset();
+  }
+  else if (c == 'f') {
+    fileServer.request();
+  }
+  else if (c == 's') {
+    if (frameStream.start(STREAM_BAUD, channels, adc_channels, AcqPipeline::adcChannels)) {
+      adcSampler.attach(&frameStream);
+    }
+    else if (SharedBuffer::owner() != SHARED_NONE && SharedBuffer::owner() != SHARED_STREAM) {
+      Serial.print("can't stream, the buffer is the ");
+      Serial.println(SharedBuffer::ownerName());
+    }
+    else {
+      Serial.println("can't stream these channels");
+    }
+  }
+  else if (c == 'S') {
+    adcSampler.attach((FrameStream *)0);
+    frameStream.stop();
+    Serial.print("streamed frames: ");
+    Serial.print(frameStream.sequence());
+    Serial.print(", dropped: ");
+    Serial.println(frameStream.dropped());
   }
 }
 
@@ -536,8 +1262,22 @@ void drawButton(int button[4], char strarr[]) {
 }
 
 void initGUI() {
+  labels.closeWindow();
+  labels.show(SHEET_TOP);
+  labels.show(SHEET_INIT);
+  drawAlarmStatus();
+}
+
+void paintTop() {
   drawButton(b_start_logging, "start log");
   drawButton(b_stop_logging, "stop log");
+  drawButton(b_browse, "browse");
+  drawButton(b_scope, "scope");
+  tft.textSetCursor(350, 10);
+  tft.textWrite("arduinacq");
+}
+
+void paintInit() {
   drawButton(b_incr_time, "time (+ 1hr)");
   drawButton(b_decr_time, "time (- 1hr)");
   drawButton(b_incr_temp_lo, "temp min +20c");
@@ -549,6 +1289,37 @@ void initGUI() {
   drawButton(b_plot_mean, "mean plot");
   drawButton(b_plot_mxmn, "minmax plot");
   drawButton(b_plot_inst, "inst plot");
+  tft.textSetCursor(540, 100);
+  tft.textWrite("CURRENT PARAMETERS");
+  tft.textSetCursor(130, 100);
+  tft.textWrite("PLOT TYPE");
+  tft.textSetCursor(270, 100);
+  tft.textWrite("ADJUST PLOT DISPLAY PARAMETERS");
+  tft.textSetCursor(270, 360);
+  tft.textWrite("ADJUST DATA ACQUISITION RATE");
+  tft.textSetCursor(540, 250);
+  tft.textWrite("HOW TO INITIALIZE");
+  tft.textColor(RA8875_WHITE, RA8875_BLACK);
+  tft.textSetCursor(540, 270);
+  tft.print("Adjust plot display to");
+  tft.textSetCursor(540, 290);
+  tft.print("change limits of graph."); 
+  tft.textSetCursor(540, 310);
+  tft.print("Mean averages points each");
+  tft.textSetCursor(540, 330);
+  tft.print("interval. Inst shows data");
+  tft.textSetCursor(540, 350);
+  tft.print("at plot time. Minmax plots");
+  tft.textSetCursor(540, 370);
+  tft.print("2. Acquire rate affects");
+  tft.textSetCursor(540, 390);
+  tft.print("data points per second");
+  tft.textSetCursor(540, 410);
+  tft.print("written to disk.");
+  tft.textSetCursor(540, 430);
+  tft.textColor(RA8875_BLACK, RA8875_WHITE);
+  tft.print("Tap 'Start log' to begin!");
+  tft.textColor(RA8875_WHITE, RA8875_BLACK);
 }
 
 void updateInitStatus() {
@@ -594,45 +1365,47 @@ void updateInitStatus() {
   tft.print(LOG_INTERVAL);
 }
 
-void makeGraph() {
-  // clear graph area, reset graphCursor
-  tft.fillRect(100, 100, 650, 350, RA8875_BLACK);
+void makeGraph() { // the frame on layer 1, around the data on layer 2
   graphCursorX = 101;
+  labels.show(SHEET_TOP);
+  labels.show(SHEET_AXIS_LEFT);
+  labels.show(SHEET_AXIS_RIGHT);
+  labels.show(SHEET_AXIS_BOTTOM);
+  labels.openWindow(100, 100, 650, 350);
+  tft.drawLine(100, 450, 750, 450, RA8875_WHITE);
+  tft.drawLine(100, 100, 100, 450, RA8875_WHITE);
+  drawAlarmStatus();
 
   tft.textMode();
-  tft.textSetCursor(350, 10);
-  tft.textEnlarge(0);
-  tft.textColor(RA8875_BLACK, RA8875_WHITE);
-  tft.textWrite("arduinacq");
-
   tft.textSetCursor(310, 30);
-  tft.textColor(RA8875_WHITE, RA8875_BLACK);
-  tft.textWrite("Color Legend");
-  tft.textSetCursor(310, 50);
   tft.textEnlarge(0);
   tft.textColor(RA8875_WHITE, RA8875_BLACK);
-  tft.textWrite("A0");
-  tft.textSetCursor(330, 50);
-  tft.textEnlarge(0);
-  tft.textColor(RA8875_YELLOW, RA8875_BLACK);
-  tft.textWrite("A1");
-  tft.textSetCursor(350, 50);
-  tft.textEnlarge(0);
-  tft.textColor(RA8875_GREEN, RA8875_BLACK);
-  tft.textWrite("A2");
-  tft.textSetCursor(370, 50);
-  tft.textEnlarge(0);
-  tft.textColor(RA8875_CYAN, RA8875_BLACK);
-  tft.textWrite("A3");
-  tft.textSetCursor(390, 50);
-  tft.textEnlarge(0);
-  tft.textColor(RA8875_RED, RA8875_BLACK);
-  tft.textWrite("T0");
-  tft.textSetCursor(410, 50);
-  tft.textEnlarge(0);
-  tft.textColor(RA8875_MAGENTA, RA8875_BLACK);
-  tft.textWrite("T1");
+  tft.textWrite("Color Legend");
+  // one legend entry per plotted channel, wrapping onto a second row
+  int legend_x = 310;
+  int legend_y = 50;
+  for (byte k = 0; k < n_active_channels; k = k + 1) {
+    byte i = active_channels[k];
+    if (channels[i].axis == CH_AXIS_NONE) {
+      continue;
+    }
+    int w = 8 * strlen(channels[i].label) + 4;
+    if (legend_x + w > 800) {
+      legend_x = 310;
+      legend_y = legend_y + 16;
+    }
+    tft.textSetCursor(legend_x, legend_y);
+    tft.textColor(channels[i].colour, RA8875_BLACK);
+    tft.textWrite(channels[i].label);
+    legend_x = legend_x + w;
+  }
+  tft.graphicsMode();
+}
 
+// the sheets around the chart; ticks stop short of the axis lines, which
+// lie in the gaps between sheets
+void paintAxisLeft() {
+  tft.textMode();
   tft.textSetCursor(20, 80);
   tft.textEnlarge(0);
   tft.textColor(RA8875_BLACK, RA8875_WHITE);
@@ -650,88 +1423,49 @@ void makeGraph() {
   tft.textWrite("1000[mV]");
   tft.textSetCursor(20, 440);
   tft.textWrite("0[mV]");
+  tft.textSetCursor(40, 465);
+  tft.textColor(RA8875_BLACK, RA8875_WHITE);
+  tft.textWrite("Hours");
 
+  tft.graphicsMode();
+  for (int y = 100; y <= 450; y = y + 70) {
+    tft.drawLine(90, y, 99, y, RA8875_WHITE);
+  }
+}
+
+void paintAxisRight() {
+  tft.textMode();
   tft.textSetCursor(751, 80);
+  tft.textEnlarge(0);
   tft.textColor(RA8875_BLACK, RA8875_WHITE);
   tft.textWrite("Deg. C");
   tft.textColor(RA8875_WHITE, RA8875_BLACK);
-  tft.textSetCursor(761, 100);
-  tft.textWrite("   ");
-  tft.textSetCursor(761, 100);
-  tft.print(gui_temp_scale[5]);
-  tft.textSetCursor(761, 170);
-  tft.textWrite("   ");
-  tft.textSetCursor(761, 170);
-  tft.print(gui_temp_scale[4]);
-  tft.textSetCursor(761, 240);
-  tft.textWrite("   ");
-  tft.textSetCursor(761, 240);
-  tft.print(gui_temp_scale[3]);
-  tft.textSetCursor(761, 310);
-  tft.textWrite("   ");
-  tft.textSetCursor(761, 310);
-  tft.print(gui_temp_scale[2]);
-  tft.textSetCursor(761, 380);
-  tft.textWrite("   ");
-  tft.textSetCursor(761, 380);
-  tft.print(gui_temp_scale[1]);
-  tft.textSetCursor(761, 440);
-  tft.textWrite("   ");
-  tft.textSetCursor(761, 440);
-  tft.print(gui_temp_scale[0]);
-
-  tft.textSetCursor(40, 465);
-  tft.textColor(RA8875_BLACK, RA8875_WHITE);
-  tft.textWrite("Hours");
-  tft.textColor(RA8875_WHITE, RA8875_BLACK);
-  tft.textSetCursor(100, 465);
-  tft.textWrite("  ");
-  tft.textSetCursor(100, 465);
-  tft.print(gui_time_scale[0]);
-  tft.textSetCursor(230, 465);
-  tft.textWrite("  ");
-  tft.textSetCursor(230, 465);
-  tft.print(gui_time_scale[1]);
-  tft.textSetCursor(360, 465);
-  tft.textWrite("  ");
-  tft.textSetCursor(360, 465);
-  tft.print(gui_time_scale[2]);
-  tft.textSetCursor(490, 465);
-  tft.textWrite("  ");
-  tft.textSetCursor(490, 465);
-  tft.print(gui_time_scale[3]);
-  tft.textSetCursor(620, 465);
-  tft.textWrite("  ");
-  tft.textSetCursor(620, 465);
-  tft.print(gui_time_scale[4]);
-  tft.textSetCursor(750, 465);
-  tft.textWrite("  ");
+  const int label_y[6] = {440, 380, 310, 240, 170, 100};
+  for (byte i = 0; i < 6; i = i + 1) {
+    tft.textSetCursor(761, label_y[i]);
+    tft.print(gui_temp_scale[i]);
+  }
   tft.textSetCursor(750, 465);
   tft.print(gui_time_scale[5]);
 
   tft.graphicsMode();
-  tft.drawLine(100, 450, 750, 450, RA8875_WHITE);
-  tft.drawLine(100, 100, 100, 450, RA8875_WHITE);
-
-  tft.drawLine(90, 100, 100, 100, RA8875_WHITE);
-  tft.drawLine(90, 170, 100, 170, RA8875_WHITE);
-  tft.drawLine(90, 240, 100, 240, RA8875_WHITE);
-  tft.drawLine(90, 310, 100, 310, RA8875_WHITE);
-  tft.drawLine(90, 380, 100, 380, RA8875_WHITE);
-  tft.drawLine(90, 450, 100, 450, RA8875_WHITE);
-
-  tft.drawLine(750, 100, 760, 100, RA8875_WHITE);
-  tft.drawLine(750, 170, 760, 170, RA8875_WHITE);
-  tft.drawLine(750, 240, 760, 240, RA8875_WHITE);
-  tft.drawLine(750, 310, 760, 310, RA8875_WHITE);
-  tft.drawLine(750, 380, 760, 380, RA8875_WHITE);
-  tft.drawLine(750, 450, 760, 450, RA8875_WHITE);
-
-  tft.drawLine(100, 450, 100, 460, RA8875_WHITE);
-  tft.drawLine(230, 450, 230, 460, RA8875_WHITE);
-  tft.drawLine(360, 450, 360, 460, RA8875_WHITE);
-  tft.drawLine(490, 450, 490, 460, RA8875_WHITE);
-  tft.drawLine(620, 450, 620, 460, RA8875_WHITE);
+  for (int y = 100; y <= 450; y = y + 70) {
+    tft.drawLine(750, y, 760, y, RA8875_WHITE);
+  }
   tft.drawLine(750, 450, 750, 460, RA8875_WHITE);
+}
+
+void paintAxisBottom() {
+  tft.textMode();
+  tft.textEnlarge(0);
+  tft.textColor(RA8875_WHITE, RA8875_BLACK);
+  for (byte i = 0; i < 5; i = i + 1) {
+    tft.textSetCursor(100 + 130 * i, 465);
+    tft.print(gui_time_scale[i]);
+  }
 
+  tft.graphicsMode();
+  for (int x = 100; x < 750; x = x + 130) {
+    tft.drawLine(x, 451, x, 460, RA8875_WHITE);
+  }
 }
@@ -18,6 +18,7 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <Sd2Card.h>
+#include <SdLatency.h>
 // debug trace macro
 #define SD_TRACE(m, b)
 // #define SD_TRACE(m, b) Serial.print(m);Serial.println(b);
@@ -681,6 +682,7 @@ static uint16_t CRC_CCITT(const uint8_t* data, size_t n) {
 //------------------------------------------------------------------------------
 // send command and return error code.  Return zero for OK
 uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
+  SD_LATENCY_SCOPE(SD_LAT_CARD_COMMAND);
   // select card
   chipSelectLow();
 
@@ -1057,6 +1059,7 @@ bool Sd2Card::setSckRate(uint8_t sckRateID) {
 //------------------------------------------------------------------------------
 // wait for card to go not busy
 bool Sd2Card::waitNotBusy(uint16_t timeoutMillis) {
+  SD_LATENCY_SCOPE(SD_LAT_WAIT_NOT_BUSY);
   uint16_t t0 = millis();
   while (spiRec() != 0XFF) {
     if (((uint16_t)millis() - t0) >= timeoutMillis) goto fail;
@@ -1124,6 +1127,7 @@ bool Sd2Card::writeData(const uint8_t* src) {
 //------------------------------------------------------------------------------
 // send one block of data for write block or write multiple blocks
 bool Sd2Card::writeData(uint8_t token, const uint8_t* src) {
+  SD_LATENCY_SCOPE(SD_LAT_WRITE_DATA);
 #if USE_SD_CRC
   uint16_t crc = CRC_CCITT(src, 512);
 #else  // USE_SD_CRC
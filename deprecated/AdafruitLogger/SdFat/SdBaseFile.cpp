@@ -18,6 +18,7 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <SdFat.h>
+#include <SdLatency.h>
 // macro for debug
 #define DBG_FAIL_MACRO  //  Serial.print(__FILE__);Serial.println(__LINE__)
 //------------------------------------------------------------------------------
@@ -28,6 +29,7 @@ void (*SdBaseFile::dateTime_)(uint16_t* date, uint16_t* time) = 0;
 //------------------------------------------------------------------------------
 // add a cluster to a file
 bool SdBaseFile::addCluster() {
+  SD_LATENCY_SCOPE(SD_LAT_ADD_CLUSTER);
   if (!vol_->allocContiguous(1, &curCluster_)) {
     DBG_FAIL_MACRO;
     goto fail;
@@ -102,7 +104,8 @@ dir_t* SdBaseFile::cacheDirEntry(uint8_t action) {
  * Reasons for failure include no file is open or an I/O error.
  */
 bool SdBaseFile::close() {
-  bool rtn = sync();
+  bool rtn = streamStop();
+  rtn = sync() && rtn;
   type_ = FAT_FILE_TYPE_CLOSED;
   return rtn;
 }
@@ -1406,6 +1409,166 @@ int SdBaseFile::read(void* buf, size_t nbyte) {
   return -1;
 }
 //------------------------------------------------------------------------------
+/** Start a streamed read at the current position.
+ *
+ * A streamed read keeps one CMD18 multiple block read open for each run of
+ * contiguous clusters, so a sequential scan of a file that was written
+ * without fragmentation costs one command per run instead of one per block.
+ * Blocks are read into the volume cache and handed back by streamRead()
+ * without a copy.
+ *
+ * No other access to the card, through this file or any other, is allowed
+ * until streamStop() is called.  seekSet() and read() must not be used on
+ * this file while a stream is open.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure include the file is not open for read or is not a
+ * regular file, or the cache could not be written back.
+ */
+bool SdBaseFile::streamStart() {
+  if (!isFile() || !(flags_ & O_READ)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if (!streamStop()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  // a dirty cache block can't be written back once the card is streaming
+  if (!vol_->cacheSync()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Read the block holding the current position of a streamed read.
+ *
+ * \param[out] data Set to the first byte at the current position.  The
+ * pointer is into the volume cache and is valid until the next call to
+ * streamRead() or any other access to the volume.
+ *
+ * \return The number of bytes available at \a data, from the current
+ * position to the end of its block or to end of file, whichever is first.
+ * The position is advanced by that amount.  Zero is returned at end of file
+ * and -1 on an I/O error or if streamStart() was not called.
+ */
+int SdBaseFile::streamRead(const uint8_t** data) {
+  uint16_t offset;
+  uint8_t blockOfCluster;
+  uint32_t block;
+  uint32_t n;
+  uint8_t* dst;
+
+  if (!isFile() || !(flags_ & O_READ)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if (curPosition_ >= fileSize_) return 0;
+
+  offset = curPosition_ & 0X1FF;
+  blockOfCluster = vol_->blockOfCluster(curPosition_);
+  if (offset == 0 && blockOfCluster == 0) {
+    // start of new cluster
+    if (curPosition_ == 0) {
+      curCluster_ = firstCluster_;
+    } else if (streamEnd_ && streamBlock_ < streamEnd_) {
+      // still inside a contiguous run, no need to go to the FAT
+      curCluster_++;
+    } else {
+      // the FAT is read through the cache, so the run must be closed first
+      if (!streamStop() || !vol_->fatGet(curCluster_, &curCluster_)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    }
+  }
+  block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
+  if (!streamEnd_ || block != streamBlock_ || block >= streamEnd_) {
+    if (!streamStop()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    streamBlock_ = block;
+    if (!streamRun()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  dst = vol_->cacheAddress()->data;
+  if (!vol_->sdCard()->readData(dst)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  streamBlock_++;
+
+  n = 512 - offset;
+  if (n > (fileSize_ - curPosition_)) n = fileSize_ - curPosition_;
+  *data = dst + offset;
+  curPosition_ += n;
+  return n;
+
+ fail:
+  streamStop();
+  return -1;
+}
+//------------------------------------------------------------------------------
+// Find the contiguous run of clusters starting at streamBlock_ and send CMD18
+// for it.  The run stops at the last block of the file.
+bool SdBaseFile::streamRun() {
+  uint32_t cluster = curCluster_;
+  uint32_t next;
+  uint32_t lastBlock = streamBlock_ + ((fileSize_ - 1) >> 9)
+                       - (curPosition_ >> 9);
+  uint32_t end = vol_->clusterStartBlock(cluster) + vol_->blocksPerCluster();
+  while (end <= lastBlock) {
+    if (!vol_->fatGet(cluster, &next)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (next != cluster + 1) break;
+    cluster = next;
+    end += vol_->blocksPerCluster();
+  }
+  if (end > lastBlock + 1) end = lastBlock + 1;
+  // blocks land in the cache buffer, so forget the FAT block fatGet left there
+  if (!vol_->cacheClear()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if (!vol_->sdCard()->readStart(streamBlock_)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  streamEnd_ = end;
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+/** End a streamed read.
+ *
+ * The file position is left after the last byte returned by streamRead(), so
+ * read() and seekSet() may be used again.  Calling streamStop() when no
+ * stream is open does nothing.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdBaseFile::streamStop() {
+  bool rtn = true;
+  if (streamEnd_) {
+    rtn = vol_->sdCard()->readStop();
+    streamEnd_ = 0;
+  }
+  return rtn;
+}
+//------------------------------------------------------------------------------
 /** Read the next directory entry from a directory file.
  *
  * \param[out] dir The dir_t struct that will receive the data.
@@ -1774,6 +1937,8 @@ bool SdBaseFile::rmRfStar() {
 SdBaseFile::SdBaseFile(const char* path, uint8_t oflag) {
   type_ = FAT_FILE_TYPE_CLOSED;
   writeError = false;
+  streamBlock_ = 0;
+  streamEnd_ = 0;
   open(path, oflag);
 }
 //------------------------------------------------------------------------------
@@ -1805,6 +1970,7 @@ bool SdBaseFile::seekSet(uint32_t pos) {
   // calculate cluster index for cur and new position
   nCur = (curPosition_ - 1) >> (vol_->clusterSizeShift_ + 9);
   nNew = (pos - 1) >> (vol_->clusterSizeShift_ + 9);
+  if (flags_ & F_CLUSTER_AHEAD) nCur++;
 
   if (nNew < nCur || curPosition_ == 0) {
     // must follow chain from first cluster
@@ -1822,6 +1988,7 @@ bool SdBaseFile::seekSet(uint32_t pos) {
   curPosition_ = pos;
 
  done:
+  flags_ &= ~F_CLUSTER_AHEAD;
   return true;
 
  fail:
@@ -1865,6 +2032,7 @@ void SdBaseFile::setpos(FatPos_t* pos) {
  * opened or an I/O error.
  */
 bool SdBaseFile::sync() {
+  SD_LATENCY_SCOPE(SD_LAT_FILE_SYNC);
   // only allow open files and directories
   if (!isOpen()) {
     DBG_FAIL_MACRO;
@@ -2119,6 +2287,7 @@ bool SdBaseFile::truncate(uint32_t length) {
  *
  */
 int SdBaseFile::write(const void* buf, size_t nbyte) {
+  SD_LATENCY_SCOPE(SD_LAT_FILE_WRITE);
   // convert void* to uint8_t*  -  must be before goto statements
   const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
   cache_t* pc;
@@ -2143,31 +2312,9 @@ int SdBaseFile::write(const void* buf, size_t nbyte) {
     uint16_t blockOffset = curPosition_ & 0X1FF;
     if (blockOfCluster == 0 && blockOffset == 0) {
       // start of new cluster
-      if (curCluster_ != 0) {
-        uint32_t next;
-        if (!vol_->fatGet(curCluster_, &next)) {
-          DBG_FAIL_MACRO;
-          goto fail;
-        }
-        if (vol_->isEOC(next)) {
-          // add cluster if at end of chain
-          if (!addCluster()) {
-            DBG_FAIL_MACRO;
-            goto fail;
-          }
-        } else {
-          curCluster_ = next;
-        }
-      } else {
-        if (firstCluster_ == 0) {
-          // allocate first cluster of file
-          if (!addCluster()) {
-            DBG_FAIL_MACRO;
-            goto fail;
-          }
-        } else {
-          curCluster_ = firstCluster_;
-        }
+      if (!writeCluster()) {
+        DBG_FAIL_MACRO;
+        goto fail;
       }
     }
     // block for data write
@@ -2237,6 +2384,7 @@ int SdBaseFile::write(const void* buf, size_t nbyte) {
       }
     }
     curPosition_ += n;
+    flags_ &= ~F_CLUSTER_AHEAD;
     src += n;
     nToWrite -= n;
   }
@@ -2263,6 +2411,145 @@ int SdBaseFile::write(const void* buf, size_t nbyte) {
   return -1;
 }
 //------------------------------------------------------------------------------
+// Move curCluster_ to the cluster that starts at curPosition_, adding one to
+// the chain if the file ends here.
+bool SdBaseFile::writeCluster() {
+  if (flags_ & F_CLUSTER_AHEAD) return true;
+  if (curCluster_ != 0) {
+    uint32_t next;
+    if (!vol_->fatGet(curCluster_, &next)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (vol_->isEOC(next)) {
+      // add cluster if at end of chain
+      if (!addCluster()) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    } else {
+      curCluster_ = next;
+    }
+  } else {
+    if (firstCluster_ == 0) {
+      // allocate first cluster of file
+      if (!addCluster()) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    } else {
+      curCluster_ = firstCluster_;
+    }
+  }
+  flags_ |= F_CLUSTER_AHEAD;
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Lend the caller the cache block at the current position.
+ *
+ * The caller writes up to \a avail bytes straight into the volume cache and
+ * then calls writeCommit() with the number actually written, which saves
+ * the copy write() makes from the caller's buffer.  A row that doesn't fit
+ * is finished by committing the full block and reserving again.
+ *
+ * Nothing else may access the volume between writeReserve() and
+ * writeCommit(), since the block must still be in the cache.  Calling
+ * writeReserve() again without a commit returns the same block.
+ *
+ * \param[out] avail Bytes from the current position to the end of the block.
+ *
+ * \return A pointer to the cache at the current position, or zero if the
+ * file is not open for write, a cluster could not be allocated or an I/O
+ * error occurred.
+ */
+uint8_t* SdBaseFile::writeReserve(uint16_t* avail) {
+  SD_LATENCY_SCOPE(SD_LAT_FILE_WRITE);
+  uint8_t blockOfCluster;
+  uint16_t blockOffset;
+  uint32_t block;
+  cache_t* pc;
+
+  if (!isFile() || !(flags_ & O_WRITE)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  // seek to end of file if append flag
+  if ((flags_ & O_APPEND) && curPosition_ != fileSize_) {
+    if (!seekEnd()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  blockOfCluster = vol_->blockOfCluster(curPosition_);
+  blockOffset = curPosition_ & 0X1FF;
+  if (blockOfCluster == 0 && blockOffset == 0) {
+    if (!writeCluster()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
+  // a new block past the end of file needn't be read first
+  pc = vol_->cacheFetch(block, blockOffset == 0 && curPosition_ >= fileSize_
+                        ? SdVolume::CACHE_RESERVE_FOR_WRITE
+                        : SdVolume::CACHE_FOR_WRITE);
+  if (!pc) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  *avail = 512 - blockOffset;
+  return pc->data + blockOffset;
+
+ fail:
+  writeError = true;
+  return 0;
+}
+//------------------------------------------------------------------------------
+/** Finish a write started with writeReserve().
+ *
+ * \param[in] n Number of bytes written at the reserved pointer, no more than
+ * the \a avail returned by writeReserve().  A full block is written to the
+ * card straight away, as write() does.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdBaseFile::writeCommit(uint16_t n) {
+  SD_LATENCY_SCOPE(SD_LAT_FILE_WRITE);
+  if (!isFile() || !(flags_ & O_WRITE) || n > 512 - (curPosition_ & 0X1FF)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if (n == 0) return true;
+  curPosition_ += n;
+  flags_ &= ~F_CLUSTER_AHEAD;
+  if ((curPosition_ & 0X1FF) == 0) {
+    if (!vol_->cacheWriteData()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  if (curPosition_ > fileSize_) {
+    fileSize_ = curPosition_;
+  }
+  // insure sync will update the dir entry
+  flags_ |= F_FILE_DIR_DIRTY;
+  if (flags_ & O_SYNC) {
+    if (!sync()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  return true;
+
+ fail:
+  writeError = true;
+  return false;
+}
+//------------------------------------------------------------------------------
 // suppress cpplint warnings with NOLINT comment
 #if ALLOW_DEPRECATED_FUNCTIONS && !defined(DOXYGEN)
 void (*SdBaseFile::oldDateTime_)(uint16_t& date, uint16_t& time) = 0;  // NOLINT
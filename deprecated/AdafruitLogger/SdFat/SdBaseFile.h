@@ -203,7 +203,8 @@ uint16_t const FAT_DEFAULT_TIME = (1 << 11);
 class SdBaseFile {
  public:
   /** Create an instance. */
-  SdBaseFile() : writeError(false), type_(FAT_FILE_TYPE_CLOSED) {}
+  SdBaseFile() : writeError(false), type_(FAT_FILE_TYPE_CLOSED),
+    streamBlock_(0), streamEnd_(0) {}
   SdBaseFile(const char* path, uint8_t oflag);
 #if DESTRUCTOR_CLOSES_FILE
   ~SdBaseFile() {if(isOpen()) close();}
@@ -341,6 +342,9 @@ class SdBaseFile {
    */
   bool seekEnd(int32_t offset = 0) {return seekSet(fileSize_ + offset);}
   bool seekSet(uint32_t pos);
+  bool streamStart();
+  int streamRead(const uint8_t** data);
+  bool streamStop();
   bool sync();
   bool timestamp(SdBaseFile* file);
   bool timestamp(uint8_t flag, uint16_t year, uint8_t month, uint8_t day,
@@ -355,6 +359,8 @@ class SdBaseFile {
   /** \return SdVolume that contains this file. */
   SdVolume* volume() const {return vol_;}
   int write(const void* buf, size_t nbyte);
+  uint8_t* writeReserve(uint16_t* avail);
+  bool writeCommit(uint16_t n);
 //------------------------------------------------------------------------------
  private:
   // allow SdFat to set cwd_
@@ -368,6 +374,9 @@ class SdBaseFile {
   static uint8_t const F_OFLAG = (O_ACCMODE | O_APPEND | O_SYNC);
   // sync of directory entry required
   static uint8_t const F_FILE_DIR_DIRTY = 0X80;
+  // curCluster_ already holds curPosition_, set by writeReserve() at the
+  // start of a cluster until the position moves
+  static uint8_t const F_CLUSTER_AHEAD = 0X40;
 
   // private data
   uint8_t   flags_;         // See above for definition of flags_ bits
@@ -380,6 +389,8 @@ class SdBaseFile {
   uint32_t  dirBlock_;      // block for this files directory entry
   uint32_t  fileSize_;      // file size in bytes
   uint32_t  firstCluster_;  // first cluster of file
+  uint32_t  streamBlock_;   // next block the card sends in a streamed read
+  uint32_t  streamEnd_;     // end of the contiguous run, zero if no CMD18
 
   /** experimental don't use */
   bool openParent(SdBaseFile* dir);
@@ -394,6 +405,8 @@ class SdBaseFile {
   bool openCachedEntry(uint8_t cacheIndex, uint8_t oflags);
   dir_t* readDirCache();
   bool setDirSize();
+  bool streamRun();
+  bool writeCluster();
 //------------------------------------------------------------------------------
 // to be deleted
   static void printDirName(const dir_t& dir,
@@ -36,6 +36,13 @@
 #define USE_SEPARATE_FAT_CACHE 0
 #endif  // __arm__
 //------------------------------------------------------------------------------
+/**
+ * Set USE_SD_LATENCY nonzero to record latency histograms for the
+ * Sd2Card, SdVolume and SdBaseFile hot paths, see SdLatency.h.
+ * Costs about 500 bytes of RAM and, on the Mega, Timer5.
+ */
+#define USE_SD_LATENCY 1
+//------------------------------------------------------------------------------
 /**
  * Don't use mult-block read/write on small AVR boards
  */
@@ -0,0 +1,140 @@
+/* Arduino SdFat Library
+ * SdLatency.cpp - latency histograms for the card, volume and file hot paths.
+ * Added for arduinacq, 2016.  Space Sciences Laboratory
+ *
+ * This file is part of the Arduino SdFat Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <SdLatency.h>
+#ifdef __AVR__
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#endif  // __AVR__
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif  // F_CPU
+//------------------------------------------------------------------------------
+SdLatencyEntry SdLatency::table_[SD_LAT_PROBES];
+
+static const char probeName0[] PROGMEM = "card_command";
+static const char probeName1[] PROGMEM = "wait_not_busy";
+static const char probeName2[] PROGMEM = "write_data";
+static const char probeName3[] PROGMEM = "fat_get";
+static const char probeName4[] PROGMEM = "fat_put";
+static const char probeName5[] PROGMEM = "cache_sync";
+static const char probeName6[] PROGMEM = "file_write";
+static const char probeName7[] PROGMEM = "file_sync";
+static const char probeName8[] PROGMEM = "add_cluster";
+static const char* const probeNames[SD_LAT_PROBES] PROGMEM = {
+  probeName0, probeName1, probeName2, probeName3, probeName4,
+  probeName5, probeName6, probeName7, probeName8
+};
+//------------------------------------------------------------------------------
+#if defined(TCNT5)
+// Timer5 overflows every 65536 cycles
+static volatile uint16_t timerOverflows;
+
+ISR(TIMER5_OVF_vect) {
+  timerOverflows++;
+}
+#endif  // defined(TCNT5)
+//------------------------------------------------------------------------------
+/** Start the cycle counter.  Call once from setup(). */
+void SdLatency::begin() {
+#if defined(TCNT5)
+  TCCR5A = 0;
+  TCCR5B = _BV(CS50);  // normal mode, no prescaler
+  TCNT5 = 0;
+  TIFR5 = _BV(TOV5);
+  TIMSK5 = _BV(TOIE5);
+#endif  // defined(TCNT5)
+  reset();
+}
+//------------------------------------------------------------------------------
+/** \return CPU cycles since begin(), wrapping after 2^32. */
+uint32_t SdLatency::cycles() {
+#if defined(TCNT5)
+  uint8_t s = SREG;
+  cli();
+  uint16_t t = TCNT5;
+  uint16_t hi = timerOverflows;
+  // overflow since interrupts went off, not yet counted
+  if ((TIFR5 & _BV(TOV5)) && t < 0X8000) hi++;
+  SREG = s;
+  return ((uint32_t)hi << 16) | t;
+#else  // defined(TCNT5)
+  return micros() * (F_CPU / 1000000UL);
+#endif  // defined(TCNT5)
+}
+//------------------------------------------------------------------------------
+/** Add one call of \a cycles to \a probe. */
+void SdLatency::record(uint8_t probe, uint32_t cycles) {
+  SdLatencyEntry* e = &table_[probe];
+  uint8_t b = 0;
+  uint32_t c = cycles;
+  while (c > 1 && b < SD_LATENCY_BUCKETS - 1) {
+    c >>= 1;
+    b++;
+  }
+  if (e->hist[b] != 0XFFFF) e->hist[b]++;
+  e->count++;
+  if (cycles > e->max) e->max = cycles;
+}
+//------------------------------------------------------------------------------
+/** Clear all counters. */
+void SdLatency::reset() {
+  memset(table_, 0, sizeof(table_));
+}
+//------------------------------------------------------------------------------
+/** Copy the name of \a probe into \a buf, truncated to \a size - 1. */
+void SdLatency::name(uint8_t probe, char* buf, uint8_t size) {
+  const char* p = reinterpret_cast<const char*>(
+                    pgm_read_word(&probeNames[probe]));
+  uint8_t i = 0;
+  char c;
+  while (i < size - 1 && (c = pgm_read_byte(p + i))) buf[i++] = c;
+  buf[i] = '\0';
+}
+//------------------------------------------------------------------------------
+/** Print the table as CSV: one row per probe, bucket counts last.
+ *
+ * \param[in] pr Print stream for output.
+ */
+void SdLatency::dump(Print* pr) {
+  char buf[16];
+  pr->print(F("# sd latency, cycles at "));
+  pr->print(F_CPU);
+  pr->println(F(" Hz, bucket b is [2^b, 2^(b+1)) cycles"));
+  pr->print(F("probe,count,max"));
+  for (uint8_t b = 0; b < SD_LATENCY_BUCKETS; b++) {
+    pr->print(F(",b"));
+    pr->print(b);
+  }
+  pr->println();
+  for (uint8_t p = 0; p < SD_LAT_PROBES; p++) {
+    name(p, buf, sizeof(buf));
+    pr->print(buf);
+    pr->write(',');
+    pr->print(table_[p].count);
+    pr->write(',');
+    pr->print(table_[p].max);
+    for (uint8_t b = 0; b < SD_LATENCY_BUCKETS; b++) {
+      pr->write(',');
+      pr->print(table_[p].hist[b]);
+    }
+    pr->println();
+  }
+}
@@ -0,0 +1,110 @@
+/* Arduino SdFat Library
+ * SdLatency.h - latency histograms for the card, volume and file hot paths.
+ * Added for arduinacq, 2016.  Space Sciences Laboratory
+ *
+ * This file is part of the Arduino SdFat Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef SdLatency_h
+#define SdLatency_h
+/**
+ * \file
+ * \brief Latency histograms for SdFat hot paths.
+ *
+ * Each probe covers one function and records its inclusive time, so a
+ * stall in Sd2Card::waitNotBusy() also shows up in the SdVolume and
+ * SdBaseFile calls above it.  That is what tells the layers apart: the
+ * innermost probe with the long tail is where the time went.
+ *
+ * Times are in CPU cycles.  On the Mega, Timer5 runs at the CPU clock with
+ * an overflow count kept in software; elsewhere, including the host build,
+ * micros() is scaled by F_CPU.  Bucket b counts calls that took
+ * [2^b, 2^(b+1)) cycles; the last bucket also takes everything slower.
+ */
+#include <Arduino.h>
+#include <SdFatConfig.h>
+
+/** number of histogram buckets, 2^23 cycles is 0.5 s at 16 MHz */
+#define SD_LATENCY_BUCKETS 24
+
+/** probes, one per instrumented function */
+enum SdLatencyProbe {
+  SD_LAT_CARD_COMMAND,
+  SD_LAT_WAIT_NOT_BUSY,
+  SD_LAT_WRITE_DATA,
+  SD_LAT_FAT_GET,
+  SD_LAT_FAT_PUT,
+  SD_LAT_CACHE_SYNC,
+  SD_LAT_FILE_WRITE,
+  SD_LAT_FILE_SYNC,
+  SD_LAT_ADD_CLUSTER,
+  SD_LAT_PROBES
+};
+
+/** one probe's counters */
+struct SdLatencyEntry {
+  /** calls recorded */
+  uint32_t count;
+  /** slowest call, in cycles */
+  uint32_t max;
+  /** calls per bucket, saturating */
+  uint16_t hist[SD_LATENCY_BUCKETS];
+};
+
+/**
+ * \class SdLatency
+ * \brief Fixed-size table of latency histograms.
+ */
+class SdLatency {
+ public:
+  static void begin();
+  static uint32_t cycles();
+  static void record(uint8_t probe, uint32_t cycles);
+  static void reset();
+  static void dump(Print* pr);
+  static void name(uint8_t probe, char* buf, uint8_t size);
+  /** \return the counters of \a probe */
+  static const SdLatencyEntry& entry(uint8_t probe) {return table_[probe];}
+  /** \return lowest cycle count of bucket \a b */
+  static uint32_t bucketStart(uint8_t b) {return 1UL << b;}
+
+ private:
+  static SdLatencyEntry table_[SD_LAT_PROBES];
+};
+
+/**
+ * \class SdLatencyScope
+ * \brief Records the time from construction to destruction.
+ */
+class SdLatencyScope {
+ public:
+  /** Start timing \a probe. */
+  explicit SdLatencyScope(uint8_t probe)
+    : probe_(probe), start_(SdLatency::cycles()) {}
+  ~SdLatencyScope() {SdLatency::record(probe_, SdLatency::cycles() - start_);}
+
+ private:
+  uint8_t probe_;
+  uint32_t start_;
+};
+
+#if USE_SD_LATENCY
+/** Time the rest of the enclosing block as \a probe. */
+#define SD_LATENCY_SCOPE(probe) SdLatencyScope sdLatencyScope_(probe)
+#else  // USE_SD_LATENCY
+#define SD_LATENCY_SCOPE(probe)
+#endif  // USE_SD_LATENCY
+#endif  // SdLatency_h
@@ -18,6 +18,7 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include <SdVolume.h>
+#include <SdLatency.h>
 // macro for debug
 #define DBG_FAIL_MACRO  //  Serial.print(__FILE__);Serial.println(__LINE__)
 //------------------------------------------------------------------------------
@@ -174,6 +175,7 @@ cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheSync() {
+  SD_LATENCY_SCOPE(SD_LAT_CACHE_SYNC);
   return cacheWriteData() && cacheWriteFat();
 }
 //------------------------------------------------------------------------------
@@ -241,6 +243,7 @@ cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheSync() {
+  SD_LATENCY_SCOPE(SD_LAT_CACHE_SYNC);
   if (cacheStatus_ & CACHE_STATUS_DIRTY) {
     if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data)) {
       DBG_FAIL_MACRO;
@@ -279,6 +282,7 @@ uint32_t SdVolume::clusterStartBlock(uint32_t cluster) const {
 //------------------------------------------------------------------------------
 // Fetch a FAT entry
 bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
+  SD_LATENCY_SCOPE(SD_LAT_FAT_GET);
   uint32_t lba;
   cache_t* pc;
   // error if reserved cluster of beyond FAT
@@ -336,6 +340,7 @@ bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
 //------------------------------------------------------------------------------
 // Store a FAT entry
 bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
+  SD_LATENCY_SCOPE(SD_LAT_FAT_PUT);
   uint32_t lba;
   cache_t* pc;
   // error if reserved cluster of beyond FAT
@@ -0,0 +1,219 @@
+/*
+  pipeline_bench.cpp - Cycles per sample of the compiled ChannelPipeline
+  against the runtime channel-table loop it replaced.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Build and run from the repository root:
+    g++ -std=gnu++11 -Os -Ihost/shim -Iacq host/bench/pipeline_bench.cpp -o pipeline_bench
+    ./pipeline_bench
+
+  Two lists are measured: the shipping ACQ_CHANNEL_LIST and an 18 channel
+  list (all 16 Mega analog pins plus two thermocouples, a few disabled).
+  "sample" is read + scale + aggregate; "format" adds printing the log row.
+  Build with -Os like the Arduino core; x86 numbers only show the relative
+  cost of dispatch, not AVR cycles.
+*/
+
+#include <chrono>
+#include "Arduino.h"
+
+#define RA8875_BLACK   0x0000
+#define RA8875_RED     0xF800
+#define RA8875_GREEN   0x07E0
+#define RA8875_CYAN    0x07FF
+#define RA8875_MAGENTA 0xF81F
+#define RA8875_YELLOW  0xFFE0
+#define RA8875_WHITE   0xFFFF
+
+#include "Channels.h"
+#include "ChannelList.h"
+#include "ChannelPipeline.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles() { return __rdtsc(); }
+#define CYCLE_UNIT "cycles"
+#else
+static inline uint64_t cycles() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+#define BENCH_CHANNEL_LIST(CH) \
+  CH(b0,  CH_SRC_ANALOG,      0,  4.883, 0, "A0",  "mV", RA8875_WHITE,   CH_AXIS_MV,   true) \
+  CH(b1,  CH_SRC_ANALOG,      1,  4.883, 0, "A1",  "mV", RA8875_YELLOW,  CH_AXIS_MV,   true) \
+  CH(b2,  CH_SRC_ANALOG,      2,  4.883, 0, "A2",  "mV", RA8875_GREEN,   CH_AXIS_MV,   true) \
+  CH(b3,  CH_SRC_ANALOG,      3,  4.883, 0, "A3",  "mV", RA8875_CYAN,    CH_AXIS_MV,   true) \
+  CH(b4,  CH_SRC_ANALOG,      4,  4.883, 0, "A4",  "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b5,  CH_SRC_ANALOG,      5,  4.883, 0, "A5",  "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b6,  CH_SRC_ANALOG,      6,  4.883, 0, "A6",  "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b7,  CH_SRC_ANALOG,      7,  4.883, 0, "A7",  "mV", RA8875_WHITE,   CH_AXIS_NONE, false) \
+  CH(b8,  CH_SRC_ANALOG,      8,  4.883, 0, "A8",  "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b9,  CH_SRC_ANALOG,      9,  4.883, 0, "A9",  "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b10, CH_SRC_ANALOG,      10, 4.883, 0, "A10", "mV", RA8875_WHITE,   CH_AXIS_NONE, false) \
+  CH(b11, CH_SRC_ANALOG,      11, 4.883, 0, "A11", "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b12, CH_SRC_ANALOG,      12, 4.883, 0, "A12", "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b13, CH_SRC_ANALOG,      13, 4.883, 0, "A13", "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b14, CH_SRC_ANALOG,      14, 4.883, 0, "A14", "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b15, CH_SRC_ANALOG,      15, 4.883, 0, "A15", "mV", RA8875_WHITE,   CH_AXIS_NONE, true) \
+  CH(b16, CH_SRC_TC,          0,  1,     0, "TC0", "C",  RA8875_RED,     CH_AXIS_DEGC, true) \
+  CH(b17, CH_SRC_TC_INTERNAL, 1,  1,     0, "T1",  "C",  RA8875_MAGENTA, CH_AXIS_DEGC, true)
+
+ACQ_CHANNEL_LIST(CHANNEL_TRAITS)
+BENCH_CHANNEL_LIST(CHANNEL_TRAITS)
+typedef ChannelPipeline<0, 0 ACQ_CHANNEL_LIST(CHANNEL_TYPE)> AcqPipeline;
+typedef ChannelPipeline<0, 0 BENCH_CHANNEL_LIST(CHANNEL_TYPE)> BenchPipeline;
+static const Channel acq_table[] = { ACQ_CHANNEL_LIST(CHANNEL_ENTRY) };
+static const Channel bench_table[] = { BENCH_CHANNEL_LIST(CHANNEL_ENTRY) };
+
+// volatile so the reads are not hoisted out of the timing loop
+static volatile float adc_values[16];
+static volatile float tc_values[2];
+static volatile float internal_values[2];
+
+struct BenchSources {
+  float analog(uint8_t slot) { return adc_values[slot & 15]; }
+  float thermocouple(uint8_t index) { return tc_values[index]; }
+  float internal(uint8_t index) { return internal_values[index]; }
+};
+
+class NullPrint : public Print {
+  public:
+    NullPrint() : bytes(0) {}
+    size_t write(uint8_t) { bytes++; return 1; }
+    unsigned long bytes;
+};
+
+// the loops acq.ino ran before the pipeline, kept here as the baseline
+struct RuntimeTable {
+  const Channel *table;
+  byte active[MAX_CHANNELS];
+  byte slot[MAX_CHANNELS];
+  byte n_active;
+
+  RuntimeTable(const Channel *t, byte n) : table(t), n_active(0) {
+    byte n_adc = 0;
+    for (byte i = 0; i < n; i++) {
+      if (!t[i].logged && t[i].axis == CH_AXIS_NONE) {
+        continue;
+      }
+      if (t[i].source == CH_SRC_ANALOG) {
+        slot[i] = n_adc++;
+      }
+      active[n_active++] = i;
+    }
+  }
+  void read(BenchSources &s, float *vals) {
+    for (byte k = 0; k < n_active; k++) {
+      byte i = active[k];
+      float raw;
+      if (table[i].source == CH_SRC_ANALOG) {
+        raw = s.analog(slot[i]);
+      }
+      else if (table[i].source == CH_SRC_TC) {
+        raw = s.thermocouple(table[i].index);
+      }
+      else {
+        raw = s.internal(table[i].index);
+      }
+      vals[i] = raw * table[i].scale + table[i].offset;
+    }
+  }
+  void aggregateMean(const float *vals, float *cma, uint16_t *n) {
+    for (byte k = 0; k < n_active; k++) {
+      byte i = active[k];
+      if (table[i].axis != CH_AXIS_NONE && !isnan(vals[i])) {
+        n[i]++;
+        cma[i] = n[i] == 1 ? vals[i] : ((n[i] - 1) * cma[i] + vals[i]) / n[i];
+      }
+    }
+  }
+  void format(Print &p, const float *vals) {
+    for (byte k = 0; k < n_active; k++) {
+      byte i = active[k];
+      if (table[i].logged) {
+        p.print('\t');
+        p.print(vals[i]);
+      }
+    }
+  }
+};
+
+static const long ITERATIONS = 200000;
+
+// results are summed here so the optimiser can't drop the aggregation
+static volatile float sink;
+
+template <class P>
+static void benchPipeline(const char *name, bool format) {
+  BenchSources s;
+  NullPrint out;
+  float vals[MAX_CHANNELS] = {0};
+  float cma[MAX_CHANNELS] = {0};
+  uint16_t points[MAX_CHANNELS] = {0};
+  uint64_t start = cycles();
+  for (long n = 1; n <= ITERATIONS; n++) {
+    P::read(s, vals);
+    P::aggregateMean(vals, cma, points);
+    if (format) {
+      P::format(out, vals);
+    }
+  }
+  uint64_t total = cycles() - start;
+  for (byte i = 0; i < MAX_CHANNELS; i++) {
+    sink = sink + cma[i] + vals[i];
+  }
+  printf("%-10s %-8s template %8.1f %s/sample\n", name, format ? "format" : "sample",
+         (double)total / ITERATIONS, CYCLE_UNIT);
+}
+
+static void benchTable(const char *name, const Channel *table, byte n_channels, bool format) {
+  BenchSources s;
+  NullPrint out;
+  RuntimeTable rt(table, n_channels);
+  float vals[MAX_CHANNELS] = {0};
+  float cma[MAX_CHANNELS] = {0};
+  uint16_t points[MAX_CHANNELS] = {0};
+  uint64_t start = cycles();
+  for (long n = 1; n <= ITERATIONS; n++) {
+    rt.read(s, vals);
+    rt.aggregateMean(vals, cma, points);
+    if (format) {
+      rt.format(out, vals);
+    }
+  }
+  uint64_t total = cycles() - start;
+  for (byte i = 0; i < MAX_CHANNELS; i++) {
+    sink = sink + cma[i] + vals[i];
+  }
+  printf("%-10s %-8s table    %8.1f %s/sample\n", name, format ? "format" : "sample",
+         (double)total / ITERATIONS, CYCLE_UNIT);
+}
+
+int main() {
+  for (byte i = 0; i < 16; i++) {
+    adc_values[i] = 100 + 37 * i;
+  }
+  tc_values[0] = 21.5;
+  tc_values[1] = 22.25;
+  internal_values[0] = 23.0625;
+  internal_values[1] = 24.125;
+
+  const byte acq_n = sizeof(acq_table) / sizeof(acq_table[0]);
+  const byte bench_n = sizeof(bench_table) / sizeof(bench_table[0]);
+  // first pass warms caches and clocks up and is not reported
+  benchPipeline<AcqPipeline>("warmup", true);
+  benchTable("warmup", acq_table, acq_n, true);
+  printf("\n");
+  for (byte f = 0; f < 2; f++) {
+    benchPipeline<AcqPipeline>("acq", f);
+    benchTable("acq", acq_table, acq_n, f);
+    benchPipeline<BenchPipeline>("mega18", f);
+    benchTable("mega18", bench_table, bench_n, f);
+  }
+  return 0;
+}
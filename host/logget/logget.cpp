@@ -0,0 +1,340 @@
+/*
+  logget.cpp - Copies files off the logger's card over Serial (acq/FileServer.h).
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Build from the repository root:
+    g++ -std=gnu++11 -O2 host/logget/logget.cpp -o logget
+  and run, with the Mega's USB port as tty:
+    ./logget [-b 500000] [-d dir] [-w secs] tty             list the card
+    ./logget [-b 500000] [-d dir] [-w secs] tty -a          fetch every file
+    ./logget [-b 500000] [-d dir] [-w secs] tty NAME ...    fetch these
+
+  Each file goes to dir (. by default) under its own name. A local copy
+  shorter than the card's is picked up from where it stops, so an
+  interrupted transfer resumes, and fetching the log being written again
+  later adds the rows logged since; one the same size is left alone. Its
+  journal header blocks still say it is open until a fetch after it closes
+  starts over (delete the local copy).
+
+  A chunk that fails its CRC or arrives out of order is dropped, and the
+  rest is asked for again from the first byte missing once the reply ends
+  or nothing good has come for a second. A file that makes no progress in
+  RETRIES tries in a row is given up on.
+
+  Opening the port resets the Mega unless HUPCL is already off. logget
+  turns it off, so only its first run after the board is plugged in
+  restarts acquisition; the first request is repeated for up to -w
+  seconds (10 by default) while the sketch comes up.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#define FRAME_LIST 'L'
+#define FRAME_DATA 'C'
+#define FRAME_END  'E'
+#define STATUS_OK  0
+#define FILE_NOT_FOUND 1
+#define TIMEOUT_MS 1000
+#define RETRIES    10
+
+struct RemoteFile {
+  std::string name;
+  uint32_t size;
+};
+
+static int fd = -1;
+static std::vector<uint8_t> input;   // read but not yet split into frames
+static size_t inputPos = 0;
+static std::vector<uint8_t> pending; // the frame being gathered
+static uint64_t badFrames = 0;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static uint16_t crc16(const uint8_t *b, size_t n) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= (uint16_t)b[i] << 8;
+    for (int k = 0; k < 8; k++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static uint32_t get32(const uint8_t *b) {
+  return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static bool unstuff(const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+  out.clear();
+  size_t i = 0;
+  while (i < in.size()) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > in.size()) {
+      return false;
+    }
+    out.insert(out.end(), in.begin() + i, in.begin() + i + code - 1);
+    i += code - 1;
+    if (code < 0xFF && i < in.size()) {
+      out.push_back(0);
+    }
+  }
+  return true;
+}
+
+// drops whatever is left of the last reply, then sends f + request
+static bool send(const std::string &request) {
+  tcflush(fd, TCIFLUSH);
+  input.clear();
+  inputPos = 0;
+  pending.clear();
+  std::string line = "\nf" + request + "\n"; // the newline first ends any half-sent line
+  return write(fd, line.data(), line.size()) == (ssize_t)line.size();
+}
+
+// the payload of the next frame that passes its CRC, or false after
+// timeoutMs without one
+static bool receive(std::vector<uint8_t> &payload, int timeoutMs) {
+  double deadline = now() + timeoutMs / 1000.0;
+  for (;;) {
+    while (inputPos < input.size()) {
+      uint8_t c = input[inputPos++];
+      if (c != 0) {
+        pending.push_back(c);
+        continue;
+      }
+      if (pending.empty()) {
+        continue;
+      }
+      bool ok = unstuff(pending, payload) && payload.size() >= 3;
+      pending.clear();
+      if (ok) {
+        size_t n = payload.size() - 2;
+        ok = crc16(payload.data(), n) == (payload[n] | payload[n + 1] << 8);
+        payload.resize(n);
+      }
+      if (ok) {
+        return true;
+      }
+      badFrames++; // text the sketch printed before the reply lands here too
+    }
+    double left = deadline - now();
+    if (left <= 0) {
+      return false;
+    }
+    input.resize(4096);
+    inputPos = 0;
+    struct pollfd p = {fd, POLLIN, 0};
+    ssize_t n = 0;
+    if (poll(&p, 1, (int)(left * 1000) + 1) > 0) {
+      n = read(fd, input.data(), input.size());
+    }
+    input.resize(n > 0 ? n : 0);
+  }
+}
+
+// fl, repeated for up to waitSeconds until the sketch answers
+static bool list(std::vector<RemoteFile> &files, double waitSeconds) {
+  double giveUp = now() + waitSeconds;
+  std::vector<uint8_t> f;
+  do {
+    files.clear();
+    if (!send("l")) {
+      return false;
+    }
+    while (receive(f, TIMEOUT_MS)) {
+      if (f[0] == FRAME_LIST && f.size() >= 6) {
+        RemoteFile r;
+        r.size = get32(&f[1]);
+        r.name.assign((const char *)&f[5], strnlen((const char *)&f[5], f.size() - 5));
+        files.push_back(r);
+      }
+      else if (f[0] == FRAME_END && f.size() == 6) {
+        if (f[1] == STATUS_OK && get32(&f[2]) == files.size()) {
+          return true;
+        }
+        break;
+      }
+    }
+  } while (now() < giveUp);
+  return false;
+}
+
+static bool fetch(const RemoteFile &r, const std::string &dir) {
+  std::string path = dir + "/" + r.name;
+  int out = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (out < 0) {
+    fprintf(stderr, "can't write %s\n", path.c_str());
+    return false;
+  }
+  struct stat st;
+  fstat(out, &st);
+  uint32_t have = st.st_size;
+  if (have >= r.size) {
+    printf("%s: up to date, %u bytes\n", r.name.c_str(), have);
+    close(out);
+    return true;
+  }
+  uint32_t size = r.size;
+  uint32_t from = have;
+  double start = now();
+  int tries = 0;
+  std::vector<uint8_t> f;
+  while (have < size && tries < RETRIES) {
+    uint32_t before = have;
+    if (!send("g " + r.name + " " + std::to_string(have))) {
+      break;
+    }
+    // until the reply ends or stalls; a gap leaves have where it was
+    while (receive(f, TIMEOUT_MS)) {
+      if (f[0] == FRAME_DATA && f.size() > 5) {
+        if (get32(&f[1]) != have) {
+          continue;
+        }
+        size_t n = f.size() - 5;
+        if (pwrite(out, &f[5], n, have) != (ssize_t)n) {
+          fprintf(stderr, "%s: write failed\n", path.c_str());
+          close(out);
+          return false;
+        }
+        have += n;
+      }
+      else if (f[0] == FRAME_END && f.size() == 6) {
+        if (f[1] == FILE_NOT_FOUND) {
+          fprintf(stderr, "%s: not on the card\n", r.name.c_str());
+          close(out);
+          return false;
+        }
+        if (f[1] == STATUS_OK) {
+          size = get32(&f[2]); // the log being written has grown
+        }
+        break;
+      }
+    }
+    tries = have > before ? 0 : tries + 1;
+  }
+  close(out);
+  double secs = now() - start;
+  if (have < size) {
+    fprintf(stderr, "%s: gave up at %u of %u bytes\n", r.name.c_str(), have, size);
+    return false;
+  }
+  printf("%s: %u bytes, %u new in %.1f s (%.0f bytes/s)\n", r.name.c_str(), have,
+         have - from, secs, secs > 0 ? (have - from) / secs : 0.0);
+  return true;
+}
+
+static speed_t baudConstant(unsigned long baud) {
+  switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+  }
+  return B0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long baud = 500000;
+  std::string dir = ".";
+  double waitSeconds = 10;
+  bool all = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:d:w:a")) != -1) {
+    switch (opt) {
+      case 'b': baud = strtoul(optarg, 0, 10); break;
+      case 'd': dir = optarg; break;
+      case 'w': waitSeconds = atof(optarg); break;
+      case 'a': all = true; break;
+      default:
+        optind = argc + 1;
+        break;
+    }
+  }
+  if (optind >= argc || (all && optind != argc - 1)) {
+    fprintf(stderr, "usage: %s [-b baud] [-d dir] [-w secs] tty [-a | NAME ...]\n", argv[0]);
+    return 2;
+  }
+  const char *path = argv[optind];
+  speed_t speed = baudConstant(baud);
+  if (speed == B0) {
+    fprintf(stderr, "unsupported baud rate %lu\n", baud);
+    return 2;
+  }
+
+  fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~HUPCL; // so closing, and the next open, leave DTR alone
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+
+  std::vector<RemoteFile> files;
+  if (!list(files, waitSeconds)) {
+    fprintf(stderr, "no answer from %s\n", path);
+    return 1;
+  }
+  if (optind == argc - 1 && !all) {
+    for (size_t k = 0; k < files.size(); k++) {
+      printf("%10u  %s\n", files[k].size, files[k].name.c_str());
+    }
+    return 0;
+  }
+
+  std::vector<RemoteFile> wanted;
+  if (all) {
+    wanted = files;
+  }
+  for (int a = optind + 1; a < argc; a++) {
+    size_t k = 0;
+    while (k < files.size() && strcasecmp(files[k].name.c_str(), argv[a]) != 0) {
+      k++;
+    }
+    if (k == files.size()) {
+      fprintf(stderr, "%s: not on the card\n", argv[a]);
+      continue;
+    }
+    wanted.push_back(files[k]);
+  }
+  int failed = (int)(argc - optind - 1 - wanted.size()) * !all;
+  for (size_t k = 0; k < wanted.size(); k++) {
+    failed += !fetch(wanted[k], dir);
+  }
+  send("x");
+  if (badFrames > 0) {
+    printf("%llu bad frames\n", (unsigned long long)badFrames);
+  }
+  close(fd);
+  return failed > 0 ? 1 : 0;
+}
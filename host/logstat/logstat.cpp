@@ -0,0 +1,771 @@
+/*
+  logstat.cpp - Per-channel statistics over a season of logs, on all cores.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Build from the repository root:
+    g++ -std=gnu++11 -O2 -pthread host/logstat/logstat.cpp -o logstat
+  and run:
+    ./logstat [-j threads] [-q 5,50,95] [-c column_dir] [-x] YYMMDD-x.CSV ...
+
+  Each log is memory-mapped and cut into chunks at line boundaries, and a
+  pool of threads (one per core by default) parses the chunks. Journal
+  header lines ("#AJ1 ...") and the column header row are skipped, and so
+  are the erased bytes after the end of a log still being written. The
+  column header of each file names its channels, so files logged with
+  different channel tables can be mixed. Packed logs (YYMMDD-x.APK, see
+  acq/PackedLog.h) are recognised by their first data block and decoded a
+  block at a time, each chunk a whole number of blocks.
+
+  Dates are written unpadded, "2016815" for 2016-08-15, so "2016111" could
+  be January 11 or November 1. Of the readings with no leading zeros the
+  first on or after the previous row's date is taken, the file name's
+  YYMMDD standing in for the previous row at the start of a chunk.
+
+  Printed as CSV: for every file and channel, then for every channel over
+  all files, the count of numeric values, min, max, mean and the -q
+  percentiles (nearest rank). "nan" (a thermocouple fault) and rows with
+  the wrong number of fields are counted but left out.
+
+  With -c the rows of all files, in the order given, go to column_dir as
+  one little-endian array per column: time.u32 (unix time, seconds) and
+  <channel>.f32, NaN where a file has no such channel. columns.txt lists
+  the row count and each column. All values are held in memory, 4 bytes
+  each, until the end.
+
+  -x prints the rows instead, as the sketch writes them to a CSV, so
+  "logstat -x 160815-A.APK > 160815-A.CSV" unpacks a packed log.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHUNK_SIZE (4UL << 20)
+#define MAX_COLUMNS 64
+
+struct LogFile {
+  const char *path;
+  const char *data;
+  size_t size;       // up to the last byte that isn't erased
+  size_t mapped;
+  size_t bodyStart;  // after the column header row
+  bool packed;       // blocks from bodyStart on are packed blocks
+  int32_t nameDay;   // days since 1970 from YYMMDD in the name, or INT32_MIN
+  std::vector<int> columns; // global column of each value field
+};
+
+struct Chunk {
+  int file;
+  size_t begin;
+  size_t end;
+  uint32_t bad;
+  bool stopped; // met a block that isn't packed
+  std::vector<uint32_t> time;
+  std::vector<float> values; // row-major, the file's columns per row
+};
+
+static std::vector<std::string> columnNames;
+
+// DATES
+static int32_t daysFromCivil(int32_t y, int32_t m, int32_t d) {
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  int32_t yoe = y - era * 400;
+  int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static int daysInMonth(int32_t y, int32_t m) {
+  static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+  return m == 2 && leap ? 29 : days[m - 1];
+}
+
+// an unpadded number of n digits, -1 if it has a leading zero or isn't one
+static int32_t unpadded(const char *s, size_t n) {
+  if (n == 0 || (s[0] == '0' && n > 1)) {
+    return -1;
+  }
+  int32_t v = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (s[i] < '0' || s[i] > '9') {
+      return -1;
+    }
+    v = v * 10 + (s[i] - '0');
+  }
+  return v;
+}
+
+static bool parseDate(const char *s, size_t n, int32_t ref, int32_t *day) {
+  if (n < 6 || n > 8) {
+    return false;
+  }
+  int32_t y = unpadded(s, 4);
+  if (y < 0) {
+    return false;
+  }
+  bool found = false;
+  for (size_t monthLen = 1; monthLen <= 2; monthLen++) {
+    int32_t m = unpadded(s + 4, monthLen);
+    int32_t d = unpadded(s + 4 + monthLen, n - 4 - monthLen);
+    if (m < 1 || m > 12 || d < 1 || n - 4 - monthLen > 2 || d > daysInMonth(y, m)) {
+      continue;
+    }
+    int32_t c = daysFromCivil(y, m, d);
+    // prefer the nearest on or after ref, then the latest before it
+    if (!found || (c >= ref && (*day < ref || c < *day)) || (c < ref && *day < ref && c > *day)) {
+      *day = c;
+    }
+    found = true;
+  }
+  return found;
+}
+
+static bool parseTime(const char *s, size_t n, int32_t *seconds) {
+  int32_t part[3] = {0, 0, 0};
+  int p = 0;
+  size_t digits = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (s[i] == ':' && p < 2 && digits > 0) {
+      p++;
+      digits = 0;
+    }
+    else if (s[i] >= '0' && s[i] <= '9' && digits < 2) {
+      part[p] = part[p] * 10 + (s[i] - '0');
+      digits++;
+    }
+    else {
+      return false;
+    }
+  }
+  if (p != 2 || digits == 0 || part[0] > 23 || part[1] > 59 || part[2] > 59) {
+    return false;
+  }
+  *seconds = part[0] * 3600 + part[1] * 60 + part[2];
+  return true;
+}
+
+// SCANNER
+static inline uint64_t zeroBytes(uint64_t v) {
+  return (v - 0x0101010101010101ULL) & ~v & 0x8080808080808080ULL;
+}
+
+// the next tab or newline, eight bytes at a time; the lowest flagged byte
+// is exact even though the ones above it may not be
+static const char *nextDelimiter(const char *p, const char *end) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (end - p >= 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    uint64_t hit = zeroBytes(w ^ 0x0909090909090909ULL) | zeroBytes(w ^ 0x0A0A0A0A0A0A0A0AULL);
+    if (hit) {
+      return p + (__builtin_ctzll(hit) >> 3);
+    }
+    p += 8;
+  }
+#endif
+  while (p < end && *p != '\t' && *p != '\n') {
+    p++;
+  }
+  return p;
+}
+
+// what Print::print(float, 2) writes, and strtod() for anything else
+static float parseValue(const char *s, size_t n) {
+  const char *p = s;
+  const char *e = s + n;
+  bool negative = p < e && *p == '-';
+  if (negative) {
+    p++;
+  }
+  uint64_t whole = 0;
+  const char *digits = p;
+  while (p < e && *p >= '0' && *p <= '9' && p - digits < 18) {
+    whole = whole * 10 + (*p - '0');
+    p++;
+  }
+  double v = (double)whole;
+  if (p < e && *p == '.') {
+    p++;
+    double scale = 0.1;
+    while (p < e && *p >= '0' && *p <= '9') {
+      v += (*p - '0') * scale;
+      scale *= 0.1;
+      p++;
+    }
+  }
+  if (p == e && p > digits) {
+    return negative ? -v : v;
+  }
+  char buf[64];
+  if (n >= sizeof(buf)) {
+    return NAN;
+  }
+  memcpy(buf, s, n);
+  buf[n] = '\0';
+  char *stop;
+  v = strtod(buf, &stop);
+  return stop == buf + n && n > 0 ? (float)v : NAN;
+}
+
+// PACKED LOGS, as acq/PackedLog.h writes them
+#define PACKED_MAGIC       'P'
+#define PACKED_HEADER_SIZE 10
+
+static uint16_t packedUsed(const uint8_t *block, size_t avail) {
+  if (avail < PACKED_HEADER_SIZE || block[0] != PACKED_MAGIC || block[1] == 0
+      || block[1] > MAX_COLUMNS) {
+    return 0;
+  }
+  uint16_t used = block[2] | (block[3] << 8);
+  return used > PACKED_HEADER_SIZE && used <= 512 && used <= avail ? used : 0;
+}
+
+static bool varint(const uint8_t *b, uint16_t used, uint16_t *pos, uint32_t *v) {
+  *v = 0;
+  for (int shift = 0; shift < 35 && *pos < used; shift += 7) {
+    uint8_t c = b[(*pos)++];
+    *v |= (uint32_t)(c & 0x7F) << shift;
+    if (!(c & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// one block; false if it isn't a packed block, which ends the log
+static bool parseBlock(const uint8_t *b, size_t avail, size_t fields, Chunk &c) {
+  uint16_t used = packedUsed(b, avail);
+  if (used == 0) {
+    return false;
+  }
+  uint8_t channels = b[1];
+  uint16_t rows = b[4] | (b[5] << 8);
+  uint32_t time = b[6] | (b[7] << 8) | (b[8] << 16) | ((uint32_t)b[9] << 24);
+  int32_t prev[MAX_COLUMNS] = {0};
+  float row[MAX_COLUMNS];
+  uint16_t pos = PACKED_HEADER_SIZE;
+  uint16_t maskBytes = (channels + 7) / 8;
+  for (uint16_t r = 0; r < rows; r++) {
+    uint32_t dt;
+    if (!varint(b, used, &pos, &dt) || pos + maskBytes > used) {
+      c.bad += rows - r;
+      return true;
+    }
+    const uint8_t *mask = b + pos;
+    pos += maskBytes;
+    time += unzigzag(dt);
+    for (uint8_t k = 0; k < channels; k++) {
+      uint32_t code = 0;
+      if (mask[k >> 3] & (1 << (k & 7))) {
+        if (!varint(b, used, &pos, &code)) {
+          c.bad += rows - r;
+          return true;
+        }
+        if (code == 0) {
+          row[k] = NAN;
+          continue;
+        }
+        prev[k] += unzigzag(code);
+      }
+      row[k] = prev[k] / 100.0;
+    }
+    if (channels != fields) {
+      c.bad++;
+      continue;
+    }
+    c.time.push_back(time);
+    c.values.insert(c.values.end(), row, row + fields);
+  }
+  return true;
+}
+
+static void parseChunk(const LogFile &f, Chunk &c) {
+  if (f.packed) {
+    for (size_t at = c.begin; at < c.end; at += 512) {
+      if (!parseBlock((const uint8_t *)f.data + at, f.size - at, f.columns.size(), c)) {
+        c.stopped = true;
+        break;
+      }
+    }
+    return;
+  }
+  const char *p = f.data + c.begin;
+  const char *end = f.data + f.size;
+  const char *stop = f.data + c.end; // rows starting before here are ours
+  size_t fields = f.columns.size();
+  int32_t ref = f.nameDay;
+  float row[MAX_COLUMNS];
+  while (p < stop) {
+    const char *line = p;
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    bool complete = eol != 0;
+    if (!eol) {
+      eol = end;
+    }
+    p = eol + 1;
+    if (line[0] < '0' || line[0] > '9') {
+      continue; // journal headers, a repeated column header, blank lines
+    }
+    const char *lineEnd = eol;
+    if (lineEnd > line && lineEnd[-1] == '\r') {
+      lineEnd--;
+    }
+    const char *q = line;
+    const char *tab = nextDelimiter(q, lineEnd);
+    int32_t day = 0;
+    int32_t seconds = 0;
+    if (!complete || tab == lineEnd || !parseDate(q, tab - q, ref, &day)) {
+      c.bad++;
+      continue;
+    }
+    q = tab + 1;
+    tab = nextDelimiter(q, lineEnd);
+    if (!parseTime(q, tab - q, &seconds)) {
+      c.bad++;
+      continue;
+    }
+    size_t i = 0;
+    while (tab < lineEnd && i < fields) {
+      q = tab + 1;
+      tab = nextDelimiter(q, lineEnd);
+      row[i] = parseValue(q, tab - q);
+      i++;
+    }
+    if (i != fields || tab != lineEnd) {
+      c.bad++;
+      continue;
+    }
+    ref = day;
+    c.time.push_back((uint32_t)((int64_t)day * 86400 + seconds));
+    c.values.insert(c.values.end(), row, row + fields);
+  }
+}
+
+// FILES
+static int columnIndex(const std::string &name) {
+  for (size_t i = 0; i < columnNames.size(); i++) {
+    if (columnNames[i] == name) {
+      return i;
+    }
+  }
+  columnNames.push_back(name);
+  return columnNames.size() - 1;
+}
+
+static int32_t nameDay(const char *path) {
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  for (int i = 0; i < 6; i++) {
+    if (base[i] < '0' || base[i] > '9') {
+      return INT32_MIN;
+    }
+  }
+  int32_t y = 2000 + (base[0] - '0') * 10 + (base[1] - '0');
+  int32_t m = (base[2] - '0') * 10 + (base[3] - '0');
+  int32_t d = (base[4] - '0') * 10 + (base[5] - '0');
+  if (m < 1 || m > 12 || d < 1 || d > daysInMonth(y, m)) {
+    return INT32_MIN;
+  }
+  return daysFromCivil(y, m, d);
+}
+
+static bool openLog(LogFile &f) {
+  int fd = open(f.path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  f.mapped = st.st_size;
+  f.data = "";
+  if (f.mapped > 0) {
+    void *m = mmap(0, f.mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    madvise(m, f.mapped, MADV_SEQUENTIAL);
+    f.data = (const char *)m;
+  }
+  close(fd);
+
+  f.size = f.mapped;
+  f.nameDay = nameDay(f.path);
+
+  // the column header is the first line starting "date\t"
+  f.bodyStart = 0;
+  const char *p = f.data;
+  const char *end = f.data + f.size;
+  while (p < end) {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    if (!eol) {
+      eol = end;
+    }
+    if (eol - p > 5 && memcmp(p, "date\t", 5) == 0) {
+      const char *lineEnd = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+      const char *q = nextDelimiter(p + 5, lineEnd); // past "time"
+      while (q < lineEnd && f.columns.size() < MAX_COLUMNS) {
+        const char *name = q + 1;
+        q = nextDelimiter(name, lineEnd);
+        f.columns.push_back(columnIndex(std::string(name, q - name)));
+      }
+      f.bodyStart = eol + 1 - f.data;
+      break;
+    }
+    if (*p >= '0' && *p <= '9') {
+      break; // rows before any header: not one of ours
+    }
+    p = eol + 1;
+  }
+
+  size_t block = (f.bodyStart + 511) & ~(size_t)511;
+  f.packed = f.bodyStart > 0 && block < f.size
+             && packedUsed((const uint8_t *)f.data + block, f.size - block) > 0;
+  if (f.packed) {
+    f.bodyStart = block; // parsing stops at the first block that isn't packed
+  }
+  else {
+    // an open journaled log is a whole erased extent past its end
+    while (f.size > 0 && (f.data[f.size - 1] == '\0' || (uint8_t)f.data[f.size - 1] == 0xFF)) {
+      f.size--;
+    }
+  }
+  return true;
+}
+
+// STATISTICS
+struct Stats {
+  uint64_t count;
+  uint64_t nan;
+  double sum;
+  float min;
+  float max;
+  std::vector<float> sorted;
+};
+
+static void finish(Stats &s, std::vector<float> &values) {
+  s.count = 0;
+  s.nan = 0;
+  s.sum = 0;
+  s.min = INFINITY;
+  s.max = -INFINITY;
+  s.sorted.clear();
+  s.sorted.reserve(values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    float v = values[i];
+    if (isnan(v)) {
+      s.nan++;
+      continue;
+    }
+    s.count++;
+    s.sum += v;
+    s.min = std::min(s.min, v);
+    s.max = std::max(s.max, v);
+    s.sorted.push_back(v);
+  }
+  std::sort(s.sorted.begin(), s.sorted.end());
+}
+
+static void printStats(const char *file, const std::string &column, const Stats &s,
+                       const std::vector<double> &quantiles) {
+  printf("%s,%s,%llu,%llu", file, column.c_str(), (unsigned long long)s.count,
+         (unsigned long long)s.nan);
+  if (s.count == 0) {
+    printf(",,,");
+    for (size_t i = 0; i < quantiles.size(); i++) {
+      printf(",");
+    }
+    printf("\n");
+    return;
+  }
+  printf(",%.6g,%.6g,%.6g", s.min, s.max, s.sum / s.count);
+  for (size_t i = 0; i < quantiles.size(); i++) {
+    size_t rank = (size_t)ceil(quantiles[i] / 100 * s.count);
+    printf(",%.6g", s.sorted[rank > 0 ? rank - 1 : 0]);
+  }
+  printf("\n");
+}
+
+// runs work(i) for i in [0, n) on threads threads
+template <class Work>
+static void parallel(size_t n, unsigned threads, Work work) {
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; t++) {
+    pool.push_back(std::thread([&]() {
+      size_t i;
+      while ((i = next++) < n) {
+        work(i);
+      }
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); t++) {
+    pool[t].join();
+  }
+}
+
+static bool writeArray(const std::string &path, const void *data, size_t size) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  bool ok = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && ok;
+}
+
+// "A0[mV]" becomes A0_mV.f32
+static std::string columnFile(const std::string &name) {
+  std::string s;
+  for (size_t i = 0; i < name.size(); i++) {
+    char c = name[i];
+    if (isalnum((unsigned char)c) || c == '-') {
+      s += c;
+    }
+    else if (c == '[' || c == ' ' || c == '_') {
+      s += '_';
+    }
+  }
+  return s + ".f32";
+}
+
+static void civilFromDays(int32_t z, int32_t *y, int32_t *m, int32_t *d) {
+  z += 719468;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  int32_t doe = z - era * 146097;
+  int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int32_t mp = (5 * doy + 2) / 153;
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = yoe + era * 400 + (*m <= 2);
+}
+
+// the rows as the sketch prints them to a CSV, header first
+static void printRows(const LogFile &f, const Chunk &c, bool header) {
+  size_t fields = f.columns.size();
+  if (header) {
+    printf("date\ttime");
+    for (size_t k = 0; k < fields; k++) {
+      printf("\t%s", columnNames[f.columns[k]].c_str());
+    }
+    printf("\r\n");
+  }
+  for (size_t r = 0; r < c.time.size(); r++) {
+    int32_t y, m, d;
+    uint32_t t = c.time[r];
+    civilFromDays(t / 86400, &y, &m, &d);
+    printf("%d%d%d\t%u:%u:%u", y, m, d, t / 3600 % 24, t / 60 % 60, t % 60);
+    for (size_t k = 0; k < fields; k++) {
+      float v = c.values[r * fields + k];
+      if (isnan(v)) {
+        printf("\tnan");
+      }
+      else {
+        printf("\t%.2f", v);
+      }
+    }
+    printf("\r\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  std::vector<double> quantiles;
+  const char *columnDir = 0;
+  const char *q = "5,50,95";
+  bool unpack = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:q:c:x")) != -1) {
+    switch (opt) {
+      case 'j': threads = atoi(optarg); break;
+      case 'q': q = optarg; break;
+      case 'c': columnDir = optarg; break;
+      case 'x': unpack = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-j threads] [-q 5,50,95] [-c column_dir] [-x] log ...\n", argv[0]);
+        return 2;
+    }
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (char *p = (char *)q; *p; ) {
+    double v = strtod(p, &p);
+    if (v < 0 || v > 100) {
+      fprintf(stderr, "percentiles go from 0 to 100\n");
+      return 2;
+    }
+    quantiles.push_back(v);
+    while (*p == ',') {
+      p++;
+    }
+  }
+
+  std::vector<LogFile> files(argc - optind);
+  for (size_t i = 0; i < files.size(); i++) {
+    files[i].path = argv[optind + i];
+    if (!openLog(files[i])) {
+      fprintf(stderr, "can't read %s\n", files[i].path);
+      return 1;
+    }
+  }
+
+  std::vector<Chunk> chunks;
+  for (size_t i = 0; i < files.size(); i++) {
+    size_t at = files[i].bodyStart;
+    while (at < files[i].size) {
+      Chunk c;
+      c.file = i;
+      c.begin = at;
+      c.end = std::min(at + CHUNK_SIZE, files[i].size);
+      c.bad = 0;
+      c.stopped = false;
+      // the last row starting before the cut is ours; packed chunks are
+      // whole blocks already
+      if (c.end < files[i].size && !files[i].packed) {
+        const char *eol = (const char *)memchr(files[i].data + c.end, '\n', files[i].size - c.end);
+        c.end = eol ? eol - files[i].data + 1 : files[i].size;
+      }
+      chunks.push_back(c);
+      at = c.end;
+    }
+  }
+  parallel(chunks.size(), threads, [&](size_t i) {
+    parseChunk(files[chunks[i].file], chunks[i]);
+  });
+  // a packed log ends at its first bad block; what follows is old data
+  for (size_t i = 1; i < chunks.size(); i++) {
+    if (chunks[i].file == chunks[i - 1].file && chunks[i - 1].stopped) {
+      chunks[i].stopped = true;
+      chunks[i].bad = 0;
+      chunks[i].time.clear();
+      chunks[i].values.clear();
+    }
+  }
+  if (unpack) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+      printRows(files[chunks[i].file], chunks[i], i == 0 || chunks[i - 1].file != chunks[i].file);
+    }
+    return 0;
+  }
+
+  // gather columns, per file and over all of them
+  size_t ncols = columnNames.size();
+  size_t rows = 0;
+  std::vector<size_t> fileRows(files.size(), 0);
+  std::vector<uint32_t> fileBad(files.size(), 0);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    fileRows[chunks[i].file] += chunks[i].time.size();
+    fileBad[chunks[i].file] += chunks[i].bad;
+    rows += chunks[i].time.size();
+  }
+  std::vector<uint32_t> time;
+  time.reserve(rows);
+  std::vector<std::vector<float> > column(ncols);
+  std::vector<size_t> fileStart(files.size(), 0);
+  for (size_t i = 1; i < files.size(); i++) {
+    fileStart[i] = fileStart[i - 1] + fileRows[i - 1];
+  }
+  for (size_t c = 0; c < ncols; c++) {
+    column[c].assign(rows, NAN);
+  }
+  size_t row = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    const Chunk &c = chunks[i];
+    const LogFile &f = files[c.file];
+    size_t fields = f.columns.size();
+    for (size_t r = 0; r < c.time.size(); r++) {
+      for (size_t k = 0; k < fields; k++) {
+        column[f.columns[k]][row] = c.values[r * fields + k];
+      }
+      time.push_back(c.time[r]);
+      row++;
+    }
+    std::vector<uint32_t>().swap(chunks[i].time);
+    std::vector<float>().swap(chunks[i].values);
+  }
+
+  // one task per file and column, then one per column over all files
+  std::vector<Stats> fileStats(files.size() * ncols);
+  parallel(fileStats.size(), threads, [&](size_t i) {
+    size_t fi = i / ncols;
+    size_t c = i % ncols;
+    std::vector<float> values;
+    if (std::find(files[fi].columns.begin(), files[fi].columns.end(), (int)c)
+        != files[fi].columns.end()) {
+      values.assign(column[c].begin() + fileStart[fi],
+                    column[c].begin() + fileStart[fi] + fileRows[fi]);
+    }
+    finish(fileStats[i], values);
+  });
+  std::vector<Stats> totals(ncols);
+  parallel(ncols, threads, [&](size_t c) {
+    finish(totals[c], column[c]);
+  });
+
+  printf("file,channel,count,nan,min,max,mean");
+  for (size_t i = 0; i < quantiles.size(); i++) {
+    printf(",p%g", quantiles[i]);
+  }
+  printf("\n");
+  uint64_t bad = 0;
+  for (size_t fi = 0; fi < files.size(); fi++) {
+    for (size_t k = 0; k < files[fi].columns.size(); k++) {
+      int c = files[fi].columns[k];
+      printStats(files[fi].path, columnNames[c], fileStats[fi * ncols + c], quantiles);
+    }
+    if (fileBad[fi] > 0) {
+      fprintf(stderr, "%s: %lu bad rows\n", files[fi].path, (unsigned long)fileBad[fi]);
+    }
+    bad += fileBad[fi];
+  }
+  for (size_t c = 0; c < ncols; c++) {
+    printStats("*", columnNames[c], totals[c], quantiles);
+  }
+  fprintf(stderr, "%lu files, %lu rows, %llu bad, %u threads\n", (unsigned long)files.size(),
+          (unsigned long)rows, (unsigned long long)bad, threads);
+
+  if (columnDir) {
+    mkdir(columnDir, 0777);
+    std::string dir(columnDir);
+    bool ok = writeArray(dir + "/time.u32", time.data(), time.size() * 4);
+    std::string index = "rows " + std::to_string(rows) + "\ntime.u32 time\n";
+    for (size_t c = 0; c < ncols; c++) {
+      ok = ok && writeArray(dir + "/" + columnFile(columnNames[c]), column[c].data(), rows * 4);
+      index += columnFile(columnNames[c]) + " " + columnNames[c] + "\n";
+    }
+    ok = ok && writeArray(dir + "/columns.txt", index.data(), index.size());
+    if (!ok) {
+      fprintf(stderr, "can't write %s\n", columnDir);
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < files.size(); i++) {
+    if (files[i].mapped > 0) {
+      munmap((void *)files[i].data, files[i].mapped);
+    }
+  }
+  return 0;
+}
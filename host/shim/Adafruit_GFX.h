@@ -0,0 +1,14 @@
+/*
+  Adafruit_GFX.h - Host stand-in; the drawing calls the sketch uses are all
+  on the Adafruit_RA8875 stand-in.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+*/
+
+#ifndef Adafruit_GFX_h
+#define Adafruit_GFX_h
+
+#include "Arduino.h"
+
+#endif
@@ -0,0 +1,482 @@
+#include "Arduino.h"
+#include "Adafruit_RA8875.h"
+
+// SPI bytes of the driver's transactions: a command or data write is the
+// 0x80/0x00 prefix and the byte; a register write is both
+#define BUS_REG       4
+#define BUS_READ      4 // command, then the 0x40 prefix and the byte read
+#define BUS_RMW       6 // command, read, write back
+#define BUS_SHAPE     (12 * BUS_REG + BUS_READ) // 8 coordinate + 3 colour + DCR, one poll
+#define BUS_CIRCLE    (9 * BUS_REG + BUS_READ)  // 5 centre/radius + 3 colour + DCR
+#define BUS_PIXEL     (4 * BUS_REG + 2 + 3)     // cursor, MRWC, 0x00 + 2 colour bytes
+
+
+// 5x7 glyphs for 0x20-0x7E, one byte per column, bit 0 at the top
+static const uint8_t font5x7[95][5] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+  {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+  {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+  {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+  {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},
+  {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+  {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+  {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+  {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00},
+  {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+  {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E},
+  {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+  {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01},
+  {0x3E, 0x41, 0x49, 0x49, 0x7A}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+  {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+  {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+  {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+  {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+  {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+  {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+  {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},
+  {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+  {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, {0x38, 0x44, 0x44, 0x48, 0x7F},
+  {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E},
+  {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00},
+  {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},
+  {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0x7C, 0x14, 0x14, 0x14, 0x08},
+  {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+  {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+  {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C},
+  {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x7F, 0x00, 0x00},
+  {0x00, 0x41, 0x36, 0x08, 0x00}, {0x10, 0x08, 0x08, 0x10, 0x08}
+};
+
+// an RGB332 pixel as the panel shows it, each component widened by
+// repeating its bits
+static uint16_t widen332(uint8_t p) {
+  uint16_t r = p >> 5;
+  uint16_t g = (p >> 2) & 0x07;
+  uint16_t b = p & 0x03;
+  return (r << 2 | r >> 1) << 11 | (g << 3 | g) << 5 | (b << 3 | b << 1 | b >> 1);
+}
+
+static uint8_t to332(uint16_t c) {
+  return (c >> 8 & 0xE0) | (c >> 6 & 0x1C) | (c >> 3 & 0x03);
+}
+
+static const char *const callNames[RA8875_CALLS] = {
+  "drawPixel", "drawLine", "drawFastHLine", "drawFastVLine", "drawRect",
+  "fillRect", "fillScreen", "fillCircle", "textMode", "graphicsMode",
+  "textSetCursor", "textColor", "textEnlarge", "textWrite", "register", "other"
+};
+
+Adafruit_RA8875::Adafruit_RA8875(uint8_t cs, uint8_t rst) {
+  for (byte i = 0; i < 2; i++) {
+    _layer[i] = new uint16_t[RA8875_WIDTH * RA8875_HEIGHT];
+    memset(_layer[i], 0, RA8875_WIDTH * RA8875_HEIGHT * 2);
+  }
+  _fb = _layer[0];
+  memset(_reg, 0, sizeof(_reg));
+  _reg[RA8875_SYSR] = 0x0C; // 16 bits a pixel, as begin() leaves it
+  _command = 0;
+  _depth8 = false;
+  _dataHigh = true;
+  _data = 0;
+  _textMode = false;
+  _cursorX = 0;
+  _cursorY = 0;
+  _textFg = RA8875_WHITE;
+  _textBg = RA8875_BLACK;
+  _textTransparent = false;
+  _textScale = 0;
+  _busNanos = 0;
+  _busNanosOwed = 0;
+  resetStats();
+}
+
+Adafruit_RA8875::~Adafruit_RA8875() {
+  delete[] _layer[0];
+  delete[] _layer[1];
+}
+
+boolean Adafruit_RA8875::begin(enum RA8875sizes s) {
+  return s == RA8875_800x480;
+}
+
+void Adafruit_RA8875::bus(byte call, uint32_t spiBytes, uint32_t regWrites) {
+  RA8875CallStats &s = _stats[call];
+  s.calls++;
+  s.spiBytes += spiBytes;
+  s.regWrites += regWrites;
+  if (_busNanos > 0) {
+    _busNanosOwed += spiBytes * _busNanos;
+    delayMicroseconds(_busNanosOwed / 1000);
+    _busNanosOwed %= 1000;
+  }
+}
+
+void Adafruit_RA8875::resetStats() {
+  memset(_stats, 0, sizeof(_stats));
+}
+
+RA8875CallStats Adafruit_RA8875::totals() const {
+  RA8875CallStats t = {0, 0, 0};
+  for (byte i = 0; i < RA8875_CALLS; i++) {
+    t.calls += _stats[i].calls;
+    t.spiBytes += _stats[i].spiBytes;
+    t.regWrites += _stats[i].regWrites;
+  }
+  return t;
+}
+
+void Adafruit_RA8875::dumpStats(Print *pr) const {
+  pr->println("call,calls,spi_bytes,reg_writes");
+  for (byte i = 0; i < RA8875_CALLS; i++) {
+    pr->print(callNames[i]);
+    pr->print(',');
+    pr->print((unsigned long)_stats[i].calls);
+    pr->print(',');
+    pr->print((unsigned long)_stats[i].spiBytes);
+    pr->print(',');
+    pr->print((unsigned long)_stats[i].regWrites);
+    pr->println();
+  }
+}
+
+void Adafruit_RA8875::textMode() {
+  bus(RA8875_CALL_TEXT_MODE, 2 * BUS_RMW, 2); // MWCR0 text bit, FNCR0 ROM font
+  _textMode = true;
+}
+
+void Adafruit_RA8875::graphicsMode() {
+  bus(RA8875_CALL_GRAPHICS_MODE, BUS_RMW, 1);
+  _textMode = false;
+}
+
+void Adafruit_RA8875::textSetCursor(uint16_t x, uint16_t y) {
+  bus(RA8875_CALL_TEXT_CURSOR, 4 * BUS_REG, 4);
+  _cursorX = x;
+  _cursorY = y;
+}
+
+void Adafruit_RA8875::textColor(uint16_t foreColor, uint16_t bgColor) {
+  bus(RA8875_CALL_TEXT_COLOR, 6 * BUS_REG + BUS_RMW, 7);
+  _textFg = foreColor;
+  _textBg = bgColor;
+  _textTransparent = false;
+}
+
+void Adafruit_RA8875::textTransparent(uint16_t foreColor) {
+  bus(RA8875_CALL_TEXT_COLOR, 3 * BUS_REG + BUS_RMW, 4);
+  _textFg = foreColor;
+  _textTransparent = true;
+}
+
+void Adafruit_RA8875::textEnlarge(uint8_t scale) {
+  bus(RA8875_CALL_TEXT_ENLARGE, BUS_RMW, 1);
+  _textScale = scale > 3 ? 3 : scale;
+}
+
+void Adafruit_RA8875::textWrite(const char *buffer, uint16_t len) {
+  if (len == 0) {
+    len = strlen(buffer);
+  }
+  bus(RA8875_CALL_TEXT_WRITE, 2 + 2 * len, len); // MRWC, then one data write a character
+  for (uint16_t i = 0; i < len; i++) {
+    drawChar(buffer[i]);
+    // the driver waits after each enlarged character on the AVR
+    if (_textScale > 0 && _busNanos > 0) {
+      delay(1);
+    }
+  }
+}
+
+size_t Adafruit_RA8875::write(uint8_t b) {
+  textWrite((const char *)&b, 1);
+  return 1;
+}
+
+// the 5x7 glyph, rows doubled, at (1, 1) in the 8x16 cell
+void Adafruit_RA8875::drawChar(uint8_t c) {
+  uint8_t scale = _textScale + 1;
+  if (!_textTransparent) {
+    for (int16_t i = 0; i < 16 * scale; i++) {
+      span(_cursorX, _cursorX + 8 * scale - 1, _cursorY + i, _textBg);
+    }
+  }
+  if (c >= 0x20 && c <= 0x7E) {
+    const uint8_t *glyph = font5x7[c - 0x20];
+    for (uint8_t col = 0; col < 5; col++) {
+      for (uint8_t row = 0; row < 7; row++) {
+        if (glyph[col] & (1 << row)) {
+          int16_t x = _cursorX + (1 + col) * scale;
+          int16_t y = _cursorY + (1 + 2 * row) * scale;
+          for (uint8_t i = 0; i < 2 * scale; i++) {
+            span(x, x + scale - 1, y + i, _textFg);
+          }
+        }
+      }
+    }
+  }
+  _cursorX += 8 * scale;
+}
+
+void Adafruit_RA8875::span(int16_t x0, int16_t x1, int16_t y, uint16_t color) {
+  if (y < 0 || y >= RA8875_HEIGHT) {
+    return;
+  }
+  if (x0 < 0) {
+    x0 = 0;
+  }
+  if (x1 >= RA8875_WIDTH) {
+    x1 = RA8875_WIDTH - 1;
+  }
+  if (_depth8) {
+    color = widen332(to332(color));
+  }
+  uint16_t *p = _fb + (int32_t)y * RA8875_WIDTH;
+  for (int16_t x = x0; x <= x1; x++) {
+    p[x] = color;
+  }
+}
+
+void Adafruit_RA8875::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  bus(RA8875_CALL_PIXEL, BUS_PIXEL, 5);
+  if (!_depth8) {
+    span(x, x, y, color);
+    return;
+  }
+  // the driver sends two bytes, and at 8 bits each is a pixel
+  _reg[RA8875_CURH0] = x;
+  _reg[RA8875_CURH1] = x >> 8;
+  _reg[RA8875_CURV0] = y;
+  _reg[RA8875_CURV1] = y >> 8;
+  memoryWrite(color >> 8);
+  memoryWrite(color);
+}
+
+void Adafruit_RA8875::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  bus(RA8875_CALL_VLINE, BUS_SHAPE, 12);
+  for (int16_t i = 0; i < h; i++) {
+    span(x, x, y + i, color);
+  }
+}
+
+void Adafruit_RA8875::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  bus(RA8875_CALL_HLINE, BUS_SHAPE, 12);
+  span(x, x + w - 1, y, color);
+}
+
+void Adafruit_RA8875::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  bus(RA8875_CALL_LINE, BUS_SHAPE, 12);
+  int16_t dx = abs(x1 - x0);
+  int16_t dy = -abs(y1 - y0);
+  int16_t sx = x0 < x1 ? 1 : -1;
+  int16_t sy = y0 < y1 ? 1 : -1;
+  int16_t err = dx + dy;
+  for (;;) {
+    span(x0, x0, y0, color);
+    if (x0 == x1 && y0 == y1) {
+      break;
+    }
+    int16_t e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+void Adafruit_RA8875::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  bus(RA8875_CALL_RECT, BUS_SHAPE, 12);
+  span(x, x + w - 1, y, color);
+  span(x, x + w - 1, y + h - 1, color);
+  for (int16_t i = 1; i < h - 1; i++) {
+    span(x, x, y + i, color);
+    span(x + w - 1, x + w - 1, y + i, color);
+  }
+}
+
+void Adafruit_RA8875::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  bus(RA8875_CALL_FILL_RECT, BUS_SHAPE, 12);
+  for (int16_t i = 0; i < h; i++) {
+    span(x, x + w - 1, y + i, color);
+  }
+}
+
+void Adafruit_RA8875::fillScreen(uint16_t color) {
+  bus(RA8875_CALL_FILL_SCREEN, BUS_SHAPE, 12);
+  for (int16_t y = 0; y < RA8875_HEIGHT; y++) {
+    span(0, RA8875_WIDTH - 1, y, color);
+  }
+}
+
+void Adafruit_RA8875::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  bus(RA8875_CALL_FILL_CIRCLE, BUS_CIRCLE, 9);
+  for (int16_t dy = -r; dy <= r; dy++) {
+    int16_t dx = 0;
+    while ((int32_t)(dx + 1) * (dx + 1) + (int32_t)dy * dy <= (int32_t)r * r) {
+      dx++;
+    }
+    span(x0 - dx, x0 + dx, y0 + dy, color);
+  }
+}
+
+void Adafruit_RA8875::writeReg(uint8_t reg, uint8_t val) {
+  bus(RA8875_CALL_REGISTER, BUS_REG, 1);
+  setReg(reg, val);
+}
+
+uint8_t Adafruit_RA8875::readReg(uint8_t reg) {
+  bus(RA8875_CALL_REGISTER, BUS_READ, 0);
+  return _reg[reg];
+}
+
+void Adafruit_RA8875::writeCommand(uint8_t d) {
+  bus(RA8875_CALL_REGISTER, 2, 0);
+  _command = d;
+  _dataHigh = true;
+}
+
+void Adafruit_RA8875::writeData(uint8_t d) {
+  bus(RA8875_CALL_REGISTER, 2, 1);
+  if (_command == RA8875_MRWC) {
+    memoryWrite(d);
+  }
+  else {
+    setReg(_command, d);
+  }
+}
+
+// everything here finishes at once
+boolean Adafruit_RA8875::waitPoll(uint8_t r, uint8_t f) {
+  bus(RA8875_CALL_REGISTER, BUS_READ, 0);
+  return true;
+}
+
+void Adafruit_RA8875::setReg(uint8_t reg, uint8_t val) {
+  _reg[reg] = val;
+  if (reg == RA8875_SYSR) {
+    _depth8 = (val & 0x0C) == 0;
+  }
+  else if (reg == RA8875_DPCR || reg == RA8875_MWCR1) {
+    bool two = _reg[RA8875_DPCR] & 0x80;
+    _fb = _layer[two && (_reg[RA8875_MWCR1] & 0x01) ? 1 : 0];
+  }
+  else if (reg == RA8875_BECR0 && (val & 0x80)) {
+    bteMove();
+    _reg[RA8875_BECR0] &= ~0x80;
+  }
+}
+
+// a data byte at the memory cursor, which then moves right and wraps
+void Adafruit_RA8875::memoryWrite(uint8_t d) {
+  uint16_t color;
+  if (_depth8) {
+    color = widen332(d);
+  }
+  else if (_dataHigh) {
+    _data = d;
+    _dataHigh = false;
+    return;
+  }
+  else {
+    color = _data << 8 | d;
+    _dataHigh = true;
+  }
+  int16_t x = _reg[RA8875_CURH0] | (_reg[RA8875_CURH1] & 0x03) << 8;
+  int16_t y = _reg[RA8875_CURV0] | (_reg[RA8875_CURV1] & 0x01) << 8;
+  span(x, x, y, color);
+  x = x + 1;
+  if (x >= RA8875_WIDTH) {
+    x = 0;
+    y = (y + 1) % RA8875_HEIGHT;
+  }
+  _reg[RA8875_CURH0] = x;
+  _reg[RA8875_CURH1] = x >> 8;
+  _reg[RA8875_CURV0] = y;
+  _reg[RA8875_CURV1] = y >> 8;
+}
+
+// only the move in the positive direction with ROP S (BECR1 0xC2)
+void Adafruit_RA8875::bteMove() {
+  if (_reg[RA8875_BECR1] != 0xC2) {
+    return;
+  }
+  const uint8_t *r = _reg + RA8875_HSBE0;
+  int16_t sx = r[0] | (r[1] & 0x03) << 8;
+  int16_t sy = r[2] | (r[3] & 0x01) << 8;
+  int16_t dx = r[4] | (r[5] & 0x03) << 8;
+  int16_t dy = r[6] | (r[7] & 0x01) << 8;
+  int16_t w = r[8] | (r[9] & 0x03) << 8;
+  int16_t h = r[10] | (r[11] & 0x01) << 8;
+  bool two = _reg[RA8875_DPCR] & 0x80;
+  const uint16_t *src = _layer[two && (r[3] & 0x80) ? 1 : 0];
+  uint16_t *dst = _layer[two && (r[7] & 0x80) ? 1 : 0];
+  if (sx + w > RA8875_WIDTH || dx + w > RA8875_WIDTH
+      || sy + h > RA8875_HEIGHT || dy + h > RA8875_HEIGHT) {
+    return;
+  }
+  for (int16_t i = 0; i < h; i++) {
+    memmove(dst + (int32_t)(dy + i) * RA8875_WIDTH + dx,
+            src + (int32_t)(sy + i) * RA8875_WIDTH + sx, w * 2);
+  }
+}
+
+uint16_t Adafruit_RA8875::pixel(int16_t x, int16_t y) const {
+  if (x < 0 || x >= RA8875_WIDTH || y < 0 || y >= RA8875_HEIGHT) {
+    return 0;
+  }
+  int32_t i = (int32_t)y * RA8875_WIDTH + x;
+  if (!(_reg[RA8875_DPCR] & 0x80)) {
+    return _layer[0][i];
+  }
+  uint8_t mode = _reg[RA8875_LTPR0] & 0x07;
+  if (mode == 1) {
+    return _layer[1][i];
+  }
+  if (mode == 3) {
+    // BGTR holds RGB565 components, as the foreground colour registers do
+    const uint8_t *t = _reg + RA8875_BGTR0;
+    uint16_t key = (t[0] & 0x1F) << 11 | (t[1] & 0x3F) << 5 | (t[2] & 0x1F);
+    bool see = _depth8 ? to332(_layer[0][i]) == to332(key) : _layer[0][i] == key;
+    return see ? _layer[1][i] : _layer[0][i];
+  }
+  return _layer[0][i];
+}
+
+// RGB565 widened to 8 bits a channel by repeating the top bits
+bool Adafruit_RA8875::snapshot(const char *path) const {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", RA8875_WIDTH, RA8875_HEIGHT);
+  uint8_t row[RA8875_WIDTH * 3];
+  for (int16_t y = 0; y < RA8875_HEIGHT; y++) {
+    for (int16_t x = 0; x < RA8875_WIDTH; x++) {
+      uint16_t p = pixel(x, y);
+      uint8_t r = p >> 11;
+      uint8_t g = (p >> 5) & 0x3F;
+      uint8_t b = p & 0x1F;
+      row[3 * x] = (r << 3) | (r >> 2);
+      row[3 * x + 1] = (g << 2) | (g >> 4);
+      row[3 * x + 2] = (b << 3) | (b >> 2);
+    }
+    fwrite(row, 1, sizeof(row), f);
+  }
+  return fclose(f) == 0;
+}
+
+// FNV-1a over the pixels, low byte first
+uint32_t Adafruit_RA8875::checksum() const {
+  uint32_t h = 2166136261UL;
+  for (int16_t y = 0; y < RA8875_HEIGHT; y++) {
+    for (int16_t x = 0; x < RA8875_WIDTH; x++) {
+      uint16_t p = pixel(x, y);
+      h = (h ^ (p & 0xFF)) * 16777619UL;
+      h = (h ^ (p >> 8)) * 16777619UL;
+    }
+  }
+  return h;
+}
@@ -0,0 +1,174 @@
+/*
+  Adafruit_RA8875.h - Host stand-in for the RA8875 driver, drawing into memory.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Keeps the 800x480 RGB565 display memory and applies the calls the sketch
+  makes the way the controller would: lines and circles inclusive of their
+  end points, text from the cursor in 8x16 cells scaled by textEnlarge(),
+  the cursor advancing after each character. The glyphs are a 5x7 font
+  doubled in height, not the controller's ROM font, so compare snapshots
+  with snapshots, not with photos of the panel.
+
+  Each call also counts the SPI bytes and register writes the Adafruit
+  driver would have sent for it (the busy-flag wait after a shape counted
+  as one status read), by call. print() goes through write(), one
+  character per textWrite(), as it does on the Mega. With setBusTime()
+  each byte also advances the simulated clock, so loop timing includes
+  the display.
+
+  The register interface (writeReg() and the rest of the driver's low-level
+  calls) is followed for what acq/LabelCache.h uses: colour depth (SYSR),
+  one or two layers (DPCR), the layer drawn to (MWCR1), the layer shown
+  (LTPR0, layer 1 or 2 alone, or layer 1 showing layer 2 through its
+  pixels of the BGTR colour), display memory writes at the memory cursor
+  (MRWC) and the BTE move with the source ROP. At 8 bits a pixel colours are cut to RGB332 and
+  shown widened back by repeating bits, and a memory data write is one
+  pixel, so drawPixel() writes two as it does on the controller.
+
+  snapshot() writes what is shown as a binary PPM, and checksum() hashes
+  it, so two runs can be compared exactly.
+*/
+
+#ifndef Adafruit_RA8875_h
+#define Adafruit_RA8875_h
+
+#include "Arduino.h"
+#include "Adafruit_GFX.h"
+
+#define RA8875_BLACK   0x0000
+#define RA8875_BLUE    0x001F
+#define RA8875_RED     0xF800
+#define RA8875_GREEN   0x07E0
+#define RA8875_CYAN    0x07FF
+#define RA8875_MAGENTA 0xF81F
+#define RA8875_YELLOW  0xFFE0
+#define RA8875_WHITE   0xFFFF
+
+#define RA8875_PWM_CLK_DIV1024 0x0A
+
+#define RA8875_WIDTH  800
+#define RA8875_HEIGHT 480
+
+// registers the stand-in follows
+#define RA8875_SYSR   0x10
+#define RA8875_DPCR   0x20
+#define RA8875_MWCR1  0x41
+#define RA8875_CURH0  0x46
+#define RA8875_CURH1  0x47
+#define RA8875_CURV0  0x48
+#define RA8875_CURV1  0x49
+#define RA8875_BECR0  0x50
+#define RA8875_BECR1  0x51
+#define RA8875_LTPR0  0x52
+#define RA8875_HSBE0  0x54
+#define RA8875_BGTR0  0x67
+#define RA8875_MRWC   0x02
+
+enum RA8875sizes { RA8875_480x272, RA8875_800x480 };
+
+// the calls counted separately
+enum RA8875Call {
+  RA8875_CALL_PIXEL,
+  RA8875_CALL_LINE,
+  RA8875_CALL_HLINE,
+  RA8875_CALL_VLINE,
+  RA8875_CALL_RECT,
+  RA8875_CALL_FILL_RECT,
+  RA8875_CALL_FILL_SCREEN,
+  RA8875_CALL_FILL_CIRCLE,
+  RA8875_CALL_TEXT_MODE,
+  RA8875_CALL_GRAPHICS_MODE,
+  RA8875_CALL_TEXT_CURSOR,
+  RA8875_CALL_TEXT_COLOR,
+  RA8875_CALL_TEXT_ENLARGE,
+  RA8875_CALL_TEXT_WRITE,
+  RA8875_CALL_REGISTER,
+  RA8875_CALL_OTHER,
+  RA8875_CALLS
+};
+
+struct RA8875CallStats {
+  uint32_t calls;
+  uint32_t spiBytes;
+  uint32_t regWrites; // register and display memory data writes
+};
+
+class Adafruit_RA8875 : public Print {
+  public:
+    Adafruit_RA8875(uint8_t cs, uint8_t rst);
+    ~Adafruit_RA8875();
+
+    boolean begin(enum RA8875sizes s);
+    void displayOn(boolean on) { bus(RA8875_CALL_OTHER, 4, 1); }
+    void GPIOX(boolean on) { bus(RA8875_CALL_OTHER, 4, 1); }
+    void PWM1config(boolean on, uint8_t clock) { bus(RA8875_CALL_OTHER, 4, 1); }
+    void PWM1out(uint8_t p) { bus(RA8875_CALL_OTHER, 4, 1); }
+    uint16_t width() { return RA8875_WIDTH; }
+    uint16_t height() { return RA8875_HEIGHT; }
+
+    void textMode();
+    void graphicsMode();
+    void textSetCursor(uint16_t x, uint16_t y);
+    void textColor(uint16_t foreColor, uint16_t bgColor);
+    void textTransparent(uint16_t foreColor);
+    void textEnlarge(uint8_t scale);
+    void textWrite(const char *buffer, uint16_t len = 0);
+    size_t write(uint8_t b);
+    using Print::write;
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void fillScreen(uint16_t color);
+    void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+
+    void writeReg(uint8_t reg, uint8_t val);
+    uint8_t readReg(uint8_t reg);
+    void writeCommand(uint8_t d);
+    void writeData(uint8_t d);
+    boolean waitPoll(uint8_t r, uint8_t f);
+
+    // host only; pixel() is what is shown
+    uint16_t pixel(int16_t x, int16_t y) const;
+    bool snapshot(const char *path) const;
+    uint32_t checksum() const;
+    const RA8875CallStats &stats(byte call) const { return _stats[call]; }
+    RA8875CallStats totals() const;
+    void resetStats();
+    // CSV: call,calls,spi_bytes,reg_writes
+    void dumpStats(Print *pr) const;
+    // simulated time per SPI byte, 0 (the default) for none
+    void setBusTime(uint16_t nanosPerByte) { _busNanos = nanosPerByte; }
+  private:
+    void bus(byte call, uint32_t spiBytes, uint32_t regWrites);
+    void span(int16_t x0, int16_t x1, int16_t y, uint16_t color);
+    void drawChar(uint8_t c);
+    void setReg(uint8_t reg, uint8_t val);
+    void memoryWrite(uint8_t d);
+    void bteMove();
+
+    uint16_t *_layer[2];
+    uint16_t *_fb; // the layer drawn to
+    uint8_t _reg[256];
+    uint8_t _command;
+    bool _depth8;
+    bool _dataHigh; // at 16 bits a pixel, the first byte of a pixel's two
+    uint16_t _data;
+    bool _textMode;
+    uint16_t _cursorX;
+    uint16_t _cursorY;
+    uint16_t _textFg;
+    uint16_t _textBg;
+    bool _textTransparent;
+    uint8_t _textScale;
+    RA8875CallStats _stats[RA8875_CALLS];
+    uint16_t _busNanos;
+    uint32_t _busNanosOwed;
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+  Arduino.h - Host stand-in for the parts of the Arduino core arduinacq uses.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Lets the acq/ sources build with g++ on Linux for benchmarks and the
+  simulator. Print formats numbers exactly like the AVR core (floats are
+  printed with 32-bit float arithmetic, as double is float on the AVR) so
+  host output can be compared byte for byte with card logs.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ctype.h>
+
+typedef uint8_t byte;
+typedef uint16_t word;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// Mega analog pin numbering
+#define A0 54
+#define SS 53
+
+#define F_CPU 16000000UL
+
+// SdBaseFile.h defines these too when it is included first
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef PSTR
+#define PSTR(s) (s)
+#endif
+#define F(s) (s)
+#ifndef pgm_read_byte
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#endif
+// at the pointer's own type, so the PROGMEM tables of strings read back
+// whole pointers on a 64-bit host; replaces SdBaseFile.h's 16-bit one
+#undef pgm_read_word
+#define pgm_read_word(p) (*(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_float(p) (*(const float *)(p))
+
+#define _BV(bit) (1 << (bit))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+inline word makeWord(uint8_t h, uint8_t l) { return (h << 8) | l; }
+#define word(...) makeWord(__VA_ARGS__)
+
+class __FlashStringHelper;
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n) {
+      size_t r = 0;
+      while (n--) {
+        r += write(*buf++);
+      }
+      return r;
+    }
+    size_t write(const char *s) {
+      return write((const uint8_t *)s, strlen(s));
+    }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC) {
+      if (base == DEC && n < 0) {
+        return print('-') + printNumber(-(unsigned long)n, 10);
+      }
+      return printNumber((unsigned long)n, base);
+    }
+    size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(double n, int digits = 2) { return printFloat(n, digits); }
+
+    size_t println() { return write("\r\n"); }
+    template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <class T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+
+  private:
+    size_t printNumber(unsigned long n, uint8_t base) {
+      char buf[8 * sizeof(long) + 1];
+      char *str = &buf[sizeof(buf) - 1];
+      *str = '\0';
+      if (base < 2) {
+        base = 10;
+      }
+      do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+      } while (n);
+      return write(str);
+    }
+    // same algorithm as the AVR core, in float because AVR double is float
+    size_t printFloat(double number, uint8_t digits) {
+      float x = (float)number;
+      size_t n = 0;
+      if (isnan(x)) return print("nan");
+      if (isinf(x)) return print("inf");
+      if (x > 4294967040.0f) return print("ovf");
+      if (x < -4294967040.0f) return print("ovf");
+      if (x < 0.0f) {
+        n += print('-');
+        x = -x;
+      }
+      float rounding = 0.5f;
+      for (uint8_t i = 0; i < digits; ++i) {
+        rounding /= 10.0f;
+      }
+      x += rounding;
+      unsigned long int_part = (unsigned long)x;
+      float remainder = x - (float)int_part;
+      n += print(int_part);
+      if (digits > 0) {
+        n += print('.');
+      }
+      while (digits-- > 0) {
+        remainder *= 10.0f;
+        unsigned int toPrint = (unsigned int)remainder;
+        n += print(toPrint);
+        remainder -= toPrint;
+      }
+      return n;
+    }
+};
+
+// Everything below is only declared here; the simulator (host/sim) defines
+// it, with millis() and micros() running on a simulated clock.
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {}
+    operator bool() { return true; }
+    size_t write(uint8_t c);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+    int availableForWrite();
+};
+
+extern HardwareSerial Serial;
+
+// only ever constructed empty by the sketch
+class String {
+  public:
+    String(const char * = "") {}
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+
+inline void interrupts() {}
+inline void noInterrupts() {}
+#define cli() noInterrupts()
+#define sei() interrupts()
+#define ISR(vector) void vector##_isr()
+
+// the Mega registers AdcSampler and MAX31855Pair use directly
+extern uint8_t SREG;
+extern volatile uint8_t ADCSRA, ADCSRB, ADMUX;
+extern volatile uint16_t ADC;
+#define ADEN  7
+#define ADSC  6
+#define ADIE  3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS0 6
+#define MUX5  3
+// and the USART1 FrameStream sends on
+extern volatile uint8_t UCSR1A, UCSR1B, UCSR1C, UDR1;
+extern volatile uint16_t UBRR1;
+#define U2X1   1
+#define UCSZ10 1
+#define UCSZ11 2
+#define TXEN1  3
+#define UDRIE1 5
+
+extern volatile uint8_t sim_ports[16];
+#define digitalPinToPort(pin) ((pin) >> 3 & 0x0F)
+#define digitalPinToBitMask(pin) (1 << ((pin) & 7))
+#define portOutputRegister(port) (&sim_ports[port])
+#define portInputRegister(port) (&sim_ports[port])
+
+#endif
@@ -0,0 +1,53 @@
+/*
+  RTClib.h - Host stand-in for the JeeLabs/Adafruit RTClib.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  DateTime is the library's, same fields and date arithmetic (2000-2099).
+  RTC_DS1307 counts from whatever adjust() last set, 2016-08-15 00:00:00 by
+  default, on the simulated millis() clock, so a run without a trace still
+  has repeatable timestamps.
+*/
+
+#ifndef RTClib_h
+#define RTClib_h
+
+#include "Arduino.h"
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+class DateTime {
+  public:
+    DateTime(uint32_t t = 0);
+    DateTime(uint16_t year, uint8_t month, uint8_t day,
+             uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+    // __DATE__ and __TIME__ format, "Aug 15 2016" and "12:34:56"
+    DateTime(const char *date, const char *time);
+    uint16_t year() const { return 2000 + yOff; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+    uint8_t dayOfWeek() const;
+    // seconds since 2000-01-01
+    long secondstime() const;
+    uint32_t unixtime() const;
+  protected:
+    uint8_t yOff, m, d, hh, mm, ss;
+};
+
+class RTC_DS1307 {
+  public:
+    RTC_DS1307();
+    uint8_t begin() { return 1; }
+    uint8_t isrunning() { return 1; }
+    void adjust(const DateTime &dt);
+    DateTime now();
+  private:
+    uint32_t _base;       // unixtime at _baseMillis
+    unsigned long _baseMillis;
+};
+
+#endif
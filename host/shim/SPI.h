@@ -0,0 +1,13 @@
+/*
+  SPI.h - Host stand-in; nothing in the sketch talks SPI through it directly.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+*/
+
+#ifndef SPI_h
+#define SPI_h
+
+#include "Arduino.h"
+
+#endif
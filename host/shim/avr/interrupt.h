@@ -0,0 +1 @@
+// host stand-in, see Arduino.h
@@ -0,0 +1,396 @@
+#include "Arduino.h"
+#include <Sd2Card.h>
+#include "SimCard.h"
+
+// multi-block transfer in progress
+#define SIM_CARD_IDLE  0
+#define SIM_CARD_READ  1
+#define SIM_CARD_WRITE 2
+
+// error codes for misuse, above the SD_CARD_ERROR_* range
+#define SIM_CARD_ERROR_IO    0xF0
+#define SIM_CARD_ERROR_STATE 0xF1
+#define SIM_CARD_ERROR_RANGE 0xF2
+
+static FILE *image = 0;
+static uint32_t imageBlocks = 0;
+static uint8_t state = SIM_CARD_IDLE;
+static uint32_t nextBlock = 0;
+static uint8_t fault = SIM_CARD_FAULT_READ;
+static uint32_t faultIn = 0; // blocks until the armed fault, 0 for none
+static bool power = true;
+
+SimCardTiming SimCard::timing = {0, 0, 0};
+uint32_t SimCard::faults = 0;
+uint32_t SimCard::commands = 0;
+uint32_t SimCard::blocksRead = 0;
+uint32_t SimCard::blocksWritten = 0;
+
+bool SimCard::open(const char *path) {
+  close();
+  image = fopen(path, "r+b");
+  if (!image) {
+    return false;
+  }
+  fseek(image, 0, SEEK_END);
+  imageBlocks = ftell(image) / 512;
+  state = SIM_CARD_IDLE;
+  power = true;
+  return true;
+}
+
+void SimCard::close() {
+  if (image) {
+    fclose(image);
+    image = 0;
+  }
+}
+
+void SimCard::failAfter(uint8_t type, uint32_t count) {
+  fault = type;
+  faultIn = count;
+}
+
+bool SimCard::powerLost() {
+  return !power;
+}
+
+static bool formatFat32(const char *path, uint32_t total);
+
+bool SimCard::format(const char *path, uint16_t megabytes, uint8_t fatType) {
+  uint32_t total = (uint32_t)megabytes * 2048;
+  if (fatType == 32) {
+    return formatFat32(path, total);
+  }
+  uint16_t reserved = 1;
+  uint16_t rootEntries = 512;
+  uint8_t perCluster = 1;
+  while (total / perCluster > 65524) {
+    perCluster *= 2;
+  }
+  uint32_t clusters = (total - reserved - rootEntries / 16) / perCluster;
+  uint16_t fatBlocks = ((clusters + 2) * 2 + 511) / 512;
+  if (clusters < 4085 || perCluster > 64) {
+    return false;
+  }
+
+  uint8_t b[512];
+  memset(b, 0, sizeof(b));
+  memcpy(b, "\xEB\x3C\x90" "MSWIN4.1", 11);
+  b[11] = 0x00; // 512 bytes per sector
+  b[12] = 0x02;
+  b[13] = perCluster;
+  b[14] = reserved;
+  b[16] = 2; // FATs
+  b[17] = rootEntries & 0xFF;
+  b[18] = rootEntries >> 8;
+  if (total < 65536) {
+    b[19] = total & 0xFF;
+    b[20] = total >> 8;
+  }
+  b[21] = 0xF8; // fixed disk
+  b[22] = fatBlocks & 0xFF;
+  b[23] = fatBlocks >> 8;
+  b[24] = 32; // sectors per track
+  b[26] = 64; // heads
+  if (total >= 65536) {
+    memcpy(b + 32, &total, 4);
+  }
+  b[36] = 0x80;
+  b[38] = 0x29;
+  memcpy(b + 39, "\x16\x08\x15\x20", 4); // volume id
+  memcpy(b + 43, "NO NAME    FAT16   ", 19);
+  b[510] = 0x55;
+  b[511] = 0xAA;
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return false;
+  }
+  // sparse, so the FATs and root directory read back as zeros
+  fseek(f, (long)total * 512 - 1, SEEK_SET);
+  fputc(0, f);
+  fseek(f, 0, SEEK_SET);
+  fwrite(b, 1, 512, f);
+  const uint8_t fatStart[4] = {0xF8, 0xFF, 0xFF, 0xFF};
+  for (uint8_t i = 0; i < 2; i++) {
+    fseek(f, (long)(reserved + i * fatBlocks) * 512, SEEK_SET);
+    fwrite(fatStart, 1, 4, f);
+  }
+  return fclose(f) == 0;
+}
+
+// cluster sizes as the SD Association's formatter picks them
+static bool formatFat32(const char *path, uint32_t total) {
+  uint16_t reserved = 32;
+  uint8_t perCluster = total <= 532480 ? 1 : total <= 16777216 ? 8 : total <= 33554432 ? 16 : 32;
+  uint32_t clusters = (total - reserved) / perCluster;
+  uint32_t fatBlocks = ((clusters + 2) * 4 + 511) / 512;
+  clusters = (total - reserved - 2 * fatBlocks) / perCluster;
+  if (clusters < 65525) {
+    return false;
+  }
+
+  uint8_t b[512];
+  memset(b, 0, sizeof(b));
+  memcpy(b, "\xEB\x58\x90" "MSWIN4.1", 11);
+  b[11] = 0x00; // 512 bytes per sector
+  b[12] = 0x02;
+  b[13] = perCluster;
+  b[14] = reserved;
+  b[16] = 2; // FATs
+  b[21] = 0xF8; // fixed disk
+  b[24] = 63; // sectors per track
+  b[26] = 255; // heads
+  memcpy(b + 32, &total, 4);
+  memcpy(b + 36, &fatBlocks, 4);
+  b[44] = 2; // root directory cluster
+  b[48] = 1; // FSInfo block
+  b[50] = 6; // backup boot block
+  b[64] = 0x80;
+  b[66] = 0x29;
+  memcpy(b + 67, "\x16\x08\x15\x20", 4); // volume id
+  memcpy(b + 71, "NO NAME    FAT32   ", 19);
+  b[510] = 0x55;
+  b[511] = 0xAA;
+
+  // free count and next free cluster unknown, left for the host to work out
+  uint8_t info[512];
+  memset(info, 0, sizeof(info));
+  memcpy(info, "RRaA", 4);
+  memcpy(info + 484, "rrAa", 4);
+  memset(info + 488, 0xFF, 8);
+  info[510] = 0x55;
+  info[511] = 0xAA;
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return false;
+  }
+  fseek(f, (long)total * 512 - 1, SEEK_SET);
+  fputc(0, f);
+  for (uint8_t copy = 0; copy < 2; copy++) {
+    fseek(f, (long)copy * 6 * 512, SEEK_SET);
+    fwrite(b, 1, 512, f);
+    fwrite(info, 1, 512, f);
+  }
+  // media, end of chain, and the root directory's single cluster
+  const uint8_t fatStart[12] = {0xF8, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF, 0xFF, 0x0F,
+                                0xFF, 0xFF, 0xFF, 0x0F};
+  for (uint8_t i = 0; i < 2; i++) {
+    fseek(f, (long)(reserved + i * fatBlocks) * 512, SEEK_SET);
+    fwrite(fatStart, 1, sizeof(fatStart), f);
+  }
+  return fclose(f) == 0;
+}
+
+static bool seekBlock(Sd2Card *card, uint32_t block) {
+  if (block >= imageBlocks) {
+    card->error(SIM_CARD_ERROR_RANGE);
+    return false;
+  }
+  fseek(image, (long)block * 512, SEEK_SET);
+  return true;
+}
+
+// counts down the armed fault on every block of its direction
+static bool faultDue(uint8_t op) {
+  if (faultIn == 0 || (fault == SIM_CARD_FAULT_READ) != (op == SIM_CARD_FAULT_READ)) {
+    return false;
+  }
+  faultIn--;
+  if (faultIn > 0) {
+    return false;
+  }
+  SimCard::faults++;
+  if (fault == SIM_CARD_FAULT_POWER) {
+    power = false;
+  }
+  return true;
+}
+
+static bool command(Sd2Card *card, uint8_t count, uint8_t errorCode) {
+  if (!power) {
+    card->error(errorCode);
+    return false;
+  }
+  SimCard::commands += count;
+  delayMicroseconds(count * SimCard::timing.commandMicros);
+  return true;
+}
+
+static bool readOne(Sd2Card *card, uint32_t block, uint8_t *dst) {
+  if (!power || faultDue(SIM_CARD_FAULT_READ)) {
+    card->error(SD_CARD_ERROR_READ);
+    return false;
+  }
+  if (!seekBlock(card, block)) {
+    return false;
+  }
+  if (fread(dst, 1, 512, image) != 512) {
+    card->error(SIM_CARD_ERROR_IO);
+    return false;
+  }
+  delayMicroseconds(SimCard::timing.blockMicros);
+  SimCard::blocksRead++;
+  return true;
+}
+
+static bool writeOne(Sd2Card *card, uint32_t block, const uint8_t *src) {
+  if (!power || faultDue(SIM_CARD_FAULT_WRITE)) {
+    card->error(SD_CARD_ERROR_WRITE);
+    return false;
+  }
+  if (!seekBlock(card, block)) {
+    return false;
+  }
+  if (fwrite(src, 1, 512, image) != 512) {
+    card->error(SIM_CARD_ERROR_IO);
+    return false;
+  }
+  delayMicroseconds(SimCard::timing.blockMicros + SimCard::timing.busyMicros);
+  SimCard::blocksWritten++;
+  return true;
+}
+
+bool Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
+  chipSelectPin_ = chipSelectPin;
+  spiRate_ = sckRateID;
+  status_ = 0;
+  if (!image || !power) {
+    error(SD_CARD_ERROR_CMD0);
+    return false;
+  }
+  errorCode_ = 0;
+  type(SD_CARD_TYPE_SDHC);
+  return true;
+}
+
+uint32_t Sd2Card::cardSize() {
+  return imageBlocks;
+}
+
+bool Sd2Card::setSckRate(uint8_t sckRateID) {
+  spiRate_ = sckRateID;
+  return true;
+}
+
+bool Sd2Card::eraseSingleBlockEnable() {
+  return true;
+}
+
+// erased blocks read back as zeros, like most cards
+bool Sd2Card::erase(uint32_t firstBlock, uint32_t lastBlock) {
+  static const uint8_t zero[512] = {0};
+  if (!command(this, 3, SD_CARD_ERROR_ERASE)) {
+    return false;
+  }
+  if (!seekBlock(this, lastBlock) || !seekBlock(this, firstBlock)) {
+    return false;
+  }
+  for (uint32_t b = firstBlock; b <= lastBlock; b++) {
+    if (fwrite(zero, 1, 512, image) != 512) {
+      error(SIM_CARD_ERROR_IO);
+      return false;
+    }
+  }
+  delayMicroseconds(SimCard::timing.busyMicros);
+  return true;
+}
+
+bool Sd2Card::readRegister(uint8_t cmd, void* buf) {
+  if (!command(this, 1, SD_CARD_ERROR_READ_REG)) {
+    return false;
+  }
+  memset(buf, 0, 16);
+  return true;
+}
+
+bool Sd2Card::readBlock(uint32_t block, uint8_t* dst) {
+  if (state != SIM_CARD_IDLE) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  return command(this, 1, SD_CARD_ERROR_CMD17) && readOne(this, block, dst);
+}
+
+bool Sd2Card::readStart(uint32_t blockNumber) {
+  if (state != SIM_CARD_IDLE) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  if (!command(this, 1, SD_CARD_ERROR_CMD18)) {
+    return false;
+  }
+  state = SIM_CARD_READ;
+  nextBlock = blockNumber;
+  return true;
+}
+
+bool Sd2Card::readData(uint8_t *dst) {
+  if (state != SIM_CARD_READ) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  if (!readOne(this, nextBlock, dst)) {
+    return false;
+  }
+  nextBlock++;
+  return true;
+}
+
+bool Sd2Card::readStop() {
+  if (state != SIM_CARD_READ) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  state = SIM_CARD_IDLE;
+  return command(this, 1, SD_CARD_ERROR_CMD12);
+}
+
+bool Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src) {
+  if (state != SIM_CARD_IDLE) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  return command(this, 1, SD_CARD_ERROR_CMD24) && writeOne(this, blockNumber, src);
+}
+
+bool Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
+  if (state != SIM_CARD_IDLE) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  // ACMD23 is CMD55 + CMD23, then CMD25
+  if (!command(this, 3, SD_CARD_ERROR_CMD25)) {
+    return false;
+  }
+  state = SIM_CARD_WRITE;
+  nextBlock = blockNumber;
+  return true;
+}
+
+bool Sd2Card::writeData(const uint8_t* src) {
+  if (state != SIM_CARD_WRITE) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  if (!writeOne(this, nextBlock, src)) {
+    return false;
+  }
+  nextBlock++;
+  return true;
+}
+
+bool Sd2Card::writeStop() {
+  if (state != SIM_CARD_WRITE) {
+    error(SIM_CARD_ERROR_STATE);
+    return false;
+  }
+  state = SIM_CARD_IDLE;
+  if (!power) {
+    error(SD_CARD_ERROR_STOP_TRAN);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,61 @@
+/*
+  SimCard.h - Disk image behind the host build of Sd2Card.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  SimCard.cpp defines the Sd2Card methods SdVolume and SdBaseFile call,
+  reading and writing 512 byte blocks of an image file, so the vendored
+  SdFat runs unchanged on Linux. It is linked instead of Sd2Card.cpp.
+  Multi-block reads and writes are checked like a card would: a readData()
+  outside readStart()/readStop() and so on fails with an error code.
+
+  timing sets what each command, each 512 byte block moved and each block
+  the card programs cost; they are charged to the simulated clock with
+  delayMicroseconds(), so micros() around SdFat calls (SdLatency, the loop
+  profiler) sees a card of that speed. All zero, the default, is a card
+  that takes no time at all.
+
+  failAfter() arms a fault: the read or write of the count-th block from
+  now fails with the code a card would give, once. SIM_CARD_FAULT_POWER
+  instead loses power after count more blocks are written: the write in
+  progress and everything after it fails and powerLost() turns true, so
+  the simulator can stop the run and leave the image as a real power cut
+  would.
+*/
+
+#ifndef SimCard_h
+#define SimCard_h
+
+#include "Arduino.h"
+
+#define SIM_CARD_FAULT_READ  0
+#define SIM_CARD_FAULT_WRITE 1
+#define SIM_CARD_FAULT_POWER 2
+
+struct SimCardTiming {
+  uint16_t commandMicros; // command and response
+  uint16_t blockMicros;   // moving one block over SPI
+  uint16_t busyMicros;    // programming one written block
+};
+
+class SimCard {
+  public:
+    // the image Sd2Card::init() will open
+    static bool open(const char *path);
+    static void close();
+    // writes a blank superfloppy (no partition table) FAT16 or FAT32
+    // image; FAT32 needs at least 33 MB
+    static bool format(const char *path, uint16_t megabytes, uint8_t fatType = 16);
+
+    static void failAfter(uint8_t fault, uint32_t count);
+    static bool powerLost();
+
+    static SimCardTiming timing;
+    static uint32_t faults;
+    static uint32_t commands;
+    static uint32_t blocksRead;
+    static uint32_t blocksWritten;
+};
+
+#endif
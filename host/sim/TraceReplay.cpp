@@ -0,0 +1,187 @@
+/*
+  TraceReplay.cpp - Host version of AcqTrace: the sketch's inputs come from a
+  trace recorded on the Mega instead of from hardware.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Each kind of record is replayed against the simulated millis() clock:
+
+    touch    each recorded poll that saw a touch is returned by the first
+             touch() call at or after its time, one per call, in order
+    RTC      now() returns the latest reading at or before the current
+             time (the first reading before that)
+    sample   likewise the latest sample at or before the current time
+
+  Without a trace (or once a kind runs out of records) touch() reports no
+  touch, now() falls through to the RTC stand-in and sample() holds the
+  last values, as does a trace whose samples don't match the sketch's
+  channel list. Nothing is captured on the host.
+*/
+
+#include "Arduino.h"
+#include "AcqTrace.h"
+#include <vector>
+
+struct TraceRecord {
+  uint32_t time;
+  uint32_t offset; // of the payload in traceData
+};
+
+static std::vector<uint8_t> traceData;
+static std::vector<TraceRecord> touches;
+static std::vector<TraceRecord> readings;
+static std::vector<TraceRecord> samples;
+static size_t nextTouch = 0;
+static size_t nextReading = 0;
+static size_t nextSample = 0;
+static byte traceAdc = 0;
+static byte traceTc = 0;
+
+bool AcqTrace::load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  uint8_t chunk[4096];
+  size_t n;
+  traceData.clear();
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    traceData.insert(traceData.end(), chunk, chunk + n);
+  }
+  fclose(f);
+  if (traceData.size() < ACQ_TRACE_HEADER_SIZE || memcmp(&traceData[0], ACQ_TRACE_MAGIC, 4) != 0) {
+    fprintf(stderr, "%s: not a trace\n", path);
+    return false;
+  }
+  traceAdc = traceData[4];
+  traceTc = traceData[5];
+  uint32_t sampleSize = 4 * traceAdc + 9 * traceTc;
+
+  touches.clear();
+  readings.clear();
+  samples.clear();
+  size_t at = ACQ_TRACE_HEADER_SIZE;
+  while (at + 5 <= traceData.size()) {
+    TraceRecord r;
+    char type = traceData[at];
+    memcpy(&r.time, &traceData[at + 1], 4);
+    r.offset = at + 5;
+    uint32_t size;
+    if (type == ACQ_TRACE_TOUCH) {
+      size = FT5206_NUMBER_OF_REGISTERS;
+    }
+    else if (type == ACQ_TRACE_RTC) {
+      size = 4;
+    }
+    else if (type == ACQ_TRACE_SAMPLE) {
+      size = sampleSize;
+    }
+    else {
+      fprintf(stderr, "%s: unknown record '%c' at %lu\n", path, type, (unsigned long)at);
+      break;
+    }
+    if (r.offset + size > traceData.size()) {
+      break; // cut off by a power loss
+    }
+    if (type == ACQ_TRACE_TOUCH) {
+      touches.push_back(r);
+    }
+    else if (type == ACQ_TRACE_RTC) {
+      readings.push_back(r);
+    }
+    else {
+      samples.push_back(r);
+    }
+    at = r.offset + size;
+  }
+  nextTouch = 0;
+  nextReading = 0;
+  nextSample = 0;
+  return true;
+}
+
+uint32_t AcqTrace::lastRecordTime() {
+  uint32_t t = 0;
+  if (!touches.empty() && touches.back().time > t) {
+    t = touches.back().time;
+  }
+  if (!readings.empty() && readings.back().time > t) {
+    t = readings.back().time;
+  }
+  if (!samples.empty() && samples.back().time > t) {
+    t = samples.back().time;
+  }
+  return t;
+}
+
+// index of the latest record at or before now, starting the search at next
+static size_t latest(const std::vector<TraceRecord> &records, size_t *next, uint32_t now) {
+  while (*next < records.size() && records[*next].time <= now) {
+    (*next)++;
+  }
+  return *next == 0 ? 0 : *next - 1;
+}
+
+AcqTrace::AcqTrace() {
+  _buf = 0;
+  _used = 0;
+  _overflow = false;
+}
+
+bool AcqTrace::begin(const char *name, byte adcCount, byte tcCount) {
+  if (!samples.empty() && (adcCount != traceAdc || tcCount != traceTc)) {
+    fprintf(stderr, "trace has %u analog and %u thermocouple values per sample, the sketch %u and %u\n",
+            traceAdc, traceTc, adcCount, tcCount);
+  }
+  return true;
+}
+
+void AcqTrace::update() {
+}
+
+void AcqTrace::flush() {
+}
+
+void AcqTrace::close() {
+}
+
+bool AcqTrace::touch(FT5x06 &cmt, byte *registers) {
+  if (nextTouch >= touches.size() || touches[nextTouch].time > millis()) {
+    return false;
+  }
+  memcpy(registers, &traceData[touches[nextTouch].offset], FT5206_NUMBER_OF_REGISTERS);
+  nextTouch++;
+  return true;
+}
+
+DateTime AcqTrace::now(RTC_DS1307 &rtc) {
+  if (readings.empty()) {
+    return rtc.now();
+  }
+  uint32_t t;
+  memcpy(&t, &traceData[readings[latest(readings, &nextReading, millis())].offset], 4);
+  return DateTime(t);
+}
+
+void AcqTrace::sample(MAX31855Pair *tc, MAX31855Reading *tcVals, float *adc, byte adcCount) {
+  if (samples.empty() || adcCount != traceAdc || (tc ? 2 : 0) != traceTc) {
+    return;
+  }
+  const uint8_t *p = &traceData[samples[latest(samples, &nextSample, millis())].offset];
+  memcpy(adc, p, 4 * adcCount);
+  p += 4 * adcCount;
+  for (byte i = 0; tc && i < 2; i++) {
+    memcpy(&tcVals[i].thermocouple, p, 4);
+    memcpy(&tcVals[i].internal, p + 4, 4);
+    tcVals[i].fault = p[8];
+    p += 9;
+  }
+}
+
+bool AcqTrace::record(char type, byte payload) {
+  return false;
+}
+
+void AcqTrace::put(const void *data, byte size) {
+}
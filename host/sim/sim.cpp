@@ -0,0 +1,437 @@
+/*
+  sim.cpp - Runs acq.ino on Linux, optionally replaying a trace recorded on
+  the Mega (see acq/AcqTrace.h).
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Build from the repository root with the g++ line after this comment,
+  and run:
+    ./acqsim [-t 160815-A.TRC] [-o dir] [-u until_ms] [-p pass_us] [-s snapshot_ms]
+             [-b ns_per_byte] [-g golden_dir] [-k | -F 16|32 -m megabytes]
+             [-l command_us,block_us,busy_us] [-f r|w|p:blocks] [-i serial_input]
+
+  The sketch runs against a fresh FAT image (SimCard, 64 MB FAT16 unless
+  -F and -m say otherwise, or with -k the card.img a previous run left in
+  dir), the display
+  stand-in in host/shim and a simulated clock: each pass of loop() takes
+  pass_us (2000 by default) plus whatever delay() asks for, plus with -b
+  ns_per_byte the SPI time of everything sent to the display. The run ends
+  at until_ms, by default 1 s after the last trace record (10 s without
+  one). -l gives the card a speed (see SimCard.h); -f fails the read (r) or
+  write (w) of the given block from the start, or loses power (p) there,
+  which ends the run on the spot with the image as the power cut left it.
+  -i types lines at the serial monitor: each "ms text" line of the file
+  sends text and a newline once millis() reaches ms.
+
+  Into dir (sim-out by default) go card.img, serial.txt with everything the
+  sketch printed, display.csv with the display calls and the SPI bytes and
+  register writes they cost, a copy of every file it left on the card, and
+  a display snapshot every snapshot_ms of simulated time and at the end,
+  fb-<ms>.ppm. Nothing depends on the host's own clock, so replaying the
+  same trace twice gives identical files; the size and FNV-1a hash of each
+  is printed at the end. With -g each snapshot is also compared with the
+  same-named file in golden_dir, and the run fails if any pixel differs.
+*/
+
+// all on one line (its source globs can't go inside a block comment):
+//   g++ -std=gnu++11 -O2 -DARDUINO=105 -DACQ_SIM -Ihost/shim -Ihost/sim -Iacq
+//   -Ideprecated/AdafruitLogger/SdFat host/sim/*.cpp host/shim/*.cpp acq/*.cpp
+//   deprecated/AdafruitLogger/SdFat/{SdFat,SdFile,SdBaseFile,SdVolume,SdLatency}.cpp
+//   -o acqsim
+
+#include "Arduino.h"
+#include <SdFat.h>
+#include "Adafruit_RA8875.h"
+#include "Wire.h"
+#include "AcqTrace.h"
+#include "SimCard.h"
+#include <getopt.h>
+#include <utility>
+#include <vector>
+#include <limits.h>
+#include <sys/stat.h>
+
+void setup();
+void loop();
+void simShutdown();
+Adafruit_RA8875 &simDisplay();
+SdFat &simCard();
+
+// SIMULATED CORE
+static uint64_t clockMicros = 0;
+static FILE *serialOut = stdout;
+// -i: what the serial monitor sends, and the millis() it becomes readable at
+static std::vector<std::pair<unsigned long, char> > serialIn;
+static size_t serialInNext = 0;
+
+unsigned long millis() {
+  return (uint32_t)(clockMicros / 1000);
+}
+
+unsigned long micros() {
+  return (uint32_t)clockMicros;
+}
+
+void delay(unsigned long ms) {
+  clockMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+  clockMicros += us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+}
+
+int digitalRead(uint8_t pin) {
+  return LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return fputc(c, serialOut) == EOF ? 0 : 1;
+}
+
+int HardwareSerial::available() {
+  size_t n = serialInNext;
+  while (n < serialIn.size() && serialIn[n].first <= millis()) {
+    n++;
+  }
+  return n - serialInNext;
+}
+
+int HardwareSerial::read() {
+  int c = peek();
+  if (c >= 0) {
+    serialInNext++;
+  }
+  return c;
+}
+
+int HardwareSerial::peek() {
+  if (available() == 0) {
+    return -1;
+  }
+  return (uint8_t)serialIn[serialInNext].second;
+}
+
+// the Mega's TX buffer less one, always empty since writes go straight out
+int HardwareSerial::availableForWrite() {
+  return 63;
+}
+
+HardwareSerial Serial;
+TwoWire Wire;
+uint8_t SREG;
+volatile uint8_t ADCSRA, ADCSRB, ADMUX;
+volatile uint16_t ADC;
+volatile uint8_t UCSR1A, UCSR1B, UCSR1C, UDR1;
+volatile uint16_t UBRR1;
+volatile uint8_t sim_ports[16];
+
+// OUTPUT
+class FilePrint : public Print {
+  public:
+    explicit FilePrint(FILE *f) : _f(f) {}
+    size_t write(uint8_t c) { return fputc(c, _f) == EOF ? 0 : 1; }
+  private:
+    FILE *_f;
+};
+
+static bool loadSerialInput(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    char *text;
+    unsigned long ms = strtoul(line, &text, 10);
+    if (text == line) {
+      continue;
+    }
+    if (*text == ' ') {
+      text++;
+    }
+    for (; *text && *text != '\n'; text++) {
+      serialIn.push_back(std::make_pair(ms, *text));
+    }
+    serialIn.push_back(std::make_pair(ms, '\n'));
+  }
+  fclose(f);
+  return true;
+}
+
+static uint32_t fnv1a(const uint8_t *p, size_t n, uint32_t h) {
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ p[i]) * 16777619UL;
+  }
+  return h;
+}
+
+// dir/name into path, PATH_MAX long; false, and says so, if it doesn't fit
+static bool joinPath(char *path, const char *dir, const char *name) {
+  int n = snprintf(path, PATH_MAX, "%s/%s", dir, name);
+  if (n < 0 || n >= PATH_MAX) {
+    fprintf(stderr, "path too long: %s/%s\n", dir, name);
+    return false;
+  }
+  return true;
+}
+
+static void summarize(const char *dir, const char *name) {
+  char path[PATH_MAX];
+  if (!joinPath(path, dir, name)) {
+    return;
+  }
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  unsigned long size = 0;
+  uint32_t h = 2166136261UL;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    h = fnv1a(buf, n, h);
+    size += n;
+  }
+  fclose(f);
+  printf("%-24s %10lu  %08lx\n", name, size, (unsigned long)h);
+}
+
+static void snapshot(const char *dir, const char *name) {
+  char path[PATH_MAX];
+  if (joinPath(path, dir, name) && !simDisplay().snapshot(path)) {
+    fprintf(stderr, "can't write %s\n", path);
+  }
+}
+
+// pixels that differ between two PPM snapshots, -1 if either can't be read
+// or their sizes differ
+static long comparePpm(const char *a, const char *b) {
+  FILE *fa = fopen(a, "rb");
+  FILE *fb = fopen(b, "rb");
+  long diff = -1;
+  int wa, ha, wb, hb;
+  if (fa && fb && fscanf(fa, "P6 %d %d 255", &wa, &ha) == 2
+      && fscanf(fb, "P6 %d %d 255", &wb, &hb) == 2 && wa == wb && ha == hb) {
+    fgetc(fa);
+    fgetc(fb);
+    diff = 0;
+    uint8_t pa[3], pb[3];
+    for (long i = 0; i < (long)wa * ha; i++) {
+      if (fread(pa, 1, 3, fa) != 3 || fread(pb, 1, 3, fb) != 3) {
+        diff = -1;
+        break;
+      }
+      if (memcmp(pa, pb, 3) != 0) {
+        diff = diff + 1;
+      }
+    }
+  }
+  if (fa) {
+    fclose(fa);
+  }
+  if (fb) {
+    fclose(fb);
+  }
+  return diff;
+}
+
+// copies every file in the card's root directory to dir
+static void extract(const char *dir, char names[][24], int *count, int max) {
+  SdBaseFile *root = simCard().vwd();
+  SdFile f;
+  root->rewind();
+  while (*count < max && f.openNext(root, O_READ)) {
+    if (f.isFile()) {
+      char *name = names[*count];
+      f.getFilename(name);
+      char path[PATH_MAX];
+      FILE *out = joinPath(path, dir, name) ? fopen(path, "wb") : 0;
+      if (out) {
+        uint8_t buf[512];
+        int n;
+        while ((n = f.read(buf, sizeof(buf))) > 0) {
+          fwrite(buf, 1, n, out);
+        }
+        fclose(out);
+        *count = *count + 1;
+      }
+    }
+    f.close();
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *tracePath = 0;
+  const char *dir = "sim-out";
+  long until = -1;
+  unsigned long passMicros = 2000;
+  unsigned long snapshotEvery = 0;
+  const char *golden = 0;
+  bool keep = false;
+  uint8_t fatType = 16;
+  uint16_t megabytes = 64;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:o:u:p:s:b:g:kF:m:l:f:i:")) != -1) {
+    switch (opt) {
+      case 't': tracePath = optarg; break;
+      case 'o': dir = optarg; break;
+      case 'u': until = atol(optarg); break;
+      case 'p': passMicros = strtoul(optarg, 0, 10); break;
+      case 's': snapshotEvery = strtoul(optarg, 0, 10); break;
+      case 'b': simDisplay().setBusTime(atoi(optarg)); break;
+      case 'g': golden = optarg; break;
+      case 'k': keep = true; break;
+      case 'F': fatType = atoi(optarg); break;
+      case 'm': megabytes = atoi(optarg); break;
+      case 'l':
+        SimCard::timing.commandMicros = strtoul(optarg, &optarg, 10);
+        SimCard::timing.blockMicros = *optarg ? strtoul(optarg + 1, &optarg, 10) : 0;
+        SimCard::timing.busyMicros = *optarg ? strtoul(optarg + 1, &optarg, 10) : 0;
+        break;
+      case 'f':
+        if (strlen(optarg) < 3 || optarg[1] != ':' || !strchr("rwp", optarg[0])) {
+          fprintf(stderr, "-f wants r:blocks, w:blocks or p:blocks\n");
+          return 2;
+        }
+        SimCard::failAfter(optarg[0] == 'r' ? SIM_CARD_FAULT_READ
+                           : optarg[0] == 'w' ? SIM_CARD_FAULT_WRITE : SIM_CARD_FAULT_POWER,
+                           strtoul(optarg + 2, 0, 10));
+        break;
+      case 'i':
+        if (!loadSerialInput(optarg)) {
+          fprintf(stderr, "can't read %s\n", optarg);
+          return 2;
+        }
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-t trace] [-o dir] [-u until_ms] [-p pass_us] [-s snapshot_ms]"
+                " [-b ns_per_byte] [-g golden_dir] [-k | -F 16|32 -m megabytes]"
+                " [-l command_us,block_us,busy_us] [-f r|w|p:blocks] [-i serial_input]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  mkdir(dir, 0777);
+  char path[PATH_MAX];
+  if (!joinPath(path, dir, "card.img")) {
+    return 1;
+  }
+  if ((!keep && !SimCard::format(path, megabytes, fatType)) || !SimCard::open(path)) {
+    fprintf(stderr, "can't create %s\n", path);
+    return 1;
+  }
+  joinPath(path, dir, "serial.txt"); // no longer than card.img
+  serialOut = fopen(path, "wb");
+  if (!serialOut) {
+    fprintf(stderr, "can't create %s\n", path);
+    return 1;
+  }
+  if (tracePath) {
+    if (!AcqTrace::load(tracePath)) {
+      fprintf(stderr, "can't load %s\n", tracePath);
+      return 1;
+    }
+    if (until < 0) {
+      until = AcqTrace::lastRecordTime() + 1000;
+    }
+  }
+  if (until < 0) {
+    until = 10000;
+  }
+
+  char names[64 + 256][24];
+  int count = 0;
+  int snapshots;
+  setup();
+  unsigned long nextSnapshot = snapshotEvery;
+  while (millis() < (unsigned long)until && !SimCard::powerLost()) {
+    loop();
+    clockMicros += passMicros;
+    if (snapshotEvery > 0 && millis() >= nextSnapshot) {
+      snprintf(names[count], sizeof(names[count]), "fb-%08lu.ppm", nextSnapshot);
+      if (count < 64) {
+        snapshot(dir, names[count]);
+        count = count + 1;
+      }
+      nextSnapshot += snapshotEvery;
+    }
+  }
+  if (snapshotEvery == 0 || millis() != nextSnapshot - snapshotEvery) {
+    snprintf(names[count], sizeof(names[count]), "fb-%08lu.ppm", millis());
+    snapshot(dir, names[count]);
+    count = count + 1;
+  }
+  snapshots = count;
+
+  joinPath(path, dir, "display.csv");
+  FILE *stats = fopen(path, "wb");
+  if (stats) {
+    FilePrint pr(stats);
+    simDisplay().dumpStats(&pr);
+    fclose(stats);
+  }
+
+  // after a power cut the volume's cache may hold what never reached the
+  // image, so leave the files for a -k run to recover and extract
+  bool extracting = !SimCard::powerLost();
+  if (extracting) {
+    simShutdown();
+  }
+  // the sketch's card I/O, not extract() reading every file back
+  unsigned long commands = SimCard::commands;
+  unsigned long blocksRead = SimCard::blocksRead;
+  unsigned long blocksWritten = SimCard::blocksWritten;
+  if (extracting) {
+    extract(dir, names, &count, 64 + 256);
+  }
+  fclose(serialOut);
+  SimCard::close();
+
+  printf("simulated %lu ms, %lu card commands, %lu blocks read, %lu written\n",
+         millis(), commands, blocksRead, blocksWritten);
+  if (SimCard::faults > 0) {
+    printf("%lu card faults injected%s\n", (unsigned long)SimCard::faults,
+           SimCard::powerLost() ? ", power lost" : "");
+  }
+  RA8875CallStats display = simDisplay().totals();
+  printf("%lu display calls, %lu SPI bytes, %lu register writes\n",
+         (unsigned long)display.calls, (unsigned long)display.spiBytes,
+         (unsigned long)display.regWrites);
+  summarize(dir, "serial.txt");
+  summarize(dir, "display.csv");
+  for (int i = 0; i < count; i++) {
+    summarize(dir, names[i]);
+  }
+
+  int failed = 0;
+  if (golden) {
+    for (int i = 0; i < snapshots; i++) {
+      char mine[PATH_MAX];
+      long diff = -1;
+      if (joinPath(path, golden, names[i]) && joinPath(mine, dir, names[i])) {
+        diff = comparePpm(mine, path);
+      }
+      if (diff != 0) {
+        if (diff < 0) {
+          printf("%s: can't compare with %s\n", names[i], path);
+        }
+        else {
+          printf("%s: %ld pixels differ from %s\n", names[i], diff, path);
+        }
+        failed = 1;
+      }
+    }
+    printf("%s\n", failed ? "snapshots differ from golden" : "snapshots match golden");
+  }
+  return failed;
+}
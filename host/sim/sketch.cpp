@@ -0,0 +1,32 @@
+/*
+  sketch.cpp - acq.ino as a translation unit for the simulator.
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  acq.ino declares its own functions up front, as g++ needs and the
+  Arduino IDE would otherwise do for it.
+*/
+
+#include "Arduino.h"
+#include <SdFat.h>
+#include "Adafruit_RA8875.h"
+#include "RTClib.h"
+
+#include "acq.ino"
+
+// the end of a simulated run: the log is closed the way a rollover closes
+// it, so the copy taken off the image holds just the rows
+void simShutdown() {
+  journal.close();
+  log_index.flush();
+  acq_trace.close();
+}
+
+Adafruit_RA8875 &simDisplay() {
+  return tft;
+}
+
+SdFat &simCard() {
+  return sd;
+}
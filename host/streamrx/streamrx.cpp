@@ -0,0 +1,641 @@
+/*
+  streamrx.cpp - Records the sketch's live ADC stream (acq/FrameStream.h).
+  Created for arduinacq, 2016.
+             Space Sciences Laboratory
+  Released under GNU GPL v3
+
+  Build from the repository root:
+    g++ -std=gnu++11 -O2 -pthread host/streamrx/streamrx.cpp -o streamrx
+  and run, with a USB-serial adapter on TX1 and serial 's' sent to the Mega:
+    ./streamrx [-b 2000000] [-r prefix [-m 256]] [-c out.csv] [-s 5] [-q 64] tty
+
+  The tty is put in raw mode at -b baud; anything else that can be read
+  (a pty for testing, or one of the recorded .cobs files to play it back)
+  is read as it is. Frames are split on the 0 bytes, COBS decoded and
+  checked; a data frame whose sequence number isn't one on from the last
+  one counts the frames in between as lost, and one that doesn't decode or
+  has the wrong length counts as bad. Data frames that arrive before any
+  header are kept as raw counts, with slots named s0, s1, ...
+
+  The reader only decodes. Every 100 ms, or every BATCH_FRAMES frames, it
+  hands what it has to each sink, each running on its own thread behind a
+  queue of at most -q batches:
+    -r prefix  rolling binary file: the frames as received, in
+               prefix-0001.cobs, prefix-0002.cobs, ... of -m MB each, each
+               starting with the last header so it can be read on its own
+    -c file    CSV: seq, device time in us (unwrapped), each slot's value
+               through its channel's scale and offset
+    -s secs    stats on stdout every secs: frame and byte rates, lost and
+               bad frames, each slot's min/mean/max, and each sink's queue
+  The reader never waits for a sink, since a stalled tty loses bytes in
+  the kernel instead. A batch that finds a sink's queue full is dropped for
+  that sink alone and counted against it; the stats line and the summary
+  at exit show each sink's batches written and dropped and its deepest
+  queue. Ctrl-C drains the queues and stops.
+*/
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define FRAME_HEADER 'H'
+#define FRAME_DATA   'D'
+#define FRAME_DATA_FIXED 7 // kind, sequence, micros
+#define MAX_SLOTS 16
+#define BATCH_FRAMES 4096
+#define BATCH_MS 100
+#define READ_SIZE 65536
+
+typedef std::chrono::steady_clock Clock;
+
+struct Header {
+  uint16_t conversionUs;
+  std::vector<float> scale;
+  std::vector<float> offset;
+  std::vector<std::string> label;
+  std::vector<std::string> units;
+  std::string raw; // as received, delimiter included
+};
+
+struct Batch {
+  std::shared_ptr<const Header> header; // of every frame here
+  bool newHeader;    // header arrived since the last batch
+  std::string raw;   // every frame received, as received
+  size_t slots;
+  std::vector<uint16_t> seq;
+  std::vector<uint64_t> micros;
+  std::vector<uint16_t> values; // row-major, slots per frame
+  uint64_t bytes;
+  uint64_t lost;
+  uint64_t bad;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+  stopping = 1;
+}
+
+// a sink runs write() on its own thread for each batch it is handed, and
+// tick() whenever its queue has been empty for a tick
+class Sink {
+  public:
+    Sink(const char *name) : _name(name), _depth(0), _closing(false), _written(0),
+                             _dropped(0), _droppedFrames(0), _maxQueued(0) {}
+    virtual ~Sink() {}
+    const char *name() const { return _name; }
+
+    void start(size_t depth) {
+      _depth = depth;
+      _thread = std::thread([this]() { run(); });
+    }
+    // from the reader; never waits
+    void offer(const std::shared_ptr<const Batch> &b) {
+      std::lock_guard<std::mutex> lock(_lock);
+      if (_queue.size() >= _depth) {
+        _dropped++;
+        _droppedFrames += b->seq.size();
+        return;
+      }
+      _queue.push_back(b);
+      if (_queue.size() > _maxQueued) {
+        _maxQueued = _queue.size();
+      }
+      _ready.notify_one();
+    }
+    void finish() {
+      {
+        std::lock_guard<std::mutex> lock(_lock);
+        _closing = true;
+        _ready.notify_one();
+      }
+      _thread.join();
+    }
+    // back-pressure so far
+    void counts(uint64_t *written, uint64_t *dropped, uint64_t *droppedFrames,
+                size_t *queued, size_t *maxQueued) {
+      std::lock_guard<std::mutex> lock(_lock);
+      *written = _written;
+      *dropped = _dropped;
+      *droppedFrames = _droppedFrames;
+      *queued = _queue.size();
+      *maxQueued = _maxQueued;
+    }
+  protected:
+    virtual void write(const Batch &b) = 0;
+    virtual void tick() {}
+    virtual void close() {}
+  private:
+    void run() {
+      std::unique_lock<std::mutex> lock(_lock);
+      for (;;) {
+        if (_queue.empty()) {
+          if (_closing) {
+            break;
+          }
+          if (!_ready.wait_for(lock, std::chrono::milliseconds(BATCH_MS),
+                               [this]() { return !_queue.empty() || _closing; })) {
+            lock.unlock();
+            tick();
+            lock.lock();
+          }
+          continue;
+        }
+        std::shared_ptr<const Batch> b = _queue.front();
+        _queue.pop_front();
+        lock.unlock();
+        write(*b);
+        tick();
+        lock.lock();
+        _written++;
+      }
+      lock.unlock();
+      close();
+    }
+
+    const char *_name;
+    size_t _depth;
+    std::mutex _lock;
+    std::condition_variable _ready;
+    std::deque<std::shared_ptr<const Batch> > _queue;
+    bool _closing;
+    uint64_t _written;
+    uint64_t _dropped;
+    uint64_t _droppedFrames;
+    size_t _maxQueued;
+    std::thread _thread;
+};
+
+class RollingSink : public Sink {
+  public:
+    RollingSink(const char *prefix, uint64_t limit)
+      : Sink("cobs"), _prefix(prefix), _limit(limit), _file(0), _size(0), _index(0) {}
+  protected:
+    void write(const Batch &b) {
+      if (b.newHeader) {
+        _header = b.header;
+      }
+      if (!_file || _size >= _limit) {
+        roll(b.newHeader);
+      }
+      if (_file) {
+        fwrite(b.raw.data(), 1, b.raw.size(), _file);
+        fflush(_file);
+        _size += b.raw.size();
+      }
+    }
+    void close() {
+      if (_file) {
+        fclose(_file);
+      }
+    }
+  private:
+    // a new file starts with the header, unless this batch brings its own
+    void roll(bool headerInBatch) {
+      if (_file) {
+        fclose(_file);
+      }
+      _index++;
+      char name[32];
+      snprintf(name, sizeof(name), "-%04u.cobs", _index);
+      std::string path = _prefix + name;
+      _file = fopen(path.c_str(), "wb");
+      _size = 0;
+      if (!_file) {
+        fprintf(stderr, "can't write %s\n", path.c_str());
+        return;
+      }
+      if (_header && !_header->raw.empty() && !headerInBatch) {
+        fwrite(_header->raw.data(), 1, _header->raw.size(), _file);
+        _size += _header->raw.size();
+      }
+    }
+
+    std::string _prefix;
+    uint64_t _limit;
+    FILE *_file;
+    uint64_t _size;
+    unsigned _index;
+    std::shared_ptr<const Header> _header;
+};
+
+class CsvSink : public Sink {
+  public:
+    CsvSink(FILE *f) : Sink("csv"), _file(f) {}
+  protected:
+    void write(const Batch &b) {
+      const Header &h = *b.header;
+      if (b.header != _header) {
+        fprintf(_file, "seq,t_us");
+        for (size_t s = 0; s < b.slots; s++) {
+          fprintf(_file, ",%s[%s]", h.label[s].c_str(), h.units[s].c_str());
+        }
+        fprintf(_file, "\n");
+        _header = b.header;
+      }
+      for (size_t i = 0; i < b.seq.size(); i++) {
+        fprintf(_file, "%u,%llu", b.seq[i], (unsigned long long)b.micros[i]);
+        for (size_t s = 0; s < b.slots; s++) {
+          fprintf(_file, ",%.6g", b.values[i * b.slots + s] * h.scale[s] + h.offset[s]);
+        }
+        fprintf(_file, "\n");
+      }
+      fflush(_file);
+    }
+    void close() {
+      fclose(_file);
+    }
+  private:
+    FILE *_file;
+    std::shared_ptr<const Header> _header;
+};
+
+class StatsSink : public Sink {
+  public:
+    StatsSink(double seconds, std::vector<Sink *> &sinks)
+      : Sink("stats"), _interval(seconds), _sinks(sinks), _start(Clock::now()), _last(_start),
+        _lost(0), _bad(0) {
+      reset();
+    }
+  protected:
+    void write(const Batch &b) {
+      if (b.header != _header) {
+        _header = b.header;
+        reset();
+      }
+      _frames += b.seq.size();
+      _bytes += b.bytes;
+      _lost += b.lost;
+      _bad += b.bad;
+      for (size_t i = 0; i < b.seq.size(); i++) {
+        for (size_t s = 0; s < b.slots; s++) {
+          uint16_t v = b.values[i * b.slots + s];
+          _min[s] = std::min(_min[s], v);
+          _max[s] = std::max(_max[s], v);
+          _sum[s] += v;
+        }
+      }
+    }
+    void tick() {
+      Clock::time_point now = Clock::now();
+      double dt = std::chrono::duration<double>(now - _last).count();
+      if (dt < _interval) {
+        return;
+      }
+      _last = now;
+      printf("%.1fs: %.0f frames/s, %.0f B/s, lost %llu, bad %llu",
+             std::chrono::duration<double>(now - _start).count(), _frames / dt, _bytes / dt,
+             (unsigned long long)_lost, (unsigned long long)_bad);
+      if (_header && _frames > 0) {
+        for (size_t s = 0; s < _min.size(); s++) {
+          const Header &h = *_header;
+          printf(" | %s %.6g/%.6g/%.6g", h.label[s].c_str(), _min[s] * h.scale[s] + h.offset[s],
+                 (double)_sum[s] / _frames * h.scale[s] + h.offset[s],
+                 _max[s] * h.scale[s] + h.offset[s]);
+        }
+      }
+      for (size_t k = 0; k < _sinks.size(); k++) {
+        uint64_t written, dropped, droppedFrames;
+        size_t queued, maxQueued;
+        _sinks[k]->counts(&written, &dropped, &droppedFrames, &queued, &maxQueued);
+        printf(" | %s q %lu/%lu drop %llu", _sinks[k]->name(), (unsigned long)queued,
+               (unsigned long)maxQueued, (unsigned long long)dropped);
+      }
+      printf("\n");
+      fflush(stdout);
+      _frames = 0;
+      _bytes = 0;
+      _min.assign(_min.size(), 0xFFFF);
+      _max.assign(_max.size(), 0);
+      _sum.assign(_sum.size(), 0);
+    }
+  private:
+    void reset() {
+      size_t n = _header ? _header->scale.size() : 0;
+      _frames = 0;
+      _bytes = 0;
+      _min.assign(n, 0xFFFF);
+      _max.assign(n, 0);
+      _sum.assign(n, 0);
+    }
+
+    double _interval;
+    std::vector<Sink *> &_sinks;
+    Clock::time_point _start;
+    Clock::time_point _last;
+    std::shared_ptr<const Header> _header;
+    uint64_t _frames;
+    uint64_t _bytes;
+    uint64_t _lost;
+    uint64_t _bad;
+    std::vector<uint16_t> _min;
+    std::vector<uint16_t> _max;
+    std::vector<uint64_t> _sum;
+};
+
+// decodes one COBS frame, delimiter already gone; false if it's malformed
+static bool unstuff(const uint8_t *in, size_t n, std::vector<uint8_t> &out) {
+  out.clear();
+  size_t i = 0;
+  while (i < n) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > n) {
+      return false;
+    }
+    out.insert(out.end(), in + i, in + i + code - 1);
+    i += code - 1;
+    if (code < 0xFF && i < n) {
+      out.push_back(0);
+    }
+  }
+  return true;
+}
+
+static bool parseHeader(const std::vector<uint8_t> &f, Header &h) {
+  if (f.size() < 5 || f[1] != 1) {
+    return false;
+  }
+  h.conversionUs = f[2] | f[3] << 8;
+  size_t slots = f[4];
+  size_t at = 5;
+  for (size_t s = 0; s < slots; s++) {
+    float v[2];
+    if (at + 8 > f.size()) {
+      return false;
+    }
+    memcpy(v, &f[at], 8);
+    at += 8;
+    std::string text[2];
+    for (int k = 0; k < 2; k++) {
+      const uint8_t *end = (const uint8_t *)memchr(&f[at], 0, f.size() - at);
+      if (!end) {
+        return false;
+      }
+      text[k].assign((const char *)&f[at], end - &f[at]);
+      at = end - &f[0] + 1;
+    }
+    h.scale.push_back(v[0]);
+    h.offset.push_back(v[1]);
+    h.label.push_back(text[0]);
+    h.units.push_back(text[1]);
+  }
+  return slots > 0 && slots <= MAX_SLOTS;
+}
+
+// raw counts, for data that arrives before its header
+static std::shared_ptr<const Header> rawHeader(size_t slots) {
+  std::shared_ptr<Header> h(new Header());
+  h->conversionUs = 0;
+  for (size_t s = 0; s < slots; s++) {
+    h->scale.push_back(1);
+    h->offset.push_back(0);
+    h->label.push_back("s" + std::to_string(s));
+    h->units.push_back("counts");
+  }
+  return h;
+}
+
+static speed_t baudConstant(unsigned long baud) {
+  switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+  }
+  return B0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long baud = 2000000;
+  const char *rollPrefix = 0;
+  uint64_t rollMB = 256;
+  const char *csvPath = 0;
+  double statsSeconds = 0;
+  size_t depth = 64;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:r:m:c:s:q:")) != -1) {
+    switch (opt) {
+      case 'b': baud = strtoul(optarg, 0, 10); break;
+      case 'r': rollPrefix = optarg; break;
+      case 'm': rollMB = strtoull(optarg, 0, 10); break;
+      case 'c': csvPath = optarg; break;
+      case 's': statsSeconds = atof(optarg); break;
+      case 'q': depth = strtoul(optarg, 0, 10); break;
+      default:
+        optind = argc;
+        break;
+    }
+  }
+  if (optind != argc - 1 || depth == 0 || rollMB == 0) {
+    fprintf(stderr, "usage: %s [-b baud] [-r prefix [-m MB]] [-c out.csv] [-s secs] [-q batches] tty\n",
+            argv[0]);
+    return 2;
+  }
+  const char *path = argv[optind];
+
+  int fd = open(path, O_RDONLY | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    speed_t speed = baudConstant(baud);
+    if (speed == B0) {
+      fprintf(stderr, "unsupported baud rate %lu\n", baud);
+      return 2;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIFLUSH);
+  }
+
+  std::vector<Sink *> sinks;
+  if (rollPrefix) {
+    sinks.push_back(new RollingSink(rollPrefix, rollMB << 20));
+  }
+  if (csvPath) {
+    FILE *f = fopen(csvPath, "w");
+    if (!f) {
+      fprintf(stderr, "can't write %s\n", csvPath);
+      return 1;
+    }
+    sinks.push_back(new CsvSink(f));
+  }
+  // the stats sink reports on the others, and on itself
+  if (statsSeconds > 0) {
+    sinks.push_back(new StatsSink(statsSeconds, sinks));
+  }
+  for (size_t k = 0; k < sinks.size(); k++) {
+    sinks[k]->start(depth);
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal; // no SA_RESTART, so poll() returns
+  sigaction(SIGINT, &sa, 0);
+  sigaction(SIGTERM, &sa, 0);
+
+  std::shared_ptr<const Header> header;
+  std::shared_ptr<Batch> batch;
+  std::vector<uint8_t> pending;
+  std::vector<uint8_t> frame;
+  std::vector<uint8_t> buf(READ_SIZE);
+  bool haveSeq = false;
+  uint16_t nextSeq = 0;
+  uint32_t lastMicros = 0;
+  uint64_t micros = 0;
+  uint64_t frames = 0, bytes = 0, lost = 0, bad = 0;
+  Clock::time_point flushed = Clock::now();
+
+  // hands the batch to every sink
+  auto flush = [&]() {
+    if (batch && (!batch->seq.empty() || !batch->raw.empty() || batch->bad > 0)) {
+      std::shared_ptr<const Batch> b = batch;
+      for (size_t k = 0; k < sinks.size(); k++) {
+        sinks[k]->offer(b);
+      }
+    }
+    batch.reset();
+    flushed = Clock::now();
+  };
+  auto current = [&]() -> Batch & {
+    if (!batch || batch->header != header) {
+      flush();
+      batch.reset(new Batch());
+      batch->header = header;
+      batch->newHeader = false;
+      batch->slots = header ? header->scale.size() : 0;
+      batch->bytes = 0;
+      batch->lost = 0;
+      batch->bad = 0;
+    }
+    return *batch;
+  };
+
+  bool eof = false;
+  while (!stopping && !eof) {
+    struct pollfd p = {fd, POLLIN, 0};
+    int ready = poll(&p, 1, BATCH_MS);
+    if (ready > 0) {
+      ssize_t n = read(fd, buf.data(), buf.size());
+      if (n < 0 && errno != EINTR && errno != EAGAIN) {
+        fprintf(stderr, "reading %s: %s\n", path, strerror(errno));
+        break;
+      }
+      if (n == 0) {
+        eof = true; // a file played back, or the adapter unplugged
+      }
+      for (ssize_t i = 0; i < n; i++) {
+        pending.push_back(buf[i]);
+        if (buf[i] != 0) {
+          continue;
+        }
+        bytes += pending.size();
+        std::string raw(pending.begin(), pending.end());
+        bool ok = pending.size() > 1 && unstuff(pending.data(), pending.size() - 1, frame);
+        pending.clear();
+        if (raw.size() == 1) {
+          continue; // a lone delimiter
+        }
+        if (ok && frame[0] == FRAME_HEADER) {
+          std::shared_ptr<Header> h(new Header());
+          if (parseHeader(frame, *h)) {
+            h->raw = raw;
+            header = h;
+            haveSeq = false; // the device started over
+            Batch &b = current();
+            b.newHeader = true;
+            b.raw += raw;
+            b.bytes += raw.size();
+            continue;
+          }
+          ok = false;
+        }
+        size_t slots = ok && frame.size() > FRAME_DATA_FIXED ? (frame.size() - FRAME_DATA_FIXED) / 2 : 0;
+        if (!ok || frame[0] != FRAME_DATA || slots == 0 || slots > MAX_SLOTS
+            || frame.size() != FRAME_DATA_FIXED + 2 * slots
+            || (header && header->scale.size() != slots)) {
+          bad++;
+          Batch &b = current();
+          b.bad++;
+          b.bytes += raw.size();
+          continue;
+        }
+        if (!header) {
+          header = rawHeader(slots);
+        }
+        Batch &b = current();
+        uint16_t seq = frame[1] | frame[2] << 8;
+        uint32_t t = frame[3] | frame[4] << 8 | frame[5] << 16 | (uint32_t)frame[6] << 24;
+        if (haveSeq) {
+          uint16_t gap = seq - nextSeq;
+          lost += gap;
+          b.lost += gap;
+          micros += (uint32_t)(t - lastMicros);
+        }
+        else {
+          micros = t;
+        }
+        haveSeq = true;
+        nextSeq = seq + 1;
+        lastMicros = t;
+        b.seq.push_back(seq);
+        b.micros.push_back(micros);
+        for (size_t s = 0; s < slots; s++) {
+          b.values.push_back(frame[FRAME_DATA_FIXED + 2 * s] | frame[FRAME_DATA_FIXED + 2 * s + 1] << 8);
+        }
+        b.raw += raw;
+        b.bytes += raw.size();
+        frames++;
+      }
+    }
+    if ((batch && batch->seq.size() >= BATCH_FRAMES)
+        || Clock::now() - flushed >= std::chrono::milliseconds(BATCH_MS)) {
+      flush();
+    }
+  }
+  flush();
+  close(fd);
+
+  for (size_t k = 0; k < sinks.size(); k++) {
+    sinks[k]->finish();
+  }
+  fprintf(stderr, "%llu frames, %llu bytes, %llu lost, %llu bad\n", (unsigned long long)frames,
+          (unsigned long long)bytes, (unsigned long long)lost, (unsigned long long)bad);
+  for (size_t k = 0; k < sinks.size(); k++) {
+    uint64_t written, dropped, droppedFrames;
+    size_t queued, maxQueued;
+    sinks[k]->counts(&written, &dropped, &droppedFrames, &queued, &maxQueued);
+    fprintf(stderr, "%s: %llu batches written, %llu dropped (%llu frames), deepest queue %lu of %lu\n",
+            sinks[k]->name(), (unsigned long long)written, (unsigned long long)dropped,
+            (unsigned long long)droppedFrames, (unsigned long)maxQueued, (unsigned long)depth);
+    delete sinks[k];
+  }
+  return 0;
+}